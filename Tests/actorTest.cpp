@@ -0,0 +1,271 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <thread>
+
+#include "catch.hpp"
+#include "madronalib.h"
+
+using namespace ml;
+
+namespace actorTest
+{
+class CountingActor : public Actor
+{
+ public:
+  CountingActor(QueueMode mode) : Actor(mode) {}
+
+  void onMessage(Message m) override
+  {
+    count++;
+    sum += m.value.getIntValue();
+    handled++;
+  }
+  void onFullQueue() override { fullCount++; }
+
+  int count{0};
+  int sum{0};
+  std::atomic<int> fullCount{0};
+  std::atomic<int> handled{0};
+};
+
+TEST_CASE("madronalib/core/actor/producers", "[actor]")
+{
+  // messages sent from several threads at once all arrive.
+  constexpr int kProducers{4};
+  constexpr int kMessagesPerProducer{500};
+  CountingActor actor(Actor::kMultipleProducers);
+  actor.resizeQueue(kProducers * kMessagesPerProducer);
+  REQUIRE(actor.getQueueMode() == Actor::kMultipleProducers);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p)
+  {
+    producers.emplace_back([&]() {
+      for (int i = 0; i < kMessagesPerProducer; ++i)
+      {
+        actor.enqueueMessage(Message("test", 1));
+      }
+    });
+  }
+  for (auto& t : producers)
+  {
+    t.join();
+  }
+  actor.handleMessagesInQueue();
+  REQUIRE(actor.fullCount == 0);
+  REQUIRE(actor.count == kProducers * kMessagesPerProducer);
+  REQUIRE(actor.sum == kProducers * kMessagesPerProducer);
+
+  // a full queue is reported in either mode.
+  for (auto mode : {Actor::kSingleProducer, Actor::kMultipleProducers})
+  {
+    CountingActor small(mode);
+    small.resizeQueue(4);
+    for (int i = 0; i < 10; ++i)
+    {
+      small.enqueueMessage(Message("test", i));
+    }
+    REQUIRE(small.fullCount > 0);
+    small.handleMessagesInQueue();
+    REQUIRE(small.count + small.fullCount == 10);
+  }
+}
+
+TEST_CASE("madronalib/core/actor/thread", "[actor][thread]")
+{
+  // with its own thread, an Actor handles each message soon after it is
+  // sent, without polling.
+  constexpr int kMessages{20};
+  for (auto mode : {Actor::kSingleProducer, Actor::kMultipleProducers})
+  {
+    CountingActor actor(mode);
+    actor.startThread();
+    for (int i = 0; i < kMessages; ++i)
+    {
+      const int prevCount = actor.handled;
+      actor.enqueueMessage(Message("test", 1));
+      while (actor.handled == prevCount)
+      {
+        std::this_thread::yield();
+      }
+
+      // give the thread time to go back to sleep.
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    actor.stop();
+
+    REQUIRE(actor.count == kMessages);
+    REQUIRE(actor.getMessageLatency().getCount() == kMessages);
+    REQUIRE(actor.getHandlingTime().getCount() == kMessages);
+
+    // much less than a Timer interval, allowing for a slow machine.
+    REQUIRE(actor.getMessageLatency().getPercentile(0.5) < 0.01);
+  }
+}
+
+// counts messages and checks that it's never run by two workers at once.
+class ExclusiveActor : public Actor
+{
+ public:
+  ExclusiveActor() = default;
+  ~ExclusiveActor() { stop(); }
+
+  void onMessage(Message m) override
+  {
+    if (active.fetch_add(1) != 0)
+    {
+      overlaps++;
+    }
+    if (pForward)
+    {
+      pForward->enqueueMessage(m);
+    }
+    if (pStop)
+    {
+      pStop->stop();
+    }
+    handled++;
+    active--;
+  }
+
+  Actor* pForward{nullptr};
+  Actor* pStop{nullptr};
+  std::atomic<int> active{0};
+  std::atomic<int> overlaps{0};
+  std::atomic<int> handled{0};
+};
+
+TEST_CASE("madronalib/core/actor/runtime", "[actor][runtime]")
+{
+  // many Actors share a few workers, and every message is handled once.
+  constexpr int kActors{200};
+  constexpr int kMessagesPerActor{50};
+  ActorRuntime::Options options;
+  options.workers = 3;
+  options.messageBudget = 4;
+  ActorRuntime runtime(options);
+  REQUIRE(runtime.getWorkers() == 3);
+
+  std::vector<std::unique_ptr<ExclusiveActor> > actors;
+  for (int i = 0; i < kActors; ++i)
+  {
+    actors.emplace_back(std::make_unique<ExclusiveActor>());
+    actors.back()->start(runtime);
+  }
+  for (int j = 0; j < kMessagesPerActor; ++j)
+  {
+    for (auto& a : actors)
+    {
+      a->enqueueMessage(Message("test", j));
+    }
+  }
+  for (auto& a : actors)
+  {
+    while (a->handled < kMessagesPerActor)
+    {
+      std::this_thread::yield();
+    }
+  }
+  int overlaps{0};
+  for (auto& a : actors)
+  {
+    a->stop();
+    overlaps += a->overlaps;
+  }
+  REQUIRE(overlaps == 0);
+  REQUIRE(runtime.getActivations() >= kActors);
+
+  // with a budget of 4, a backlog of messages is handled over several
+  // activations.
+  ExclusiveActor backlogged;
+  for (int i = 0; i < 100; ++i)
+  {
+    backlogged.enqueueMessage(Message("test", i));
+  }
+  const auto activations = runtime.getActivations();
+  backlogged.start(runtime);
+  while (backlogged.handled < 100)
+  {
+    std::this_thread::yield();
+  }
+  backlogged.stop();
+  REQUIRE(runtime.getActivations() - activations >= 25);
+
+  // Actors sending to each other from the workers.
+  ExclusiveActor first, second;
+  first.pForward = &second;
+  first.start(runtime);
+  second.start(runtime);
+  for (int i = 0; i < 100; ++i)
+  {
+    first.enqueueMessage(Message("test", i));
+  }
+  while (second.handled < 100)
+  {
+    std::this_thread::yield();
+  }
+  first.stop();
+  second.stop();
+  REQUIRE(first.handled == 100);
+  REQUIRE(first.overlaps + second.overlaps == 0);
+
+  // an Actor stopping another one that is waiting behind it on the only
+  // worker. The stopped Actor is run while stop() waits.
+  options.workers = 1;
+  ActorRuntime oneWorker(options);
+  ExclusiveActor stopper, stopped;
+  stopper.pForward = &stopped;
+  stopper.pStop = &stopped;
+  stopper.start(oneWorker);
+  stopped.start(oneWorker);
+  stopper.enqueueMessage(Message("test", 1));
+  while (stopper.handled < 1)
+  {
+    std::this_thread::yield();
+  }
+  stopper.stop();
+  REQUIRE(stopped.handled == 1);
+}
+
+TEST_CASE("madronalib/core/actor/restart", "[actor][runtime]")
+{
+  // starting an Actor in one way stops it running in any other, so only one
+  // thread ever handles its messages.
+  SharedResourcePointer<Timers> timers;
+  timers->start();
+  ActorRuntime::Options options;
+  options.workers = 2;
+  ActorRuntime runtime(options);
+  ExclusiveActor actor;
+  int sent{0};
+  auto sendAndWait = [&]() {
+    for (int i = 0; i < 50; ++i)
+    {
+      actor.enqueueMessage(Message("test", i));
+    }
+    sent += 50;
+    while (actor.handled < sent)
+    {
+      std::this_thread::yield();
+    }
+  };
+
+  actor.start(runtime);
+  sendAndWait();
+  actor.startThread();
+  sendAndWait();
+  actor.start(runtime);
+  sendAndWait();
+  actor.start(1);
+  sendAndWait();
+  actor.startThread();
+  sendAndWait();
+  actor.stop();
+  REQUIRE(actor.overlaps == 0);
+}
+
+}  // namespace actorTest
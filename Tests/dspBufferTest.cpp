@@ -239,6 +239,206 @@ TEST_CASE("madronalib/core/dspbuffer/peek", "[dspbuffer][peek]")
   REQUIRE(floatVec[19] == 128);
 }
 
+TEST_CASE("madronalib/core/dspbuffer/regions", "[dspbuffer][regions]")
+{
+  DSPBuffer buf;
+  buf.resize(256);
+
+  // move the indices near the end so the regions wrap
+  std::vector<float> nines(256, 9.f);
+  buf.write(nines.data(), 250);
+  buf.read(nines.data(), 250);
+
+  // generate in place
+  auto w = buf.beginWrite(20);
+  REQUIRE(w.size1 == 6);
+  REQUIRE(w.size2 == 14);
+  for (size_t i = 0; i < w.size1; ++i) w.p1[i] = i;
+  for (size_t i = 0; i < w.size2; ++i) w.p2[i] = i + w.size1;
+  REQUIRE(buf.getReadAvailable() == 0);
+  buf.commitWrite(20);
+  REQUIRE(buf.getReadAvailable() == 20);
+
+  // consume in place, only as much as is available
+  auto r = buf.beginRead(100);
+  REQUIRE(r.size1 + r.size2 == 20);
+  REQUIRE(r.p1[5] == 5.f);
+  REQUIRE(r.p2[0] == 6.f);
+  buf.commitRead(r.size1 + r.size2);
+  REQUIRE(buf.getReadAvailable() == 0);
+
+  // beginWrite never offers more than the free space
+  buf.write(nines.data(), 200);
+  w = buf.beginWrite(100);
+  REQUIRE(w.size1 + w.size2 == 56);
+
+  // DSPVector-granular buffer
+  DSPVectorBuffer vb;
+  REQUIRE(vb.resize(3) == 4);
+  DSPVector x;
+  for (int i = 0; i < 10; ++i)
+  {
+    DSPVector* pw = vb.beginWriteVector();
+    REQUIRE(pw != nullptr);
+    REQUIRE((reinterpret_cast<uintptr_t>(pw->getConstBuffer()) & 15) == 0);
+    *pw = columnIndex() + DSPVector(i);
+    vb.commitWrite(1);
+    REQUIRE(vb.read(x));
+    REQUIRE(x == columnIndex() + DSPVector(i));
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    REQUIRE(vb.write(DSPVector(i)));
+  }
+  REQUIRE(!vb.write(DSPVector(4)));
+  auto vr = vb.beginRead(4);
+  REQUIRE(vr.size1 == 2);
+  REQUIRE(vr.size2 == 2);
+  REQUIRE(vr.p2[1] == DSPVector(3));
+  vb.commitRead(4);
+  REQUIRE(vb.beginReadVector() == nullptr);
+}
+
+TEST_CASE("madronalib/core/dspbuffer/multichannel", "[dspbuffer][multichannel]")
+{
+  // interleave round trips, with SIMD and scalar paths
+  for (size_t channels : {1, 2, 3, 8})
+  {
+    constexpr size_t kFrames{37};
+    std::vector<std::vector<float>> planar(channels, std::vector<float>(kFrames));
+    std::vector<std::vector<float>> planarOut(channels, std::vector<float>(kFrames));
+    std::vector<const float*> pSrc;
+    std::vector<float*> pDest;
+    for (size_t c = 0; c < channels; ++c)
+    {
+      for (size_t f = 0; f < kFrames; ++f)
+      {
+        planar[c][f] = f * 100 + c;
+      }
+      pSrc.push_back(planar[c].data());
+      pDest.push_back(planarOut[c].data());
+    }
+    std::vector<float> frames(kFrames * channels);
+    interleave(pSrc.data(), channels, frames.data(), kFrames);
+    REQUIRE(frames[channels * 5 + channels - 1] == 500 + channels - 1);
+    deinterleave(frames.data(), channels, pDest.data(), kFrames);
+    REQUIRE(planarOut == planar);
+  }
+
+  // ring buffers in both layouts, converting and wrapping
+  for (auto layout : {MultiChannelDSPBuffer::kPlanar, MultiChannelDSPBuffer::kInterleaved})
+  {
+    constexpr size_t kChannels{4};
+    MultiChannelDSPBuffer buf;
+    REQUIRE(buf.resize(kChannels, 200, layout) == 256);
+
+    // move the indices near the end
+    std::vector<float> zeros(256 * kChannels);
+    buf.writeInterleaved(zeros.data(), 250);
+    REQUIRE(buf.readInterleaved(zeros.data(), 256) == 250);
+
+    DSPVectorArray<kChannels> x = map([](DSPVector v, int row) { return v + DSPVector(row * 1000); },
+                                      repeatRows<kChannels>(columnIndex()));
+    buf.write(x);
+    REQUIRE(buf.getReadAvailable() == kFloatsPerDSPVector);
+
+    // read as interleaved frames
+    std::vector<float> frames(kFloatsPerDSPVector * kChannels);
+    REQUIRE(buf.readInterleaved(frames.data(), kFloatsPerDSPVector) == kFloatsPerDSPVector);
+    REQUIRE(frames[10 * kChannels + 2] == 2010.f);
+
+    // write interleaved, read as vectors with extra rows zeroed
+    buf.writeInterleaved(frames.data(), kFloatsPerDSPVector);
+    DSPVectorArray<kChannels + 1> y(1.f);
+    REQUIRE(buf.read(y));
+    REQUIRE(y.constRow(3) == x.constRow(3));
+    REQUIRE(y.constRow(kChannels) == DSPVector(0.f));
+    REQUIRE(!buf.read(y));
+
+    // planar pointers, with a silent input and a skipped output
+    const float* pIn[kChannels]{x.getRowDataConst(0), nullptr, x.getRowDataConst(2),
+                                x.getRowDataConst(3)};
+    buf.write(pIn, 40);
+    DSPVector out0, out1;
+    float* pOut[kChannels]{out0.getBuffer(), out1.getBuffer(), nullptr, nullptr};
+    REQUIRE(buf.read(pOut, 100) == 40);
+    REQUIRE(out0[39] == 39.f);
+    REQUIRE(out1[39] == 0.f);
+  }
+}
+
+TEST_CASE("madronalib/core/dspbuffer/process", "[dspbuffer][process]")
+{
+  constexpr int kMaxFrames{512};
+  constexpr int kChannels{2};
+  VectorProcessBuffer buf(kChannels, kChannels, kMaxFrames);
+
+  // a stereo ramp in, passed straight through.
+  alignas(16) float inputData[kChannels][kMaxFrames];
+  alignas(16) float outputData[kChannels][kMaxFrames];
+  const float* inputs[kChannels]{inputData[0], inputData[1]};
+  float* outputs[kChannels]{outputData[0], outputData[1]};
+  int inPlaceVectors{0};
+  auto passThrough = [&](MainInputs ins, MainOutputs outs, void*)
+  {
+    const float* pIn = ins[0].getConstBuffer();
+    inPlaceVectors += (pIn >= inputData[0]) && (pIn < inputData[0] + kMaxFrames);
+    for (int c = 0; c < kChannels; ++c)
+    {
+      outs[c] = ins[c];
+    }
+  };
+
+  // after the first partial block, one vector of silence is inserted into
+  // the outputs where the latency starts.
+  constexpr int kGapStart{256 + 64 + kFloatsPerDSPVector};
+  constexpr int kGapEnd{kGapStart + kFloatsPerDSPVector};
+  int inputFrame{0};
+  int outputFrame{0};
+  auto runBlock = [&](int nFrames)
+  {
+    for (int i = 0; i < nFrames; ++i, ++inputFrame)
+    {
+      inputData[0][i] = inputFrame;
+      inputData[1][i] = -inputFrame;
+    }
+    buf.process(inputs, outputs, nFrames, passThrough);
+    for (int i = 0; i < nFrames; ++i, ++outputFrame)
+    {
+      float expected = (outputFrame < kGapStart) ? outputFrame
+                       : (outputFrame < kGapEnd) ? 0.f
+                                                 : outputFrame - kFloatsPerDSPVector;
+      if ((outputData[0][i] != expected) || (outputData[1][i] != -expected)) return false;
+    }
+    return true;
+  };
+
+  // blocks that are multiples of a vector run in place with no latency.
+  REQUIRE(runBlock(256));
+  REQUIRE(runBlock(64));
+  REQUIRE(inPlaceVectors == 5);
+  REQUIRE(buf.getLatency() == 0);
+
+  // a partial block runs its remainder through the buffers, after which the
+  // latency stays constant.
+  REQUIRE(runBlock(100));
+  REQUIRE(inPlaceVectors == 6);
+  REQUIRE(buf.getLatency() == kFloatsPerDSPVector);
+  for (int nFrames : {1, 512, 37, 64, 128, 300})
+  {
+    REQUIRE(runBlock(nFrames));
+  }
+  REQUIRE(buf.getLatency() == kFloatsPerDSPVector);
+
+  // once the input is back on a vector boundary, the vectors of aligned
+  // blocks after the buffered vector run in place again.
+  REQUIRE(runBlock(10));
+  int prevInPlaceVectors = inPlaceVectors;
+  REQUIRE(runBlock(256));
+  REQUIRE(inPlaceVectors - prevInPlaceVectors == 3);
+  REQUIRE(buf.getLatency() == kFloatsPerDSPVector);
+}
+
 TEST_CASE("madronalib/core/dspbuffer/vector", "[dspbuffer][peek]")
 {
 
@@ -59,3 +59,51 @@ TEST_CASE("madronalib/core/dsp_filters", "[dsp_filters]")
     DSPVector sineOut = downer.read();
   }
 }
+
+TEST_CASE("madronalib/core/dsp_filters/modal", "[dsp_filters]")
+{
+  constexpr size_t kModes{6};
+  std::array<float, kModes> omegas{0.01f, 0.023f, 0.05f, 0.11f, 0.2f, 0.31f};
+  std::array<float, kModes> decays{1000.f, 800.f, 600.f, 400.f, 300.f, 200.f};
+  std::array<float, kModes> gains{1.f, 0.5f, 0.25f, 0.5f, 0.125f, 0.25f};
+
+  // setting modes one at a time or all at once should make the same filters.
+  ModalBank<kModes, 2> bank1, bank2;
+  bank1.setModes(omegas, decays, gains);
+  for (int i = 0; i < kModes; ++i)
+  {
+    bank2.setMode(i, omegas[i], decays[i], gains[i]);
+    bank2.setOutputGain(1, i, (i & 1) ? 1.f : 0.f);
+    bank1.setOutputGain(1, i, (i & 1) ? 1.f : 0.f);
+  }
+
+  // compare impulse responses to a sum of decaying sines.
+  DSPVector impulse{0.f};
+  impulse[0] = 1.f;
+  float maxErr{0.f};
+  for (int v = 0; v < 4; ++v)
+  {
+    auto y1 = bank1(impulse);
+    auto y2 = bank2(impulse);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      int n = v * kFloatsPerDSPVector + i;
+      float sumAll{0.f}, sumOdd{0.f};
+      for (int m = 0; m < kModes; ++m)
+      {
+        float r = powf(10.f, -3.f / decays[m]);
+        float y = gains[m] * powf(r, n) * sinf((n + 1) * kTwoPi * omegas[m]);
+        sumAll += y;
+        if (m & 1) sumOdd += y;
+      }
+      maxErr = std::max(maxErr, fabsf(y1.constRow(0)[i] - sumAll));
+      maxErr = std::max(maxErr, fabsf(y1.constRow(1)[i] - sumOdd));
+      maxErr = std::max(maxErr, fabsf(y2.constRow(0)[i] - sumAll));
+    }
+    impulse = DSPVector{0.f};
+  }
+  REQUIRE(maxErr < 1e-3f);
+
+  bank1.clear();
+  REQUIRE(sum(abs(bank1(DSPVector{0.f}).constRow(0))) == 0.f);
+}
@@ -45,3 +45,123 @@ TEST_CASE("madronalib/core/dsp_gens", "[dsp_gens]")
 
   
 }
+
+TEST_CASE("madronalib/core/dsp_gens/noise", "[dsp_gens]")
+{
+  // SIMD NoiseGen should match stepping the generator one sample at a time.
+  NoiseGen n1, n2;
+  n1.setSeed(12345);
+  n2.setSeed(12345);
+  for (int v = 0; v < 3; ++v)
+  {
+    DSPVector y = n1();
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      REQUIRE(y[i] == n2.getSample());
+    }
+  }
+
+  // Philox2x32-10 known answer test from Random123.
+  uint32_t c0{0}, c1{0};
+  philox::scramble(0, c0, c1);
+  REQUIRE(c0 == 0xff1dae59);
+  REQUIRE(c1 == 0x6cd10df2);
+
+  // white noise vectors should match scalar samples from any position.
+  WhiteNoiseGen w1(7), w2(7);
+  for (uint64_t start : {0ULL, 17ULL, (1ULL << 33) - 5ULL})
+  {
+    w1.seek(start);
+    w2.seek(start);
+    DSPVector y = w1();
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      REQUIRE(y[i] == w2.getSample());
+    }
+  }
+
+  // the output depends only on the seed and position.
+  w1.seek(64);
+  DSPVector a = w1();
+  w2.seek(0);
+  w2();
+  DSPVector b = w2();
+  REQUIRE(a == b);
+  WhiteNoiseGen w3(8);
+  w3.seek(64);
+  REQUIRE(!(w3() == a));
+
+  // check range and mean of white noise, and that pink and brown noise have
+  // about the same RMS.
+  WhiteNoiseGen white;
+  PinkNoiseGen pink;
+  BrownNoiseGen brown;
+  constexpr int kVectors{1000};
+  float minVal{0.f}, maxVal{0.f}, sumWhite{0.f};
+  float powWhite{0.f}, powPink{0.f}, powBrown{0.f};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    DSPVector w = white();
+    minVal = std::min(minVal, min(w));
+    maxVal = std::max(maxVal, max(w));
+    sumWhite += sum(w);
+    powWhite += sum(w * w);
+    DSPVector p = pink();
+    powPink += sum(p * p);
+    DSPVector r = brown();
+    powBrown += sum(r * r);
+  }
+  REQUIRE(minVal >= -1.f);
+  REQUIRE(maxVal < 1.f);
+  REQUIRE(fabs(sumWhite / (kVectors * kFloatsPerDSPVector)) < 0.01f);
+  REQUIRE(within(powPink / powWhite, 0.5f, 2.f));
+  REQUIRE(within(powBrown / powWhite, 0.5f, 2.f));
+}
+
+TEST_CASE("madronalib/core/dsp_gens/impulse", "[dsp_gens]")
+{
+  // the first impulse should be centered at the exact phase crossing, delayed by
+  // half the kernel size.
+  constexpr float kPeriod{20.3f};
+  ImpulseGen g1;
+  DSPVector y = g1(DSPVector(1.f / kPeriod));
+  float moment{0.f}, area{0.f};
+  for (int i = 0; i < kFloatsPerDSPVector / 2 + 4; ++i)
+  {
+    moment += y[i] * i;
+    area += y[i];
+  }
+  float expectedCenter = kPeriod - 1.f + ImpulseGen::kKernelSize / 2;
+  REQUIRE(fabs(area - 1.f) < 0.001f);
+  REQUIRE(fabs(moment / area - expectedCenter) < 0.01f);
+
+  // impulses have unity area, so the mean output is the frequency, even when
+  // impulses overlap. Impulses in the last kKernelSize / 2 samples are not out yet.
+  for (float period : {3.7f, 50.f, 211.f})
+  {
+    ImpulseGen g2;
+    constexpr int kVectors{500};
+    float total{0.f};
+    for (int v = 0; v < kVectors; ++v)
+    {
+      total += sum(g2(DSPVector(1.f / period)));
+    }
+    float expected = (kVectors * kFloatsPerDSPVector - ImpulseGen::kKernelSize / 2) / period;
+    REQUIRE(fabs(total - expected) < 1.f);
+  }
+
+  // a bank should match individual generators.
+  constexpr int kRows{3};
+  ImpulseGenBank<kRows> bank;
+  std::array<ImpulseGen, kRows> gens;
+  DSPVectorArray<kRows> freqs;
+  for (int j = 0; j < kRows; ++j)
+  {
+    freqs.row(j) = DSPVector(0.01f + 0.07f * j);
+  }
+  auto vBank = bank(freqs);
+  for (int j = 0; j < kRows; ++j)
+  {
+    REQUIRE(vBank.constRow(j) == gens[j](freqs.constRow(j)));
+  }
+}
@@ -0,0 +1,301 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "catch.hpp"
+#include "testUtils.h"
+#include "MLDSPSample.h"
+#include "MLDSPGranulator.h"
+#include "MLDSPSamplePlayer.h"
+
+using namespace ml;
+
+TEST_CASE("madronalib/core/dsp_sample/read", "[dsp_sample]")
+{
+  // stereo ramp: channel 0 = frame, channel 1 = -frame
+  constexpr size_t kFrames{100};
+  Sample ramp;
+  resize(ramp, kFrames, 2);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    getFramePtr(ramp, i)[0] = i;
+    getFramePtr(ramp, i)[1] = -(float)i;
+  }
+
+  // interpolate between frames, with negative offsets
+  DSPVector offsets = columnIndex() * DSPVector(0.5f) - DSPVector(2.f);
+  DSPVector y0 = readLinear(ramp, 0, 10, offsets);
+  DSPVector y1 = readLinear(ramp, 1, 10, offsets);
+  REQUIRE(y0 == offsets + DSPVector(10.f));
+  REQUIRE(y1 == DSPVector(0.f) - (offsets + DSPVector(10.f)));
+
+  // frames outside the sample read as 0
+  DSPVector y2 = readLinear(ramp, 0, kFrames - 10, columnIndex());
+  REQUIRE(y2[9] == kFrames - 1);
+  REQUIRE(y2[10] == 0.f);
+  DSPVector y3 = readLinear(ramp, 0, -20, columnIndex());
+  REQUIRE(y3[19] == 0.f);
+  REQUIRE(y3[20] == 0.f);
+  REQUIRE(y3[21] == 1.f);
+}
+
+TEST_CASE("madronalib/core/dsp_sample/granulator", "[dsp_sample]")
+{
+  Sample dc;
+  resize(dc, 10000);
+  std::fill(dc.sampleData.begin(), dc.sampleData.end(), 1.f);
+
+  // raised cosine windows overlapping by 4 should sum to about 2.
+  constexpr float kInterval{100.f};
+  constexpr float kDuration{400.f};
+  Granulator<16, 2> grains;
+  grains.setSource(0, &dc);
+  float total{0.f};
+  constexpr int kVectors{100};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    auto y = grains(DSPVector(1.f / kInterval), DSPVector(0.25f), DSPVector(1.f),
+                    DSPVector(kDuration), DSPVector(0.1f));
+    REQUIRE(y.constRow(0) == y.constRow(1));
+    if (v >= kVectors / 2)
+    {
+      total += sum(y.constRow(0));
+    }
+  }
+  float mean = total / (kVectors / 2 * kFloatsPerDSPVector);
+  REQUIRE(fabs(mean - 2.f) < 0.05f);
+  REQUIRE(grains.getActiveGrains() <= 5);
+  REQUIRE(grains.getDroppedGrains() == 0);
+
+  // a small pool should drop grains rather than allocate.
+  Granulator<2> fewGrains;
+  fewGrains.setSource(0, &dc);
+  for (int v = 0; v < kVectors; ++v)
+  {
+    fewGrains(DSPVector(1.f / kInterval), DSPVector(0.5f), DSPVector(-1.f), DSPVector(kDuration),
+              DSPVector(0.f));
+  }
+  REQUIRE(fewGrains.getActiveGrains() == 2);
+  REQUIRE(fewGrains.getDroppedGrains() > 0);
+
+  // removing a source should let its playing grains finish, and start no more.
+  grains.setSource(0, nullptr);
+  float removedTotal{0.f};
+  for (int v = 0; v < kVectors; ++v)
+  {
+    auto y = grains(DSPVector(1.f / kInterval), DSPVector(0.25f), DSPVector(1.f),
+                    DSPVector(kDuration), DSPVector(0.1f));
+    removedTotal += sum(y.constRow(0));
+  }
+  REQUIRE(removedTotal > 0.f);
+  REQUIRE(grains.getActiveGrains() == 0);
+}
+
+TEST_CASE("madronalib/core/dsp_sample/player", "[dsp_sample]")
+{
+  constexpr size_t kFrames{1000};
+  Sample ramp;
+  resize(ramp, kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    ramp[i] = i;
+  }
+
+  // Hermite interpolation is exact on a ramp.
+  SamplePlayer<2> player;
+  player.setSample(&ramp);
+  player.trigger(100.);
+  auto y = player(DSPVector(0.5f));
+  REQUIRE(y.constRow(0) == columnIndex() * DSPVector(0.5f) + DSPVector(100.f));
+  REQUIRE(y.constRow(1) == y.constRow(0));
+  REQUIRE(player.getPosition() == 100. + kFloatsPerDSPVector * 0.5);
+
+  // windowed sinc, on a sine at a fraction of sr / 2.
+  Sample sine;
+  resize(sine, kFrames);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    sine[i] = sinf(kTwoPi * i / 32.f);
+  }
+  SamplePlayer<> sincPlayer;
+  sincPlayer.setSample(&sine);
+  sincPlayer.setInterpolation(SamplePlayer<>::kSinc);
+  sincPlayer.trigger(200.25);
+  DSPVector pitch = DSPVector(0.75f) + columnIndex() * DSPVector(0.01f);
+  DSPVector ys = sincPlayer(pitch);
+  float position{200.25f};
+  float maxError{0.f};
+  for (int i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    maxError = max(maxError, fabsf(ys[i] - sinf(kTwoPi * position / 32.f)));
+    position += pitch[i];
+  }
+  REQUIRE(maxError < 0.01f);
+
+  // loop wraps, with and without a crossfade.
+  player.setLoop(200, 300);
+  player.trigger(250.);
+  y = player(DSPVector(1.f));
+  REQUIRE(y.constRow(0)[49] == 299.f);
+  REQUIRE(y.constRow(0)[50] == 200.f);
+  REQUIRE(player.getPosition() == 214.);
+
+  player.setLoop(200, 300, 50);
+  player.trigger(250.);
+  y = player(DSPVector(1.f));
+  REQUIRE(y.constRow(0)[0] == 250.f);
+  REQUIRE(y.constRow(0)[25] == lerp(275.f, 175.f, 0.5f));
+  REQUIRE(y.constRow(0)[50] == 200.f);
+
+  // a loop shorter than a vector wraps more than once.
+  player.setLoop(10, 20);
+  player.trigger(10.);
+  y = player(DSPVector(1.f));
+  REQUIRE(y.constRow(0)[0] == 10.f);
+  REQUIRE(y.constRow(0)[35] == 15.f);
+
+  // without a loop, playing stops after the end of the sample.
+  player.clearLoop();
+  player.trigger(kFrames - 100.);
+  for (int v = 0; v < 10; ++v)
+  {
+    player(DSPVector(1.f));
+  }
+  REQUIRE(!player.isPlaying());
+
+  // played backwards, a looping voice runs back through the loop start and
+  // stops at the start of the sample.
+  player.setLoop(200, 300);
+  player.trigger(250.);
+  y = player(DSPVector(-1.f));
+  REQUIRE(y.constRow(0)[60] == 190.f);
+  for (int v = 0; v < 10; ++v)
+  {
+    player(DSPVector(-1.f));
+  }
+  REQUIRE(!player.isPlaying());
+
+  // a bank of voices mixed to one output.
+  Sample dc;
+  resize(dc, 100000);
+  std::fill(dc.sampleData.begin(), dc.sampleData.end(), 1.f);
+  constexpr size_t kVoices{64};
+  SamplerBank<kVoices> bank;
+  for (size_t v = 0; v < kVoices; ++v)
+  {
+    bank[v].setSample(&dc);
+    bank[v].trigger(v * 100.);
+  }
+  REQUIRE(bank.getPlayingVoices() == kVoices);
+  DSPVectorArray<kVoices> pitches(1.5f);
+  DSPVectorArray<kVoices> gains(1.f / kVoices);
+  DSPVector mix = bank(pitches, gains);
+  REQUIRE(max(abs(mix - DSPVector(1.f))) < 0.001f);
+}
+
+TEST_CASE("madronalib/core/dsp_sample/utilities", "[dsp_sample]")
+{
+  // a three-channel ramp with an odd number of frames, so the SIMD and scalar
+  // paths are both used. Channel c of frame i is (i + 1) * (c + 1), negated
+  // in channel 1.
+  constexpr size_t kFrames{1001};
+  Sample s;
+  resize(s, kFrames, 3);
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    for (size_t c = 0; c < 3; ++c)
+    {
+      float x = (i + 1.f) * (c + 1.f);
+      getFramePtr(s, i)[c] = (c == 1) ? -x : x;
+    }
+  }
+
+  // peaks, including negative ones, and RMS.
+  REQUIRE(findMaximumValue(s) == kFrames * 3.f);
+  REQUIRE(findPeak(s) == kFrames * 3.f);
+  REQUIRE(findPeak(s, 0) == kFrames);
+  REQUIRE(findPeak(s, 1) == kFrames * 2.f);
+  double sumSq{0.};
+  for (size_t i = 1; i <= kFrames; ++i)
+  {
+    sumSq += double(i) * i;
+  }
+  const float rms0 = static_cast<float>(std::sqrt(sumSq / kFrames));
+  REQUIRE(fabs(findRMS(s, 0) - rms0) < rms0 * 1e-6f);
+  REQUIRE(fabs(findRMS(s, 1) - rms0 * 2.f) < rms0 * 1e-6f);
+  REQUIRE(fabs(findRMS(s) - rms0 * sqrtf(14.f / 3.f)) < rms0 * 1e-5f);
+
+  // normalize uses the absolute peak, and leaves silence alone.
+  Sample neg;
+  resize(neg, 7);
+  neg.sampleData = {0.f, 0.25f, -0.5f, 0.1f, 0.f, 0.f, 0.f};
+  normalize(neg);
+  REQUIRE(neg[2] == -1.f);
+  REQUIRE(neg[1] == 0.5f);
+  Sample silent;
+  resize(silent, 100);
+  normalize(silent);
+  REQUIRE(findPeak(silent) == 0.f);
+
+  // extract and insert channels, for each SIMD path and the general one.
+  for (size_t channels : {1, 2, 3, 4, 5})
+  {
+    Sample t;
+    resize(t, kFrames, channels);
+    std::vector<float> ch(kFrames);
+    for (size_t c = 0; c < channels; ++c)
+    {
+      for (size_t i = 0; i < kFrames; ++i)
+      {
+        ch[i] = i * 10.f + c;
+      }
+      insertChannel(ch.data(), t, c);
+    }
+    bool ok{true};
+    for (size_t i = 0; i < getSize(t); ++i)
+    {
+      ok &= (t[i] == (i / channels) * 10.f + (i % channels));
+    }
+    for (size_t c = 0; c < channels; ++c)
+    {
+      extractChannel(t, c, ch.data());
+      for (size_t i = 0; i < kFrames; ++i)
+      {
+        ok &= (ch[i] == i * 10.f + c);
+      }
+    }
+    REQUIRE(ok);
+  }
+
+  // load frames into a DSPVectorArray and store them back.
+  DSPVectorArray<3> frames = loadFrames<3>(s, 100);
+  REQUIRE(frames.constRow(0)[0] == 101.f);
+  REQUIRE(frames.constRow(1)[63] == -328.f);
+  REQUIRE(frames.constRow(2)[1] == 306.f);
+
+  // past the end reads 0, and a mono Sample fills every row.
+  frames = loadFrames<3>(s, kFrames - 10);
+  REQUIRE(frames.constRow(0)[9] == kFrames);
+  REQUIRE(frames.constRow(0)[10] == 0.f);
+  Sample mono;
+  resize(mono, 100);
+  mono[5] = 1.f;
+  DSPVectorArray<2> fromMono = loadFrames<2>(getView(mono), 0);
+  REQUIRE(fromMono.constRow(1)[5] == 1.f);
+
+  Sample out;
+  resize(out, kFrames, 3);
+  for (size_t f = 0; f < kFrames; f += kFloatsPerDSPVector)
+  {
+    storeFrames(loadFrames<3>(s, f), out, f);
+  }
+  REQUIRE(out.sampleData == s.sampleData);
+
+  // storing fewer rows than channels leaves the other channels alone.
+  storeFrames(DSPVectorArray<2>(7.f), out, 0);
+  REQUIRE(out[0] == 7.f);
+  REQUIRE(out[1] == 7.f);
+  REQUIRE(out[2] == 3.f);
+}
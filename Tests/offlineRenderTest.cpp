@@ -0,0 +1,144 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <cstdio>
+
+#include "MLOfflineRenderer.h"
+#include "catch.hpp"
+
+using namespace ml;
+
+namespace offlineRenderTest
+{
+// a processor that outputs the seconds signal from its ProcessTime.
+class TimeProcessor : public SignalProcessor
+{
+ public:
+  TimeProcessor() : SignalProcessor(0, 1) {}
+
+  void processVector(MainInputs, MainOutputs outputs, void*) override
+  {
+    _currentTime.process();
+    outputs[0] = _currentTime._seconds;
+  }
+
+  float getSampleRate() const { return _sampleRate; }
+};
+
+// state for a test function: output 0 counts frames, and output 1 is input 0
+// times a gain set by automation.
+struct CounterState
+{
+  float count{0.f};
+  float gain{1.f};
+  std::vector<size_t> eventFrames;
+  size_t vectors{0};
+};
+
+void counterFn(MainInputs ins, MainOutputs outs, void* pState)
+{
+  auto& state = *static_cast<CounterState*>(pState);
+  outs[0] = columnIndex() + DSPVector(state.count);
+  outs[1] = ins[0] * DSPVector(state.gain);
+  state.count += kFloatsPerDSPVector;
+  state.vectors++;
+}
+
+OfflineRenderer::Job makeCounterJob(CounterState& state, const Sample& input, Sample& output)
+{
+  OfflineRenderer::Job job;
+  job.processFn = counterFn;
+  job.processState = &state;
+  job.paramFn = [&state](Path, float value) { state.gain = value; };
+  job.eventFn = [&state](const EventsToSignals::Event& e) {
+    state.eventFrames.push_back(state.vectors * kFloatsPerDSPVector + e.time);
+  };
+  job.inputs = 1;
+  job.outputs = 2;
+  job.frames = 10000;
+  job.pInput = &input;
+  job.pOutput = &output;
+  job.automation = {{5000, "gain", 0.25f}, {1000, "gain", 0.5f}};
+  EventsToSignals::Event e;
+  e.type = kNoteOn;
+  job.events = {{4321, e}, {7, e}};
+  return job;
+}
+
+TEST_CASE("madronalib/core/offline_render", "[offline_render]")
+{
+  Sample input;
+  resize(input, 8000, 1);
+  for (size_t i = 0; i < 8000; ++i)
+  {
+    input[i] = 1.f;
+  }
+
+  OfflineRenderer renderer(4);
+  CounterState state;
+  Sample output;
+  OfflineRenderer::Job job = makeCounterJob(state, input, output);
+  const char* kPath = "madronalib_test_render.wav";
+  job.outputPath = kPath;
+  OfflineRenderer::Result result = renderer.render(job);
+  REQUIRE(result.ok);
+  REQUIRE(result.frames == 10000);
+  REQUIRE(result.realtimeMultiple > 0.);
+
+  // outputs, automation applied at the start of the vector containing each
+  // change, and zero input after the end of the input Sample.
+  REQUIRE(getFrames(output) == 10000);
+  REQUIRE(output.channels == 2);
+  REQUIRE(output[9999 * 2] == 9999.f);
+  REQUIRE(output[959 * 2 + 1] == 1.f);
+  REQUIRE(output[960 * 2 + 1] == 0.5f);
+  REQUIRE(output[4991 * 2 + 1] == 0.5f);
+  REQUIRE(output[4992 * 2 + 1] == 0.25f);
+  REQUIRE(output[8000 * 2 + 1] == 0.f);
+  REQUIRE(state.eventFrames == std::vector<size_t>{7, 4321});
+
+  // the file matches the Sample.
+  Sample fromFile;
+  REQUIRE(readAudioFile(kPath, fromFile));
+  REQUIRE(fromFile.sampleData == output.sampleData);
+  std::remove(kPath);
+
+  // jobs rendered in parallel give the same results.
+  constexpr size_t kJobs{8};
+  std::vector<CounterState> states(kJobs);
+  std::vector<Sample> outputs(kJobs);
+  std::vector<OfflineRenderer::Job> jobs;
+  for (size_t i = 0; i < kJobs; ++i)
+  {
+    jobs.push_back(makeCounterJob(states[i], input, outputs[i]));
+  }
+  auto results = renderer.render(jobs);
+  for (size_t i = 0; i < kJobs; ++i)
+  {
+    REQUIRE(results[i].ok);
+    REQUIRE(outputs[i].sampleData == output.sampleData);
+  }
+
+  // a SignalProcessor gets host time at each block, and ProcessTime follows
+  // it from the second block, once the transport is seen moving.
+  TimeProcessor proc;
+  Sample timeOutput;
+  OfflineRenderer::Job timeJob;
+  timeJob.pProcessor = &proc;
+  timeJob.outputs = 1;
+  timeJob.frames = 4096;
+  timeJob.sampleRate = 44100.;
+  timeJob.pOutput = &timeOutput;
+  REQUIRE(renderer.render(timeJob).ok);
+  REQUIRE(proc.getSampleRate() == 44100.f);
+  REQUIRE(timeOutput[0] == -1.f);
+  for (size_t frame : {512, 1000, 3000, 4095})
+  {
+    REQUIRE(fabs(timeOutput[frame] - frame / 44100.f) < 1e-5f);
+  }
+}
+
+}  // namespace offlineRenderTest
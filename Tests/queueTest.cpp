@@ -120,4 +120,304 @@ TEST_CASE("madronalib/core/queue/available", "[queue][available]")
   REQUIRE(testQueue.elementsAvailable() == testQueue.size() - 1);
 }
 
+TEST_CASE("madronalib/core/queue/work_stealing", "[queue][work_stealing]")
+{
+  // the owner pops the newest elements and thieves get the oldest.
+  WorkStealingDeque<int> deque(4);
+  REQUIRE(deque.size() == 4);
+  for (int i = 0; i < 4; ++i)
+  {
+    REQUIRE(deque.push(i));
+  }
+  REQUIRE(!deque.push(4));
+  int x{-1};
+  REQUIRE(deque.pop(x));
+  REQUIRE(x == 3);
+  REQUIRE(deque.steal(x));
+  REQUIRE(x == 0);
+
+  // each element is taken exactly once while thieves race the owner.
+  constexpr int kElements{100000};
+  constexpr int kThieves{3};
+  WorkStealingDeque<int> shared(1024);
+  std::vector<std::atomic<int> > taken(kElements);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < kThieves; ++t)
+  {
+    thieves.emplace_back([&]() {
+      int e;
+      while (!done || !shared.wasEmpty())
+      {
+        if (shared.steal(e)) taken[e]++;
+      }
+    });
+  }
+  int next{0};
+  while (next < kElements)
+  {
+    if (!shared.push(next))
+    {
+      int e;
+      if (shared.pop(e)) taken[e]++;
+      continue;
+    }
+    next++;
+  }
+  int e;
+  while (shared.pop(e)) taken[e]++;
+  done = true;
+  for (auto& t : thieves)
+  {
+    t.join();
+  }
+  bool once{true};
+  for (auto& n : taken)
+  {
+    once &= (n == 1);
+  }
+  REQUIRE(once);
+}
+
+TEST_CASE("madronalib/core/queue/mpmc", "[queue][mpmc]")
+{
+  MPMCQueue<int> q(4);
+  REQUIRE(q.size() == 4);
+  for (int i = 0; i < 4; ++i)
+  {
+    REQUIRE(q.push(i));
+  }
+  REQUIRE(!q.push(4));
+  REQUIRE(q.wasFull());
+  REQUIRE(q.elementsAvailable() == 4);
+  REQUIRE(q.pop() == 0);
+  q.clear();
+  REQUIRE(q.wasEmpty());
+
+  // each element pushed by several producers is popped once by one of
+  // several consumers.
+  constexpr int kProducers{4};
+  constexpr int kConsumers{2};
+  constexpr int kElementsPerProducer{20000};
+  MPMCQueue<int> shared(256);
+  std::vector<std::atomic<int> > popped(kProducers * kElementsPerProducer);
+  std::atomic<int> producersDone{0};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p)
+  {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < kElementsPerProducer; ++i)
+      {
+        while (!shared.push(p * kElementsPerProducer + i))
+        {
+          std::this_thread::yield();
+        }
+      }
+      producersDone++;
+    });
+  }
+  for (int c = 0; c < kConsumers; ++c)
+  {
+    threads.emplace_back([&]() {
+      int e;
+      while ((producersDone < kProducers) || !shared.wasEmpty())
+      {
+        if (shared.pop(e)) popped[e]++;
+      }
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  bool once{true};
+  for (auto& n : popped)
+  {
+    once &= (n == 1);
+  }
+  REQUIRE(once);
+}
+
+TEST_CASE("madronalib/core/queue/batch", "[queue][batch]")
+{
+  Queue<int> q(10);
+  int in[16], out[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    in[i] = i;
+  }
+
+  // a batch larger than the free space is cut short.
+  REQUIRE(q.pushN(in, 16) == 15);
+  REQUIRE(q.wasFull());
+  REQUIRE(q.popN(out, 4) == 4);
+  REQUIRE(out[3] == 3);
+
+  // batches wrap around the end of the storage.
+  REQUIRE(q.pushN(in, 4) == 4);
+  REQUIRE(q.elementsAvailable() == 15);
+  REQUIRE(q.popN(out, 16) == 15);
+  bool inOrder{true};
+  for (int i = 0; i < 15; ++i)
+  {
+    inOrder &= (out[i] == ((i < 11) ? i + 4 : i - 11));
+  }
+  REQUIRE(inOrder);
+  REQUIRE(q.popN(out, 16) == 0);
+  REQUIRE(q.wasEmpty());
+
+  // batches and single elements mix.
+  q.push(100);
+  REQUIRE(q.pushN(in, 2) == 2);
+  REQUIRE(q.pop() == 100);
+  REQUIRE(q.popN(out, 2) == 2);
+  REQUIRE(out[1] == 1);
+}
+
+TEST_CASE("madronalib/core/queue/move", "[queue][move]")
+{
+  Queue<Message> q(4);
+
+  // a blob too big for a Value's local storage is moved, not copied.
+  std::vector<uint8_t> bigBlob(Value::kLocalDataBytes * 2, 7);
+  Message m("a/b", Value(bigBlob));
+  const void* pBlob = m.value.getBlobData();
+  REQUIRE(q.push(std::move(m)));
+  REQUIRE(q.emplace(Path("c/d"), Value("text"), kMsgFromUI));
+
+  Message received;
+  REQUIRE(q.pop(received));
+  REQUIRE(received.address == Path("a/b"));
+  REQUIRE(received.value.getBlobData() == pBlob);
+  REQUIRE(received.value.getBlobSize() == bigBlob.size());
+
+  received = q.pop();
+  REQUIRE(received.address == Path("c/d"));
+  REQUIRE(received.value.getTextValue() == "text");
+  REQUIRE(received.flags == kMsgFromUI);
+  REQUIRE(!q.pop());
+}
+
+// push and pop throughput with 1 to 8 producers and one consumer. Run with
+// the [benchmark] tag.
+template <typename QueueType>
+double queueThroughput(QueueType& q, int producers, int elementsPerProducer)
+{
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p)
+  {
+    threads.emplace_back([&]() {
+      while (!go)
+      {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < elementsPerProducer; ++i)
+      {
+        while (!q.push(i))
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  const auto start = std::chrono::steady_clock::now();
+  go = true;
+  int e, received{0};
+  while (received < producers * elementsPerProducer)
+  {
+    if (q.pop(e))
+    {
+      received++;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+  return received / elapsed.count();
+}
+
+// single-producer throughput with a given payload, pushing and popping one
+// element at a time or in batches of up to kBatch.
+template <typename Element, bool batch>
+double payloadThroughput(const Element& payload, int elements)
+{
+  constexpr int kBatch{32};
+  Queue<Element> q(1024);
+  std::thread producer([&]() {
+    Element items[kBatch];
+    for (auto& item : items)
+    {
+      item = payload;
+    }
+    int sent{0};
+    while (sent < elements)
+    {
+      int n;
+      if (batch)
+      {
+        n = static_cast<int>(q.pushN(items, std::min(kBatch, elements - sent)));
+      }
+      else
+      {
+        n = q.push(payload) ? 1 : 0;
+      }
+      sent += n;
+      if (!n)
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+  const auto start = std::chrono::steady_clock::now();
+  Element items[kBatch];
+  int received{0};
+  while (received < elements)
+  {
+    int n = batch ? static_cast<int>(q.popN(items, kBatch)) : (q.pop(items[0]) ? 1 : 0);
+    received += n;
+    if (!n)
+    {
+      std::this_thread::yield();
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  producer.join();
+  return received / elapsed.count();
+}
+
+TEST_CASE("madronalib/core/queue/benchmark", "[.][benchmark]")
+{
+  constexpr int kElements{1000000};
+  Queue<int> spsc(1024);
+  std::cout << "Queue, 1 producer: " << queueThroughput(spsc, 1, kElements) << " elements/s\n";
+  for (int producers : {1, 2, 4, 8})
+  {
+    MPMCQueue<int> mpmc(1024);
+    std::cout << "MPMCQueue, " << producers
+              << " producers: " << queueThroughput(mpmc, producers, kElements / producers)
+              << " elements/s\n";
+  }
+
+  const Message message("voice/1/pitch", Value(440.f));
+  std::cout << "Queue<Message>: " << payloadThroughput<Message, false>(message, kElements)
+            << " elements/s, batched: " << payloadThroughput<Message, true>(message, kElements)
+            << " elements/s\n";
+
+  EventsToSignals::Event event;
+  event.type = kNoteOn;
+  event.value1 = 60.f;
+  std::cout << "Queue<Event>: "
+            << payloadThroughput<EventsToSignals::Event, false>(event, kElements)
+            << " elements/s, batched: "
+            << payloadThroughput<EventsToSignals::Event, true>(event, kElements)
+            << " elements/s\n";
+}
+
 }  // namespace queueTest
@@ -0,0 +1,89 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include "MLRtAudioProcessor.h"
+#include "catch.hpp"
+
+using namespace ml;
+
+namespace rtAudioProcessorTest
+{
+// a processor whose output 0 counts frames and output 1 is input 0 plus one.
+class CounterProcessor : public RtAudioProcessor
+{
+ public:
+  CounterProcessor() : RtAudioProcessor(1, 2, 48000) {}
+
+  void processVector(MainInputs inputs, MainOutputs outputs, void*) override
+  {
+    outputs[0] = columnIndex() + DSPVector(_count);
+    outputs[1] = inputs[0] + DSPVector(1.f);
+    _count += kFloatsPerDSPVector;
+    _vectors++;
+  }
+
+  float _count{0.f};
+  size_t _vectors{0};
+};
+}  // namespace rtAudioProcessorTest
+
+using namespace rtAudioProcessorTest;
+
+TEST_CASE("madronalib/core/rtaudio/null_device", "[rtaudio]")
+{
+  constexpr size_t kCallbacks{10};
+  CounterProcessor proc;
+  const size_t frames = proc._processData.bufferFrames;
+
+  // with no null device mode set, nothing runs.
+  REQUIRE(proc.runNullDevice(kCallbacks) == 0);
+  REQUIRE(proc._vectors == 0);
+
+  proc.setNullDeviceMode(RtAudioProcessor::kNullDeviceFlatOut);
+  REQUIRE(proc.runNullDevice(kCallbacks) == kCallbacks);
+  REQUIRE(proc._callbackTimes.getCount() == kCallbacks);
+  REQUIRE(proc._vectors == kCallbacks * frames / kFloatsPerDSPVector);
+
+  // the output buffer holds the last callback's output, one channel after another.
+  std::vector<float> expected(2 * frames, 1.f);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    expected[i] = static_cast<float>((kCallbacks - 1) * frames + i);
+  }
+  REQUIRE(proc._nullDeviceOutput == expected);
+}
+
+TEST_CASE("madronalib/core/rtaudio/histogram", "[rtaudio]")
+{
+  LatencyHistogram h;
+  REQUIRE(h.getCount() == 0);
+  REQUIRE(h.getPercentile(0.5) == 0.);
+
+  // 90 samples of 10us and 10 of 1ms.
+  for (int i = 0; i < 90; ++i)
+  {
+    h.add(10e-6);
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    h.add(1e-3);
+  }
+  REQUIRE(h.getCount() == 100);
+  REQUIRE(h.getMin() == Approx(10e-6));
+  REQUIRE(h.getMax() == Approx(1e-3));
+  REQUIRE(h.getMean() == Approx(0.9 * 10e-6 + 0.1 * 1e-3));
+
+  // percentiles are bin edges, within a quarter octave above the samples.
+  REQUIRE(h.getPercentile(0.5) >= 10e-6);
+  REQUIRE(h.getPercentile(0.5) < 10e-6 * 1.19);
+  REQUIRE(h.getPercentile(0.99) == Approx(1e-3));
+
+  // out of range durations go in the end bins.
+  REQUIRE(LatencyHistogram::getBin(0.) == 0);
+  REQUIRE(LatencyHistogram::getBin(1.) == LatencyHistogram::kBins - 1);
+  h.clear();
+  REQUIRE(h.getCount() == 0);
+}
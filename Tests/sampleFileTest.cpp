@@ -0,0 +1,356 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "catch.hpp"
+#include "madronalib.h"
+#include "mldsp.h"
+
+using namespace ml;
+
+namespace sampleFileTest
+{
+void appendLE(std::vector<uint8_t>& v, uint32_t x, int bytes)
+{
+  for (int i = 0; i < bytes; ++i)
+  {
+    v.push_back((x >> (i * 8)) & 0xFF);
+  }
+}
+
+// write a float32 WAV file with an extra chunk before the data.
+bool writeTestWAV(const char* path, const std::vector<float>& data, size_t channels)
+{
+  std::vector<uint8_t> file;
+  const uint32_t dataBytes = (uint32_t)(data.size() * sizeof(float));
+  file.insert(file.end(), {'R', 'I', 'F', 'F'});
+  appendLE(file, 4 + 24 + 12 + 8 + dataBytes, 4);
+  file.insert(file.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+  appendLE(file, 16, 4);
+  appendLE(file, 3, 2);
+  appendLE(file, (uint32_t)channels, 2);
+  appendLE(file, 48000, 4);
+  appendLE(file, (uint32_t)(48000 * channels * 4), 4);
+  appendLE(file, (uint32_t)(channels * 4), 2);
+  appendLE(file, 32, 2);
+  file.insert(file.end(), {'J', 'U', 'N', 'K'});
+  appendLE(file, 4, 4);
+  appendLE(file, 0, 4);
+  file.insert(file.end(), {'d', 'a', 't', 'a'});
+  appendLE(file, dataBytes, 4);
+  const uint8_t* pData = reinterpret_cast<const uint8_t*>(data.data());
+  file.insert(file.end(), pData, pData + dataBytes);
+
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+  fclose(f);
+  return ok;
+}
+
+TEST_CASE("madronalib/core/sample_file/mapped", "[sample_file]")
+{
+  const char* kWAVPath = "madronalib_test_mapped.wav";
+  const char* kRawPath = "madronalib_test_mapped.raw";
+  constexpr size_t kChannels{2};
+  constexpr size_t kFrames{10000};
+  std::vector<float> data(kFrames * kChannels);
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = (i & 1) ? -(float)(i / 2) : (float)(i / 2);
+  }
+  REQUIRE(writeTestWAV(kWAVPath, data, kChannels));
+  FILE* f = fopen(kRawPath, "wb");
+  REQUIRE(f);
+  fwrite(data.data(), sizeof(float), data.size(), f);
+  fclose(f);
+
+  {
+    MappedSampleFile wav;
+    REQUIRE(wav.openWAV(kWAVPath));
+    const SampleView& v = wav.getView();
+    REQUIRE(v.channels == kChannels);
+    REQUIRE(v.frames == kFrames);
+    REQUIRE(v.sampleRate == 48000);
+    wav.prefetch(5000, 100000);
+    REQUIRE(readLinear(v, 1, 1000, columnIndex()) == DSPVector(-1000.f) - columnIndex());
+
+    // a raw file is not a WAV file.
+    MappedSampleFile notWAV;
+    REQUIRE(!notWAV.openWAV(kRawPath));
+    REQUIRE(!notWAV.openWAV("madronalib_no_such_file.wav"));
+
+    MappedSampleFile raw;
+    REQUIRE(raw.openRaw(kRawPath, kChannels, 44100));
+    REQUIRE(raw.getView().frames == kFrames);
+    REQUIRE(!std::memcmp(raw.getView().data, v.data, kFrames * kChannels * sizeof(float)));
+
+    // mapped files play directly.
+    SamplePlayer<kChannels> player;
+    player.setSample(v);
+    player.setInterpolation(SamplePlayer<kChannels>::kLinear);
+    player.trigger(10.);
+    auto y = player(DSPVector(1.f));
+    REQUIRE(y.constRow(0) == DSPVector(10.f) + columnIndex());
+  }
+
+  // the registry shares one mapping of each file.
+  {
+    SharedResourcePointer<SampleFileRegistry> registry;
+    auto a = registry->openWAV(kWAVPath);
+    auto b = registry->openWAV(kWAVPath);
+    REQUIRE(a);
+    REQUIRE(a == b);
+    REQUIRE(a->getView().frames == kFrames);
+    REQUIRE(!registry->openWAV("madronalib_no_such_file.wav"));
+    REQUIRE(registry->getOpenFiles() == 1);
+
+    // a raw file is shared only among users asking for the same format.
+    auto mono = registry->openRaw(kRawPath, 1, 44100);
+    auto stereo = registry->openRaw(kRawPath, kChannels, 44100);
+    REQUIRE(mono != stereo);
+    REQUIRE(mono->getView().channels == 1);
+    REQUIRE(mono->getView().frames == kFrames * kChannels);
+    REQUIRE(stereo->getView().channels == kChannels);
+    REQUIRE(registry->openRaw(kRawPath, kChannels, 44100) == stereo);
+    REQUIRE(registry->openRaw(kRawPath, kChannels, 48000) != stereo);
+    REQUIRE(registry->getOpenFiles() == 3);
+    mono.reset();
+    stereo.reset();
+
+    a.reset();
+    b.reset();
+    REQUIRE(registry->getOpenFiles() == 0);
+  }
+
+  std::remove(kWAVPath);
+  std::remove(kRawPath);
+}
+
+TEST_CASE("madronalib/core/sample_file/formats", "[sample_file]")
+{
+  // full scale and clipping, with an odd length to cover the scalar tails.
+  std::vector<float> x{0.f, 0.5f, -0.5f, 1.f, -1.f, 2.f, -2.f, 0.25f, -0.125f, 1e-3f, 0.75f};
+  std::vector<float> expected{0.f, 0.5f, -0.5f, 1.f, -1.f, 1.f, -1.f, 0.25f, -0.125f, 1e-3f, 0.75f};
+  const float tolerance[4]{1.f / 32768.f, 1.f / 8388608.f, 1e-7f, 0.f};
+  for (int f = kInt16; f <= kFloat32; ++f)
+  {
+    const SampleFormat format = static_cast<SampleFormat>(f);
+    for (bool bigEndian : {false, true})
+    {
+      std::vector<uint8_t> bytes(x.size() * getBytesPerSample(format));
+      std::vector<float> y(x.size());
+      convertFromFloat(x.data(), bytes.data(), x.size(), format, bigEndian);
+      convertToFloat(bytes.data(), y.data(), x.size(), format, bigEndian);
+      for (size_t i = 0; i < x.size(); ++i)
+      {
+        const float e = (format == kFloat32) ? x[i] : expected[i];
+        REQUIRE(std::fabs(y[i] - e) <= tolerance[f]);
+      }
+    }
+  }
+
+  // byte order
+  const float half{0.5f};
+  uint8_t bytes[4];
+  convertFromFloat(&half, bytes, 1, kInt16, true);
+  REQUIRE((bytes[0] == 0x40 && bytes[1] == 0x00));
+  convertFromFloat(&half, bytes, 1, kInt24, false);
+  REQUIRE((bytes[0] == 0x00 && bytes[1] == 0x00 && bytes[2] == 0x40));
+  convertFromFloat(&half, bytes, 1, kFloat32, true);
+  REQUIRE((bytes[0] == 0x3F && bytes[1] == 0x00));
+}
+
+TEST_CASE("madronalib/core/sample_file/audio_file", "[sample_file]")
+{
+  const char* kPath = "madronalib_test_audio_file";
+  constexpr size_t kChannels{3};
+  constexpr size_t kFrames{100000};
+  Sample src;
+  resize(src, kFrames, kChannels);
+  src.sampleRate = 44100;
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    for (size_t c = 0; c < kChannels; ++c)
+    {
+      src[i * kChannels + c] = std::sin(i * 0.001f * (c + 1)) * 0.9f;
+    }
+  }
+
+  const float tolerance[4]{1.f / 32768.f, 1.f / 8388608.f, 1e-7f, 0.f};
+  for (AudioFileType type : {kWAVFile, kRF64File, kAIFFFile})
+  {
+    for (int f = kInt16; f <= kFloat32; ++f)
+    {
+      const SampleFormat format = static_cast<SampleFormat>(f);
+      REQUIRE(writeAudioFile(kPath, src, type, format));
+
+      Sample dest;
+      REQUIRE(readAudioFile(kPath, dest));
+      REQUIRE(dest.channels == kChannels);
+      REQUIRE(dest.sampleRate == 44100);
+      REQUIRE(getFrames(dest) == kFrames);
+      float maxError{0.f};
+      for (size_t i = 0; i < getSize(src); ++i)
+      {
+        maxError = max(maxError, std::fabs(dest[i] - src[i]));
+      }
+      REQUIRE(maxError <= tolerance[f]);
+
+      AudioFileReader reader;
+      REQUIRE(reader.open(kPath));
+      REQUIRE(reader.getFormat() == format);
+      const bool floatAIFF = (type == kAIFFFile) && (format == kFloat32);
+      REQUIRE(reader.getFileType() == (floatAIFF ? kAIFCFile : type));
+    }
+  }
+
+  // stream in vectors: write planar stereo, then read back mono and stereo.
+  {
+    constexpr size_t kVectors{100};
+    constexpr size_t kTailFrames{10};
+    AudioFileWriter writer;
+    REQUIRE(writer.open(kPath, kWAVFile, kFloat32, 2, 48000));
+    for (size_t v = 0; v < kVectors; ++v)
+    {
+      DSPVector ramp = columnIndex() + DSPVector(v * kFloatsPerDSPVector);
+      DSPVectorArray<2> x = concatRows(ramp, ramp * DSPVector(-1.f));
+      REQUIRE(writer.write(x) == kFloatsPerDSPVector);
+    }
+    REQUIRE(writer.write(DSPVectorArray<2>(), kTailFrames) == kTailFrames);
+    REQUIRE(writer.close());
+
+    AudioFileReader reader;
+    REQUIRE(reader.open(kPath));
+    REQUIRE(reader.getFrames() == kVectors * kFloatsPerDSPVector + kTailFrames);
+    DSPVectorArray<2> y;
+    REQUIRE(reader.read(y) == kFloatsPerDSPVector);
+    REQUIRE(y.constRow(1) == columnIndex() * DSPVector(-1.f));
+
+    REQUIRE(reader.seek(kFloatsPerDSPVector * (kVectors - 1)));
+    DSPVectorArray<1> m;
+    REQUIRE(reader.read(m) == kFloatsPerDSPVector);
+    REQUIRE(m.constRow(0) == columnIndex() + DSPVector((kVectors - 1) * kFloatsPerDSPVector));
+
+    // reading past the end is zero-padded.
+    REQUIRE(reader.read(y) == kTailFrames);
+    REQUIRE(y.constRow(0) == DSPVector(0.f));
+    REQUIRE(reader.read(y) == 0);
+    REQUIRE(!reader.seek(reader.getFrames() + 1));
+
+    // float WAV files written here can be memory-mapped.
+    MappedSampleFile mapped;
+    REQUIRE(mapped.openWAV(kPath));
+    REQUIRE(mapped.getView().frames == reader.getFrames());
+  }
+
+  REQUIRE(!readAudioFile("madronalib_no_such_file.wav", src));
+  std::remove(kPath);
+}
+
+TEST_CASE("madronalib/core/sample_file/streaming", "[sample_file]")
+{
+  const char* kPath = "madronalib_test_streaming.wav";
+  constexpr size_t kFrames{50000};
+  constexpr size_t kHeadFrames{1000};
+  Sample src;
+  resize(src, kFrames, 2);
+  src.sampleRate = 48000;
+  for (size_t i = 0; i < kFrames; ++i)
+  {
+    src[i * 2] = i * 1e-5f;
+    src[i * 2 + 1] = -(i * 1e-5f);
+  }
+  REQUIRE(writeAudioFile(kPath, src, kWAVFile, kFloat32));
+
+  StreamingSample sample;
+  REQUIRE(sample.open(kPath, kHeadFrames));
+  REQUIRE(sample.getFrames() == kFrames);
+  REQUIRE(sample.getHeadFrames() == kHeadFrames);
+
+  // play the voice, checking that every frame played is the next in the file
+  // and calling pre() before each vector.
+  auto play = [&](DiskStreamer& streamer, size_t startFrame, std::function<void()> pre) {
+    size_t expected = startFrame;
+    bool ok{true};
+    while (streamer.isPlaying(0))
+    {
+      pre();
+      const size_t start = streamer.getPosition(0);
+      DSPVectorArray<2> y = streamer.read<2>(0);
+      const size_t end = streamer.getPosition(0);
+      ok &= (start == expected);
+      for (size_t i = 0; i < end - start; ++i)
+      {
+        ok &= (y.constRow(0)[i] == src[(start + i) * 2]);
+        ok &= (y.constRow(1)[i] == src[(start + i) * 2 + 1]);
+      }
+      expected = end;
+    }
+    return ok && (expected == kFrames);
+  };
+
+  // serviced before each vector, no underruns.
+  {
+    DiskStreamer streamer(2, 2, 8192);
+    REQUIRE(streamer.trigger(0, sample, 100));
+    REQUIRE(play(streamer, 100, [&]() { streamer.service(); }));
+    REQUIRE(streamer.getUnderruns() == 0);
+  }
+
+  // serviced rarely: the head plays at once, then the voice waits through
+  // underruns. A retrigger skips what was buffered for the earlier trigger.
+  {
+    DiskStreamer streamer(2, 2, 8192);
+    REQUIRE(streamer.trigger(0, sample, 0));
+    for (int i = 0; i < 40; ++i)
+    {
+      streamer.read<2>(0);
+    }
+    REQUIRE(streamer.getPosition(0) == kHeadFrames);
+    REQUIRE(streamer.getUnderruns(0) > 0);
+    streamer.service();
+    streamer.service();
+    REQUIRE(streamer.trigger(0, sample, 500));
+    int n{0};
+    REQUIRE(play(streamer, 500, [&]() {
+      if (n++ % 100 == 0) streamer.service();
+    }));
+  }
+
+  // with the I/O thread running.
+  {
+    DiskStreamer streamer(2, 2);
+    streamer.start();
+    REQUIRE(streamer.trigger(0, sample));
+    REQUIRE(play(streamer, 0, [&]() { std::this_thread::yield(); }));
+    streamer.stop();
+    REQUIRE(streamer.getDroppedRequests() == 0);
+  }
+
+  // with the I/O run as jobs in a shared ThreadPool.
+  {
+    ThreadPool::Options options;
+    options.threads = 2;
+    ThreadPool pool(options);
+    DiskStreamer streamer(2, 2);
+    streamer.start(pool);
+    REQUIRE(streamer.trigger(0, sample));
+    REQUIRE(play(streamer, 0, [&]() { std::this_thread::yield(); }));
+    streamer.stop();
+    REQUIRE(streamer.getDroppedRequests() == 0);
+    REQUIRE(pool.getRunTime().getCount() > 0);
+  }
+
+  std::remove(kPath);
+}
+
+}  // namespace sampleFileTest
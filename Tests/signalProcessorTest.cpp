@@ -0,0 +1,268 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <array>
+#include <thread>
+
+#include "MLSignalProcessor.h"
+#include "catch.hpp"
+
+using namespace ml;
+
+namespace signalProcessorTest
+{
+using PublishedSignal = SignalProcessor::PublishedSignal;
+
+// a stereo vector where channel 0 counts frames from start and channel 1 is
+// its negative.
+DSPVectorArray<2> countingVector(float start)
+{
+  DSPVector count = columnIndex() + DSPVector(start);
+  return concatRows(count, DSPVector(0.f) - count);
+}
+
+TEST_CASE("madronalib/core/published_signal", "[published_signal]")
+{
+  // readers with their own cursors each get every frame.
+  PublishedSignal sig(256, 1, 2, 0);
+  REQUIRE(sig.getCapacity() == 256);
+  PublishedSignal::ReadCursor a = sig.getReadCursor();
+  PublishedSignal::ReadCursor b = sig.getReadCursor();
+  sig.writeQuick(countingVector(0.f), kFloatsPerDSPVector, 0);
+  sig.writeQuick(countingVector(64.f), kFloatsPerDSPVector, 0);
+  REQUIRE(sig.getAvailableFrames(a) == 128);
+
+  std::vector<float> frames(256 * 2);
+  REQUIRE(sig.read(a, frames.data(), 100) == 100);
+  REQUIRE(frames[99 * 2] == 99.f);
+  REQUIRE(frames[99 * 2 + 1] == -99.f);
+  REQUIRE(sig.read(a, frames.data(), 100) == 28);
+  REQUIRE(frames[0] == 100.f);
+  REQUIRE(sig.read(b, frames.data(), 1) == 1);
+  REQUIRE(frames[0] == 0.f);
+  REQUIRE(sig.readLatest(b, frames.data(), 10) == 10);
+  REQUIRE(frames[0] == 118.f);
+  REQUIRE(sig.getAvailableFrames(b) == 0);
+
+  // a reader that falls behind skips to the oldest stored frames.
+  for (int i = 2; i < 8; ++i)
+  {
+    sig.writeQuick(countingVector(i * 64.f), kFloatsPerDSPVector, 0);
+  }
+  REQUIRE(sig.read(a, frames.data(), 256) == 256);
+  REQUIRE(frames[0] == 256.f);
+  REQUIRE(a.droppedFrames == 128);
+
+  // peeking moves no cursor.
+  REQUIRE(sig.peekLatest(frames.data(), 4));
+  REQUIRE(frames[6] == 511.f);
+  REQUIRE(!sig.peekLatest(frames.data(), 1000));
+
+  // single frames from contiguous channels.
+  float frame[2]{3.f, 4.f};
+  sig.writeQuickVert(frame, 2, 0);
+  REQUIRE(sig.read(a, frames.data(), 10) == 1);
+  REQUIRE(frames[1] == 4.f);
+
+  // reads with the default cursor count floats.
+  PublishedSignal single(256, 1, 2, 0);
+  single.writeQuick(countingVector(0.f), kFloatsPerDSPVector, 0);
+  REQUIRE(single.getReadAvailable() == 128);
+  REQUIRE(single.read(frames.data(), 10) == 20);
+  REQUIRE(single.readLatest(frames.data(), 4) == 8);
+  REQUIRE(frames[6] == 63.f);
+}
+
+TEST_CASE("madronalib/core/published_signal/channels", "[published_signal]")
+{
+  // writes of more than a vector keep their frame and channel order across
+  // the ring wrap, for the stereo and four channel interleave and the
+  // generic one.
+  constexpr size_t kFrames{100};
+  for (size_t channels : {2, 3, 4})
+  {
+    PublishedSignal sig(128, 1, static_cast<int>(channels), 0);
+    PublishedSignal::ReadCursor cursor = sig.getReadCursor();
+    std::vector<std::vector<float> > rows(channels, std::vector<float>(kFrames));
+    std::vector<const float*> pRows(channels);
+    std::vector<float> frames(kFrames * channels);
+    for (size_t block = 0; block < 2; ++block)
+    {
+      for (size_t c = 0; c < channels; ++c)
+      {
+        for (size_t i = 0; i < kFrames; ++i)
+        {
+          rows[c][i] = (block * kFrames + i) * 8.f + c;
+        }
+        pRows[c] = rows[c].data();
+      }
+      sig.write(pRows.data(), kFrames, 0);
+      REQUIRE(sig.read(cursor, frames.data(), kFrames) == kFrames);
+      bool ok{true};
+      for (size_t i = 0; i < kFrames; ++i)
+      {
+        for (size_t c = 0; c < channels; ++c)
+        {
+          ok = ok && (frames[i * channels + c] == (block * kFrames + i) * 8.f + c);
+        }
+      }
+      REQUIRE(ok);
+    }
+  }
+}
+
+TEST_CASE("madronalib/core/published_signal/decimate", "[published_signal]")
+{
+  // a tone near the input Nyquist frequency is filtered out instead of
+  // aliasing, and a low tone passes.
+  constexpr int kOctaves{2};
+  constexpr size_t kVectors{64};
+  PublishedSignal sig(4096, 1, 2, kOctaves);
+  PublishedSignal::ReadCursor cursor = sig.getReadCursor();
+  SineGen lowSine, highSine;
+  for (size_t v = 0; v < kVectors; ++v)
+  {
+    DSPVectorArray<2> x = concatRows(lowSine(DSPVector(0.01f)), highSine(DSPVector(0.45f)));
+    sig.writeQuick(x, kFloatsPerDSPVector, 0);
+  }
+  const size_t expected = kVectors * kFloatsPerDSPVector >> kOctaves;
+  REQUIRE(sig.getAvailableFrames(cursor) == expected);
+
+  std::vector<float> frames(expected * 2);
+  REQUIRE(sig.read(cursor, frames.data(), expected) == expected);
+  float lowPeak{0.f}, highPeak{0.f};
+  for (size_t i = expected / 2; i < expected; ++i)
+  {
+    lowPeak = std::max(lowPeak, fabsf(frames[i * 2]));
+    highPeak = std::max(highPeak, fabsf(frames[i * 2 + 1]));
+  }
+  REQUIRE(lowPeak > 0.9f);
+  REQUIRE(highPeak < 0.05f);
+
+  // partial vectors are gathered until there is a whole one.
+  PublishedSignal partial(1024, 1, 1, 1);
+  cursor = partial.getReadCursor();
+  float x{0.f};
+  for (int i = 0; i < 2 * kFloatsPerDSPVector; ++i)
+  {
+    partial.writeQuickVert(&x, 1, 0);
+  }
+  REQUIRE(partial.getAvailableFrames(cursor) == kFloatsPerDSPVector);
+}
+
+TEST_CASE("madronalib/core/published_signal/threads", "[published_signal]")
+{
+  // readers on other threads see each frame in order, or count it as dropped.
+  constexpr size_t kVectors{20000};
+  PublishedSignal sig(128, 1, 2, 0);
+  std::atomic<bool> done{false};
+  constexpr int kReaders{3};
+  std::vector<bool> ok(kReaders, true);
+  std::vector<size_t> received(kReaders, 0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaders; ++r)
+  {
+    readers.emplace_back([&, r]() {
+      PublishedSignal::ReadCursor cursor;
+      std::vector<float> frames(64 * 2);
+      while (!done || sig.getAvailableFrames(cursor))
+      {
+        const uint64_t first = cursor.frame;
+        const size_t n = sig.read(cursor, frames.data(), 64);
+        for (size_t i = 0; i < n; ++i)
+        {
+          // frame numbers here are small enough to be exact as floats.
+          const float expected = static_cast<float>(cursor.frame - n + i);
+          ok[r] = ok[r] && (frames[i * 2] == expected) && (frames[i * 2 + 1] == -expected);
+        }
+        ok[r] = ok[r] && (cursor.frame >= first + n);
+        received[r] += n;
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (size_t v = 0; v < kVectors; ++v)
+  {
+    sig.writeQuick(countingVector(v * 64.f), kFloatsPerDSPVector, 0);
+  }
+  done = true;
+  for (auto& t : readers)
+  {
+    t.join();
+  }
+  for (int r = 0; r < kReaders; ++r)
+  {
+    REQUIRE(ok[r]);
+    REQUIRE(received[r] > 0);
+  }
+}
+
+// a synth whose voices each make a sine at a different frequency.
+class VoicesProcessor : public SignalProcessor
+{
+ public:
+  VoicesProcessor() : SignalProcessor(0, 1), _events(48000)
+  {
+    _events.setPolyphony(EventsToSignals::kMaxVoices);
+  }
+
+  void processVector(MainInputs, MainOutputs outputs, void*) override
+  {
+    renderVoices(_events, [&](size_t v, EventsToSignals::Voice&) {
+      _voiceOutputs[v] = _sines[v](DSPVector(0.001f * (v + 1)));
+    });
+
+    // mix after all voices are done.
+    DSPVector mix;
+    for (size_t v = 0; v < EventsToSignals::kMaxVoices; ++v)
+    {
+      mix += _voiceOutputs[v];
+    }
+    outputs[0] = mix;
+  }
+
+ private:
+  EventsToSignals _events;
+  std::array<SineGen, EventsToSignals::kMaxVoices> _sines;
+  std::array<DSPVector, EventsToSignals::kMaxVoices> _voiceOutputs;
+};
+
+TEST_CASE("madronalib/core/parallel_voices", "[parallel_voices]")
+{
+  // every voice is rendered once per call, in any grouping.
+  for (size_t voicesPerGroup : {1, 3})
+  {
+    ParallelVoiceRenderer renderer(3, 64, voicesPerGroup);
+    REQUIRE(renderer.getWorkers() == 3);
+    std::array<std::atomic<int>, 64> counts{};
+    bool ok{true};
+    for (int i = 0; i < 1000; ++i)
+    {
+      renderer.render(50, [&](size_t v) { counts[v]++; });
+      for (size_t v = 0; v < 64; ++v)
+      {
+        ok &= (counts[v] == ((v < 50) ? i + 1 : 0));
+      }
+    }
+    REQUIRE(ok);
+  }
+
+  // a processor gets the same output with and without worker threads.
+  VoicesProcessor serial, parallel;
+  parallel.setVoiceThreads(3);
+  REQUIRE(parallel.getVoiceThreads() == 3);
+  DSPVectorDynamic noInputs(0), serialOut(1), parallelOut(1);
+  bool same{true};
+  for (int i = 0; i < 100; ++i)
+  {
+    serial.processVector(noInputs, serialOut, nullptr);
+    parallel.processVector(noInputs, parallelOut, nullptr);
+    same &= (serialOut[0] == parallelOut[0]);
+  }
+  REQUIRE(same);
+}
+
+}  // namespace signalProcessorTest
@@ -73,6 +73,146 @@ TEST_CASE("madronalib/core/symbol/threads", "[symbol][threads]")
   REQUIRE(theSymbolTable().getSize() == kThreadTestSize + 1);
 }
 
+TEST_CASE("madronalib/core/symbol/readers", "[symbol][threads]")
+{
+  // threads reading existing symbols while another adds new ones.
+  theSymbolTable().clear();
+  std::vector<std::string> names;
+  textUtils::NameMaker namer;
+  for (int i = 0; i < kThreadTestSize; ++i)
+  {
+    names.push_back(namer.nextName().getText());
+  }
+  std::vector<SymbolID> ids;
+  for (int i = 0; i < kThreadTestSize / 2; ++i)
+  {
+    ids.push_back(Symbol(names[i].c_str()).getID());
+  }
+
+  std::atomic<int> errors{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t)
+  {
+    readers.emplace_back([&]() {
+      for (int i = 0; i < kThreadTestSize / 2; ++i)
+      {
+        Symbol sym(names[i].c_str());
+        if ((sym.getID() != ids[i]) || (names[i] != sym.getUTF8Ptr()))
+        {
+          errors++;
+        }
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (int i = kThreadTestSize / 2; i < kThreadTestSize; ++i)
+  {
+    Symbol sym(names[i].c_str());
+    std::this_thread::yield();
+  }
+  for (auto& t : readers)
+  {
+    t.join();
+  }
+  REQUIRE(errors == 0);
+  REQUIRE(theSymbolTable().getSize() == kThreadTestSize + 1);
+  REQUIRE(theSymbolTable().audit());
+}
+
+// lookups of existing symbols per second from 1 to 8 threads. Run with the
+// [benchmark] tag.
+TEST_CASE("madronalib/core/symbol/benchmark", "[.][benchmark]")
+{
+  constexpr int kSymbols{1000};
+  constexpr int kLookups{1000000};
+  std::vector<std::string> names;
+  textUtils::NameMaker namer;
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    names.push_back(namer.nextName().getText());
+    Symbol sym(names.back().c_str());
+  }
+
+  for (int nThreads : {1, 2, 4, 8})
+  {
+    std::atomic<size_t> idSum{0};
+    std::vector<std::thread> threads;
+    const auto start = now();
+    for (int t = 0; t < nThreads; ++t)
+    {
+      threads.emplace_back([&]() {
+        size_t sum{0};
+        for (int i = 0; i < kLookups / nThreads; ++i)
+        {
+          sum += Symbol(names[i % kSymbols].c_str()).getID();
+        }
+        idSum += sum;
+      });
+    }
+    for (auto& t : threads)
+    {
+      t.join();
+    }
+    const std::chrono::duration<double> elapsed = now() - start;
+    std::cout << nThreads << " threads: " << kLookups / elapsed.count() << " lookups/s\n";
+  }
+
+  // comparing to literal Symbols looked up each time, and once.
+  const Symbol target("cutoff");
+  int matches{0};
+  auto start = now();
+  for (int i = 0; i < kLookups; ++i)
+  {
+    matches += (Symbol("cutoff") == target);
+  }
+  const std::chrono::duration<double> lookupTime = now() - start;
+  start = now();
+  for (int i = 0; i < kLookups; ++i)
+  {
+    matches += (ML_SYMBOL("cutoff") == target);
+  }
+  const std::chrono::duration<double> literalTime = now() - start;
+  std::cout << "Symbol(\"cutoff\"): " << kLookups / lookupTime.count()
+            << " compares/s, ML_SYMBOL(\"cutoff\"): " << kLookups / literalTime.count()
+            << " compares/s\n";
+  REQUIRE(matches == 2 * kLookups);
+}
+
+// adding and then looking up 10k, 100k and 1M symbols. Run with the
+// [benchmark] tag.
+TEST_CASE("madronalib/core/symbol/stress", "[.][benchmark]")
+{
+  for (int nSymbols : {10000, 100000, 1000000})
+  {
+    theSymbolTable().clear();
+    std::vector<std::string> names;
+    for (int i = 0; i < nSymbols; ++i)
+    {
+      names.push_back("stress/" + std::to_string(i * 7919));
+    }
+
+    auto start = now();
+    for (auto& name : names)
+    {
+      Symbol sym(name.c_str());
+    }
+    const std::chrono::duration<double> addTime = now() - start;
+
+    start = now();
+    size_t idSum{0};
+    for (auto& name : names)
+    {
+      idSum += Symbol(name.c_str()).getID();
+    }
+    const std::chrono::duration<double> lookupTime = now() - start;
+
+    std::cout << nSymbols << " symbols: " << nSymbols / addTime.count() << " adds/s, "
+              << nSymbols / lookupTime.count() << " lookups/s\n";
+    REQUIRE(idSum == size_t(nSymbols) * (nSymbols + 1) / 2);
+  }
+  theSymbolTable().clear();
+}
+
 TEST_CASE("madronalib/core/collision", "[collision]")
 {
   // nothing is checked here - these are two pairs of colliding symbols for
@@ -110,6 +250,57 @@ TEST_CASE("madronalib/core/hashes", "[hashes]")
   
   auto h = hash(Symbol());
   //std::cout << "hash of null symbol: " << h << "\n";
+
+  // the 64-bit symbol hash is the same at compile time and runtime, and a
+  // Symbol remembers the hash of its text.
+  constexpr uint64_t c1 = hash("hello");
+  static_assert(c1 == symbolHash("hello", 5), "compile time hash");
+  REQUIRE(c1 == symbolHash(str1, strlen(str1)));
+  REQUIRE(hash(Symbol(str1)) == c1);
+  REQUIRE(hash(Symbol()) == hash(""));
+
+  // a literal HashedCharArray makes the same Symbol as a runtime string.
+  constexpr HashedCharArray literal("hello");
+  REQUIRE(literal.len == 5);
+  REQUIRE(Symbol(literal) == Symbol(str1));
+}
+
+TEST_CASE("madronalib/core/symbol/literal", "[symbol][literal]")
+{
+  // ML_SYMBOL makes the same Symbol as the text, and looks it up only once.
+  auto cutoff = []() { return ML_SYMBOL("cutoff"); };
+  REQUIRE(cutoff() == Symbol("cutoff"));
+  REQUIRE(cutoff().getUTF8Ptr() == std::string("cutoff"));
+  const size_t size = theSymbolTable().getSize();
+  for (int i = 0; i < 10; ++i)
+  {
+    REQUIRE(cutoff() == Symbol("cutoff"));
+  }
+  REQUIRE(ML_SYMBOL("resonance") != cutoff());
+  REQUIRE(theSymbolTable().getSize() == size + 1);
+}
+
+TEST_CASE("madronalib/core/symbol/growth", "[symbol][growth]")
+{
+  // the table grows past its initial size without changing any IDs.
+  theSymbolTable().clear();
+  const int kSymbols = kDefaultSymbolTableSize * 5;
+  std::vector<std::string> names;
+  std::vector<SymbolID> ids;
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    names.push_back("growth" + std::to_string(i));
+    ids.push_back(Symbol(names.back().c_str()).getID());
+  }
+  bool sameIDs{true};
+  for (int i = 0; i < kSymbols; ++i)
+  {
+    Symbol sym(names[i].c_str());
+    sameIDs &= (sym.getID() == ids[i]) && (names[i] == sym.getUTF8Ptr());
+  }
+  REQUIRE(sameIDs);
+  REQUIRE(theSymbolTable().getSize() == kSymbols + 1);
+  REQUIRE(theSymbolTable().audit());
 }
 
 const char letters[24] = "abcdefghjklmnopqrstuvw";
@@ -0,0 +1,116 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// a unit test made using the Catch framework in catch.hpp / tests.cpp.
+
+#include <atomic>
+
+#include "MLThreadPool.h"
+#include "MLWorkerParking.h"
+#include "catch.hpp"
+
+using namespace ml;
+
+namespace threadPoolTest
+{
+void increment(void* pContext) { static_cast<std::atomic<int>*>(pContext)->fetch_add(1); }
+
+TEST_CASE("madronalib/core/thread_pool", "[thread_pool]")
+{
+  ThreadPool::Options options;
+  options.threads = 3;
+  ThreadPool pool(options);
+  REQUIRE(pool.getThreads() == 3);
+  REQUIRE(pool.getSchedulingSet());
+
+  // jobs from function pointers and std::functions, submitted from several
+  // threads at once.
+  constexpr int kJobsPerThread{1000};
+  std::atomic<int> count{0};
+  std::atomic<int> failed{0};
+  auto submitJobs = [&]() {
+    for (int i = 0; i < kJobsPerThread; ++i)
+    {
+      bool ok = (i & 1) ? pool.submit(increment, &count) : pool.submit([&]() { count++; });
+      if (!ok)
+      {
+        failed++;
+        pool.runPendingJob();
+      }
+    }
+  };
+  std::thread t1(submitJobs), t2(submitJobs);
+  t1.join();
+  t2.join();
+  pool.wait();
+  REQUIRE(count + failed == 2 * kJobsPerThread);
+  REQUIRE(pool.getPendingJobs() == 0);
+  REQUIRE(pool.getRunTime().getCount() == static_cast<size_t>(count));
+  REQUIRE(pool.getQueueLatency().getCount() == static_cast<size_t>(count));
+
+  // with no workers, jobs wait for the caller, and a full queue refuses them.
+  options.threads = 0;
+  options.maxJobs = 4;
+  ThreadPool callerOnly(options);
+  count = 0;
+  int accepted{0};
+  for (int i = 0; i < 10; ++i)
+  {
+    accepted += callerOnly.submit(increment, &count);
+  }
+  REQUIRE(accepted == 4);
+  REQUIRE(count == 0);
+  REQUIRE(callerOnly.runPendingJob());
+  REQUIRE(count == 1);
+  callerOnly.wait();
+  REQUIRE(count == 4);
+  REQUIRE(!callerOnly.runPendingJob());
+
+  // realtime scheduling may not be allowed here, but the workers run anyway.
+  options.threads = 2;
+  options.policy = ThreadPool::kFIFOPolicy;
+  options.priority = 80;
+  ThreadPool realtime(options);
+  count = 0;
+  realtime.submit(increment, &count);
+  realtime.wait();
+  REQUIRE(count == 1);
+}
+
+TEST_CASE("madronalib/core/worker_parking", "[thread_pool]")
+{
+  // with no spin and no recheck, a worker sleeps until work is made and it
+  // is woken, or until the parking is stopped.
+  WorkerParking parking(0, 0);
+  std::atomic<int> work{0};
+  std::atomic<int> done{0};
+  std::thread worker([&]() {
+    auto lastWorkTime = WorkerParking::Clock::now();
+    while (parking.running())
+    {
+      if (work.load())
+      {
+        work--;
+        done++;
+        lastWorkTime = WorkerParking::Clock::now();
+        continue;
+      }
+      parking.park(lastWorkTime, [&]() { return work.load(std::memory_order_seq_cst) != 0; });
+    }
+  });
+  for (int i = 0; i < 100; ++i)
+  {
+    work.fetch_add(1, std::memory_order_seq_cst);
+    parking.wakeOne();
+    while (done.load() <= i)
+    {
+      std::this_thread::yield();
+    }
+  }
+  parking.stop();
+  worker.join();
+  REQUIRE(done == 100);
+}
+
+}  // namespace threadPoolTest
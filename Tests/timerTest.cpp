@@ -109,3 +109,63 @@ TEST_CASE("madronalib/core/timer/basic", "[timer][basic]")
   system("pause");
 #endif
 }
+
+TEST_CASE("madronalib/core/timer/deadlines", "[timer][deadlines]")
+{
+  SharedResourcePointer<ml::Timers> t;
+  t->start(false);
+
+  // many idle timers don't slow down the others.
+  std::vector<std::unique_ptr<Timer> > idle;
+  for (int i = 0; i < 2000; ++i)
+  {
+    idle.emplace_back(std::make_unique<Timer>());
+    idle.back()->start([]() {}, std::chrono::hours(1));
+  }
+  REQUIRE(t->getSize() >= 2000);
+
+  // periods shorter than a millisecond.
+  std::atomic<int> fastCount{0};
+  Timer fast;
+  fast.start([&]() { fastCount++; }, microseconds(250));
+  std::this_thread::sleep_for(milliseconds(longSleepMs));
+  fast.stop();
+  REQUIRE(!fast.isActive());
+  const int countAtStop = fastCount;
+  REQUIRE(countAtStop > 20);
+
+  // no calls after stop() returns.
+  std::this_thread::sleep_for(milliseconds(5));
+  REQUIRE(fastCount == countAtStop);
+
+  // a timer due before all the others is called on time.
+  std::atomic<int> onceCount{0};
+  Timer once;
+  once.callOnce([&]() { onceCount++; }, milliseconds(1));
+  std::this_thread::sleep_for(milliseconds(longSleepMs / 2));
+  REQUIRE(onceCount == 1);
+  REQUIRE(!once.isActive());
+
+  // a callback can stop its own timer.
+  std::atomic<int> selfStopCount{0};
+  Timer selfStop;
+  selfStop.start(
+      [&]() {
+        if (++selfStopCount == 3)
+        {
+          selfStop.stop();
+        }
+      },
+      microseconds(500));
+  std::this_thread::sleep_for(milliseconds(longSleepMs / 2));
+  REQUIRE(selfStopCount == 3);
+
+  // postponing moves the deadline.
+  std::atomic<int> postponedCount{0};
+  Timer postponed;
+  postponed.callOnce([&]() { postponedCount++; }, milliseconds(5));
+  postponed.postpone(milliseconds(longSleepMs * 2));
+  std::this_thread::sleep_for(milliseconds(longSleepMs / 2));
+  REQUIRE(postponedCount == 0);
+  REQUIRE(postponed.isActive());
+}
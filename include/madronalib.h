@@ -5,9 +5,15 @@
 #pragma once
 
 #include "MLActor.h"
+#include "MLActorRuntime.h"
+#include "MLAudioFile.h"
 #include "MLClock.h"
+#include "MLDiskStreamer.h"
 #include "MLEventsToSignals.h"
+#include "MLLatencyHistogram.h"
+#include "MLMappedSample.h"
 #include "MLMemoryUtils.h"
+#include "MLParallelVoiceRenderer.h"
 #include "MLParameters.h"
 #include "MLPath.h"
 #include "MLPlatform.h"
@@ -17,8 +23,10 @@
 #include "MLSymbol.h"
 #include "MLText.h"
 #include "MLTextUtils.h"
+#include "MLThreadPool.h"
 #include "MLTimer.h"
 #include "MLTree.h"
 #include "MLValue.h"
 #include "MLValueChange.h"
+#include "MLWorkerParking.h"
 
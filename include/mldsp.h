@@ -7,6 +7,7 @@
 #include "MLDSPOps.h"
 #include "MLDSPFilters.h"
 #include "MLDSPGens.h"
+#include "MLDSPGranulator.h"
 #include "MLDSPBuffer.h"
 #include "MLDSPFunctional.h"
 #include "MLDSPUtils.h"
@@ -14,5 +15,7 @@
 #include "MLDSPRatio.h"
 #include "MLDSPRouting.h"
 #include "MLDSPSample.h"
+#include "MLDSPSampleFormat.h"
+#include "MLDSPSamplePlayer.h"
 #include "MLDSPScale.h"
 
@@ -28,6 +28,10 @@ class DSPBuffer
 
   std::atomic<size_t> mWriteIndex{0};
   std::atomic<size_t> mReadIndex{0};
+
+ public:
+  // one or two regions of the buffer in ring order. p2 is null if the data
+  // does not wrap around the end of the buffer.
   struct DataRegions
   {
     float *p1;
@@ -36,6 +40,8 @@ class DSPBuffer
     size_t size2;
   };
 
+ private:
+
   inline void addSamples(const float *pSrcStart, const float *pSrcEnd, float *pDest)
   {
     for (const float *p = pSrcStart; p < pSrcEnd; ++p)
@@ -143,6 +149,38 @@ class DSPBuffer
   // return the samples of free space available for writing.
   size_t getWriteAvailable() const { return mSize - getReadAvailable(); }
 
+  // Zero-copy access. beginWrite() returns the free space for up to n samples,
+  // which the producer can fill in place before commitWrite() makes it
+  // readable. Unlike write(), this never clobbers unread data: the regions
+  // are limited to the space available. Likewise, beginRead() returns up to n
+  // readable samples in place, and commitRead() frees them.
+  DataRegions beginWrite(size_t samples) const
+  {
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_acquire);
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    size_t available = mSize - ((currentWriteIndex - currentReadIndex) & mDistanceMask);
+    return getDataRegions(currentWriteIndex, std::min(samples, available));
+  }
+
+  // make n samples written to the regions from beginWrite() readable.
+  void commitWrite(size_t samples)
+  {
+    samples = std::min(samples, getWriteAvailable());
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    mWriteIndex.store(advanceDistanceIndex(currentWriteIndex, samples), std::memory_order_release);
+  }
+
+  DataRegions beginRead(size_t samples) const
+  {
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    size_t available = (currentWriteIndex - currentReadIndex) & mDistanceMask;
+    return getDataRegions(currentReadIndex, std::min(samples, available));
+  }
+
+  // free n samples read from the regions from beginRead().
+  void commitRead(size_t samples) { discard(samples); }
+
   // write n samples to the buffer, advancing the write index.
   void write(const float *pSrc, size_t samples)
   {
@@ -382,4 +420,489 @@ class DSPBuffer
     }
   }
 };
+
+// DSPVectorBuffer is a single producer, single consumer, lock-free ring buffer
+// of whole DSPVectors. Every vector is aligned and contiguous, so producers and
+// consumers can work on the DSPVectors in the buffer directly.
+class DSPVectorBuffer
+{
+ public:
+  struct VectorRegions
+  {
+    DSPVector *p1;
+    size_t size1;
+    DSPVector *p2;
+    size_t size2;
+  };
+
+ private:
+  std::vector<DSPVector> mData;
+  size_t mSize{0};
+  size_t mDataMask{0};
+  size_t mDistanceMask{0};
+
+  std::atomic<size_t> mWriteIndex{0};
+  std::atomic<size_t> mReadIndex{0};
+
+  inline VectorRegions getVectorRegions(size_t currentIdx, size_t vectors)
+  {
+    size_t startIdx = currentIdx & mDataMask;
+    DSPVector *pData = mData.data();
+    if (startIdx + vectors > mSize)
+    {
+      size_t firstHalf = mSize - startIdx;
+      return VectorRegions{pData + startIdx, firstHalf, pData, vectors - firstHalf};
+    }
+    else
+    {
+      return VectorRegions{pData + startIdx, vectors, nullptr, 0};
+    }
+  }
+
+ public:
+  DSPVectorBuffer() {}
+  ~DSPVectorBuffer() {}
+
+  // resize the buffer to the next power of two that holds the requested
+  // number of DSPVectors. Returns the new size, or 0 if allocation failed.
+  size_t resize(size_t sizeInVectors)
+  {
+    mReadIndex = mWriteIndex = 0;
+    mSize = size_t(1) << ml::bitsToContain(static_cast<int>(std::max(sizeInVectors, size_t(1))));
+
+    try
+    {
+      mData.resize(mSize);
+    }
+    catch (const std::bad_alloc &)
+    {
+      mSize = mDataMask = mDistanceMask = 0;
+      return 0;
+    }
+
+    // as in DSPBuffer, the indices run over twice the size so that full and
+    // empty can be distinguished.
+    mDataMask = mSize - 1;
+    mDistanceMask = mSize * 2 - 1;
+    return mSize;
+  }
+
+  void clear()
+  {
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+    mReadIndex.store(currentWriteIndex, std::memory_order_release);
+  }
+
+  // return the number of DSPVectors available for reading.
+  size_t getReadAvailable() const
+  {
+    size_t a = mReadIndex.load(std::memory_order_acquire);
+    size_t b = mWriteIndex.load(std::memory_order_acquire);
+    return (b - a) & mDistanceMask;
+  }
+
+  // return the number of DSPVectors of free space available for writing.
+  size_t getWriteAvailable() const { return mSize - getReadAvailable(); }
+
+  // return the free space for up to n DSPVectors, to be filled in place and
+  // then committed with commitWrite().
+  VectorRegions beginWrite(size_t vectors)
+  {
+    return getVectorRegions(mWriteIndex.load(std::memory_order_relaxed),
+                            std::min(vectors, getWriteAvailable()));
+  }
+
+  void commitWrite(size_t vectors)
+  {
+    vectors = std::min(vectors, getWriteAvailable());
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    mWriteIndex.store((currentWriteIndex + vectors) & mDistanceMask, std::memory_order_release);
+  }
+
+  // return up to n readable DSPVectors in place, to be freed with
+  // commitRead() when done.
+  VectorRegions beginRead(size_t vectors)
+  {
+    return getVectorRegions(mReadIndex.load(std::memory_order_relaxed),
+                            std::min(vectors, getReadAvailable()));
+  }
+
+  void commitRead(size_t vectors)
+  {
+    vectors = std::min(vectors, getReadAvailable());
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    mReadIndex.store((currentReadIndex + vectors) & mDistanceMask, std::memory_order_release);
+  }
+
+  // return the next DSPVector to write, or nullptr if the buffer is full.
+  DSPVector *beginWriteVector()
+  {
+    VectorRegions r = beginWrite(1);
+    return r.size1 ? r.p1 : nullptr;
+  }
+
+  // return the next DSPVector to read, or nullptr if the buffer is empty.
+  const DSPVector *beginReadVector()
+  {
+    VectorRegions r = beginRead(1);
+    return r.size1 ? r.p1 : nullptr;
+  }
+
+  // copy a DSPVector into the buffer. Returns false if the buffer was full.
+  bool write(const DSPVector &v)
+  {
+    DSPVector *p = beginWriteVector();
+    if (!p) return false;
+    *p = v;
+    commitWrite(1);
+    return true;
+  }
+
+  // copy a DSPVector out of the buffer. Returns false if the buffer was
+  // empty, leaving v unchanged.
+  bool read(DSPVector &v)
+  {
+    const DSPVector *p = beginReadVector();
+    if (!p) return false;
+    v = *p;
+    commitRead(1);
+    return true;
+  }
+};
+
+// MultiChannelDSPBuffer is a single producer, single consumer, lock-free ring
+// buffer for a number of channels that share one pair of read and write
+// indices, so all the channels are written and read together with a single
+// acquire and release. The data can be stored planar, with each channel
+// contiguous, or interleaved, with each frame contiguous. Either way it can be
+// written and read as planar channels, interleaved frames or DSPVectors,
+// converting with SIMD interleave / deinterleave as needed. All sizes and
+// counts are in frames.
+class MultiChannelDSPBuffer
+{
+ public:
+  enum Layout
+  {
+    kPlanar = 0,
+    kInterleaved
+  };
+
+ private:
+  std::vector<float> mData;
+  Layout mLayout{kPlanar};
+  size_t mChannels{0};
+  size_t mSize{0};
+  size_t mDataMask{0};
+  size_t mDistanceMask{0};
+
+  // per-channel pointers for the producer and the consumer, set on each call
+  // so that nothing is allocated while running.
+  std::vector<const float *> mWriteSrcPtrs;
+  std::vector<float *> mWriteRingPtrs;
+  std::vector<float *> mReadDestPtrs;
+  std::vector<const float *> mReadRingPtrs;
+
+  // source for silent channels and destination for skipped ones
+  std::vector<float> mZeros;
+  std::vector<float> mDiscard;
+
+  std::atomic<size_t> mWriteIndex{0};
+  std::atomic<size_t> mReadIndex{0};
+
+  inline float *getChannelPtr(size_t channel, size_t frame)
+  {
+    return mData.data() + ((mLayout == kInterleaved) ? frame * mChannels + channel
+                                                     : channel * mSize + frame);
+  }
+
+  // call copyFn(ringFrame, frames) for the one or two regions of the ring to
+  // write, then advance the write index.
+  template <typename CopyFn>
+  void writeFrames(size_t frames, CopyFn copyFn)
+  {
+    frames = std::min(frames, mSize);
+    bool full = (getWriteAvailable() < frames);
+
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const size_t start = currentWriteIndex & mDataMask;
+    const size_t frames1 = std::min(frames, mSize - start);
+    copyFn(start, frames1);
+    if (frames > frames1)
+    {
+      copyFn(size_t(0), frames - frames1);
+    }
+
+    const auto newWriteIndex = (currentWriteIndex + frames) & mDistanceMask;
+    mWriteIndex.store(newWriteIndex, std::memory_order_release);
+
+    if (full)
+    {
+      // oldest data was clobbered by write. set read index to indicate we
+      // are full
+      mReadIndex.store((newWriteIndex - mSize) & mDistanceMask, std::memory_order_release);
+    }
+  }
+
+  // call copyFn(ringFrame, frames) for the one or two regions of the ring to
+  // read, then advance the read index.
+  template <typename CopyFn>
+  void readFrames(size_t frames, CopyFn copyFn)
+  {
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    const size_t start = currentReadIndex & mDataMask;
+    const size_t frames1 = std::min(frames, mSize - start);
+    copyFn(start, frames1);
+    if (frames > frames1)
+    {
+      copyFn(size_t(0), frames - frames1);
+    }
+    mReadIndex.store((currentReadIndex + frames) & mDistanceMask, std::memory_order_release);
+  }
+
+  // write frames from the planar sources in mWriteSrcPtrs.
+  void writePlanar(size_t frames)
+  {
+    writeFrames(frames,
+                [&](size_t ringFrame, size_t n)
+                {
+                  if (mLayout == kInterleaved)
+                  {
+                    interleave(mWriteSrcPtrs.data(), mChannels, getChannelPtr(0, ringFrame), n);
+                  }
+                  else
+                  {
+                    for (size_t c = 0; c < mChannels; ++c)
+                    {
+                      std::copy(mWriteSrcPtrs[c], mWriteSrcPtrs[c] + n, getChannelPtr(c, ringFrame));
+                    }
+                  }
+                  for (auto &p : mWriteSrcPtrs)
+                  {
+                    p += n;
+                  }
+                });
+  }
+
+  // read frames to the planar destinations in mReadDestPtrs.
+  void readPlanar(size_t frames)
+  {
+    readFrames(frames,
+               [&](size_t ringFrame, size_t n)
+               {
+                 if (mLayout == kInterleaved)
+                 {
+                   deinterleave(getChannelPtr(0, ringFrame), mChannels, mReadDestPtrs.data(), n);
+                 }
+                 else
+                 {
+                   for (size_t c = 0; c < mChannels; ++c)
+                   {
+                     const float *pSrc = getChannelPtr(c, ringFrame);
+                     std::copy(pSrc, pSrc + n, mReadDestPtrs[c]);
+                   }
+                 }
+                 for (auto &p : mReadDestPtrs)
+                 {
+                   p += n;
+                 }
+               });
+  }
+
+ public:
+  MultiChannelDSPBuffer() {}
+  ~MultiChannelDSPBuffer() {}
+
+  // resize the buffer, allocating 2^n frames sufficient to contain the
+  // requested length. Returns the new size in frames, or 0 if allocation
+  // failed.
+  size_t resize(size_t channels, int sizeInFrames, Layout layout = kPlanar)
+  {
+    mReadIndex = mWriteIndex = 0;
+    mLayout = layout;
+    mChannels = channels;
+
+    int sizeBits = (int)ml::bitsToContain(sizeInFrames);
+    mSize = std::max((1 << sizeBits), (int)kFloatsPerDSPVector);
+
+    try
+    {
+      mData.assign(mSize * mChannels, 0.f);
+      mWriteSrcPtrs.resize(mChannels);
+      mWriteRingPtrs.resize(mChannels);
+      mReadDestPtrs.resize(mChannels);
+      mReadRingPtrs.resize(mChannels);
+      mZeros.assign(mSize, 0.f);
+      mDiscard.resize(mSize);
+    }
+    catch (const std::bad_alloc &)
+    {
+      mSize = mDataMask = mDistanceMask = mChannels = 0;
+      return 0;
+    }
+
+    // as in DSPBuffer, the indices run over twice the size so that full and
+    // empty can be distinguished.
+    mDataMask = mSize - 1;
+    mDistanceMask = mSize * 2 - 1;
+    return mSize;
+  }
+
+  // clear the buffer.
+  void clear()
+  {
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+    mReadIndex.store(currentWriteIndex, std::memory_order_release);
+  }
+
+  size_t getChannels() const { return mChannels; }
+  Layout getLayout() const { return mLayout; }
+
+  // return the number of frames available for reading.
+  size_t getReadAvailable() const
+  {
+    size_t a = mReadIndex.load(std::memory_order_acquire);
+    size_t b = mWriteIndex.load(std::memory_order_acquire);
+    return (b - a) & mDistanceMask;
+  }
+
+  // return the frames of free space available for writing.
+  size_t getWriteAvailable() const { return mSize - getReadAvailable(); }
+
+  // write n frames from a pointer to each channel, advancing the write index.
+  // Null pointers write silence. If the buffer is full, the oldest frames are
+  // overwritten.
+  void write(const float *const *pSrc, size_t frames)
+  {
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mWriteSrcPtrs[c] = pSrc[c] ? pSrc[c] : mZeros.data();
+    }
+    writePlanar(frames);
+  }
+
+  // write n interleaved frames, advancing the write index.
+  void writeInterleaved(const float *pSrc, size_t frames)
+  {
+    writeFrames(frames,
+                [&](size_t ringFrame, size_t n)
+                {
+                  if (mLayout == kInterleaved)
+                  {
+                    std::copy(pSrc, pSrc + n * mChannels, getChannelPtr(0, ringFrame));
+                  }
+                  else
+                  {
+                    for (size_t c = 0; c < mChannels; ++c)
+                    {
+                      mWriteRingPtrs[c] = getChannelPtr(c, ringFrame);
+                    }
+                    deinterleave(pSrc, mChannels, mWriteRingPtrs.data(), n);
+                  }
+                  pSrc += n * mChannels;
+                });
+  }
+
+  // write one DSPVector to each channel. Rows past the number of channels are
+  // ignored, and channels past the number of rows are written with silence.
+  template <size_t ROWS>
+  void write(const DSPVectorArray<ROWS> &srcVec)
+  {
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mWriteSrcPtrs[c] = (c < ROWS) ? srcVec.getRowDataConst(c) : mZeros.data();
+    }
+    writePlanar(kFloatsPerDSPVector);
+  }
+
+  void write(const DSPVectorDynamic &srcVec)
+  {
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mWriteSrcPtrs[c] = (c < srcVec.size()) ? srcVec[c].getConstBuffer() : mZeros.data();
+    }
+    writePlanar(kFloatsPerDSPVector);
+  }
+
+  // read up to n frames to a pointer for each channel, advancing the read
+  // index. Channels with null pointers are skipped. Returns the number of
+  // frames read.
+  size_t read(float *const *pDest, size_t frames)
+  {
+    frames = std::min(frames, getReadAvailable());
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mReadDestPtrs[c] = pDest[c] ? pDest[c] : mDiscard.data();
+    }
+    readPlanar(frames);
+    return frames;
+  }
+
+  // read up to n interleaved frames, advancing the read index. Returns the
+  // number of frames read.
+  size_t readInterleaved(float *pDest, size_t frames)
+  {
+    frames = std::min(frames, getReadAvailable());
+    readFrames(frames,
+               [&](size_t ringFrame, size_t n)
+               {
+                 if (mLayout == kInterleaved)
+                 {
+                   const float *pSrc = getChannelPtr(0, ringFrame);
+                   std::copy(pSrc, pSrc + n * mChannels, pDest);
+                 }
+                 else
+                 {
+                   for (size_t c = 0; c < mChannels; ++c)
+                   {
+                     mReadRingPtrs[c] = getChannelPtr(c, ringFrame);
+                   }
+                   interleave(mReadRingPtrs.data(), mChannels, pDest, n);
+                 }
+                 pDest += n * mChannels;
+               });
+    return frames;
+  }
+
+  // read one DSPVector from each channel, advancing the read index. Rows past
+  // the number of channels are set to 0. If a whole DSPVector is not
+  // available, nothing is read and false is returned.
+  template <size_t ROWS>
+  bool read(DSPVectorArray<ROWS> &destVec)
+  {
+    if (getReadAvailable() < kFloatsPerDSPVector) return false;
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mReadDestPtrs[c] = (c < ROWS) ? destVec.getRowData(c) : mDiscard.data();
+    }
+    for (size_t c = mChannels; c < ROWS; ++c)
+    {
+      std::fill(destVec.getRowData(c), destVec.getRowData(c) + kFloatsPerDSPVector, 0.f);
+    }
+    readPlanar(kFloatsPerDSPVector);
+    return true;
+  }
+
+  bool read(DSPVectorDynamic &destVec)
+  {
+    if (getReadAvailable() < kFloatsPerDSPVector) return false;
+    for (size_t c = 0; c < mChannels; ++c)
+    {
+      mReadDestPtrs[c] = (c < destVec.size()) ? destVec[c].getBuffer() : mDiscard.data();
+    }
+    for (size_t c = mChannels; c < destVec.size(); ++c)
+    {
+      destVec[c] = DSPVector();
+    }
+    readPlanar(kFloatsPerDSPVector);
+    return true;
+  }
+
+  // discard n frames by advancing the read index.
+  void discard(size_t frames)
+  {
+    frames = std::min(frames, getReadAvailable());
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    mReadIndex.store((currentReadIndex + frames) & mDistanceMask, std::memory_order_release);
+  }
+};
 }  // namespace ml
@@ -443,6 +443,162 @@ class Bell
   }
 };
 
+// --------------------------------------------------------------------------------
+// ModalBank
+// A bank of SIZE two-pole resonators for modal synthesis. Modes are processed four
+// at a time in SIMD lanes, all driven by the same input and summed to OUTPUTS
+// outputs in the same pass. Each mode has a frequency omega, a decay time in
+// samples over which it falls by 60dB, and a gain. An output gain per mode for
+// each output allows stereo or multi-pickup mixes.
+//
+// Each mode costs a few SIMD multiply-adds per four modes per sample, so large
+// banks are much cheaper than a Bank<Bandpass>. New coefficients take effect at
+// the start of the next DSPVector.
+
+template <size_t SIZE, size_t OUTPUTS = 1>
+class ModalBank
+{
+  static constexpr size_t kGroups{(SIZE + kFloatsPerSIMDVector - 1) / kFloatsPerSIMDVector};
+  static constexpr size_t kPaddedSize{kGroups * kFloatsPerSIMDVector};
+
+  // coefficients and state for each mode. Padding modes past SIZE have all zero
+  // coefficients, so they produce no output.
+  alignas(16) std::array<float, kPaddedSize> mA1{};
+  alignas(16) std::array<float, kPaddedSize> mA2{};
+  alignas(16) std::array<float, kPaddedSize> mB0{};
+  alignas(16) std::array<float, kPaddedSize> mY1{};
+  alignas(16) std::array<float, kPaddedSize> mY2{};
+  alignas(16) std::array<std::array<float, kPaddedSize>, OUTPUTS> mOutputGains;
+
+ public:
+  ModalBank()
+  {
+    for (auto& gains : mOutputGains)
+    {
+      gains.fill(0.f);
+      std::fill(gains.begin(), gains.begin() + SIZE, 1.f);
+    }
+  }
+
+  // set one mode. The impulse response of the mode is gain*r^n*sin((n + 1)*theta),
+  // where theta = 2*pi*omega and r^decayInSamples = -60dB.
+  void setMode(size_t mode, float omega, float decayInSamples, float gain)
+  {
+    if (mode >= SIZE) return;
+    float theta = kTwoPi * omega;
+    float r = expf(-6.9077553f / max(decayInSamples, 1.f));
+    mA1[mode] = 2.f * r * cosf(theta);
+    mA2[mode] = -r * r;
+    mB0[mode] = gain * sinf(theta);
+  }
+
+  // set all modes at once, computing the coefficients four modes at a time.
+  void setModes(const std::array<float, SIZE>& omegas, const std::array<float, SIZE>& decays,
+                const std::array<float, SIZE>& gains)
+  {
+    alignas(16) std::array<float, kPaddedSize> w{};
+    alignas(16) std::array<float, kPaddedSize> d{};
+    alignas(16) std::array<float, kPaddedSize> g{};
+    std::copy(omegas.begin(), omegas.end(), w.begin());
+    std::copy(decays.begin(), decays.end(), d.begin());
+    std::copy(gains.begin(), gains.end(), g.begin());
+
+    for (size_t i = 0; i < kPaddedSize; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat theta = vecMul(vecLoad(&w[i]), vecSet1(kTwoPi));
+      SIMDVectorFloat s, c;
+      vecSinCos(theta, &s, &c);
+      SIMDVectorFloat decay = vecMax(vecLoad(&d[i]), vecSet1(1.f));
+      SIMDVectorFloat r = vecExp(vecDiv(vecSet1(-6.9077553f), decay));
+      vecStore(&mA1[i], vecMul(vecMul(vecSet1(2.f), r), c));
+      vecStore(&mA2[i], vecSub(vecZeros(), vecMul(r, r)));
+      vecStore(&mB0[i], vecMul(vecLoad(&g[i]), s));
+    }
+    for (size_t i = SIZE; i < kPaddedSize; ++i)
+    {
+      mA1[i] = mA2[i] = mB0[i] = 0.f;
+    }
+  }
+
+  // set the gain from the given mode to the given output. By default every mode
+  // goes to every output with unity gain.
+  void setOutputGain(size_t output, size_t mode, float gain)
+  {
+    if ((output >= OUTPUTS) || (mode >= SIZE)) return;
+    mOutputGains[output][mode] = gain;
+  }
+
+  void clear()
+  {
+    mY1.fill(0.f);
+    mY2.fill(0.f);
+  }
+
+  inline DSPVectorArray<OUTPUTS> operator()(const DSPVector vx)
+  {
+    // broadcast each input sample once for all groups of modes.
+    SIMDVectorFloat vxb[kFloatsPerDSPVector];
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      vxb[n] = vecSet1(vx[n]);
+    }
+
+    // accumulate a SIMD vector of partial sums per output sample.
+    SIMDVectorFloat sums[OUTPUTS][kFloatsPerDSPVector];
+    for (int j = 0; j < OUTPUTS; ++j)
+    {
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        sums[j][n] = vecZeros();
+      }
+    }
+
+    for (size_t i = 0; i < kPaddedSize; i += kFloatsPerSIMDVector)
+    {
+      const SIMDVectorFloat a1 = vecLoad(&mA1[i]);
+      const SIMDVectorFloat a2 = vecLoad(&mA2[i]);
+      const SIMDVectorFloat b0 = vecLoad(&mB0[i]);
+      SIMDVectorFloat y1 = vecLoad(&mY1[i]);
+      SIMDVectorFloat y2 = vecLoad(&mY2[i]);
+      SIMDVectorFloat gains[OUTPUTS];
+      for (int j = 0; j < OUTPUTS; ++j)
+      {
+        gains[j] = vecLoad(&mOutputGains[j][i]);
+      }
+
+      for (int n = 0; n < kFloatsPerDSPVector; ++n)
+      {
+        SIMDVectorFloat y0 = vecAdd(vecMul(b0, vxb[n]), vecAdd(vecMul(a1, y1), vecMul(a2, y2)));
+        y2 = y1;
+        y1 = y0;
+        for (int j = 0; j < OUTPUTS; ++j)
+        {
+          sums[j][n] = vecAdd(sums[j][n], vecMul(gains[j], y0));
+        }
+      }
+      vecStore(&mY1[i], y1);
+      vecStore(&mY2[i], y2);
+    }
+
+    // transpose each four partial sums so that adding them makes four output samples.
+    DSPVectorArray<OUTPUTS> vy;
+    for (int j = 0; j < OUTPUTS; ++j)
+    {
+      float* py = vy.getRowData(j);
+      for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat s0 = sums[j][n];
+        SIMDVectorFloat s1 = sums[j][n + 1];
+        SIMDVectorFloat s2 = sums[j][n + 2];
+        SIMDVectorFloat s3 = sums[j][n + 3];
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+        vecStore(py + n, vecAdd(vecAdd(s0, s1), vecAdd(s2, s3)));
+      }
+    }
+    return vy;
+  }
+};
+
 // A one pole filter. see https://ccrma.stanford.edu/~jos/fp/One_Pole.html
 
 struct OnePole
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <cstring>
+
 #include "MLDSPFunctional.h"
 #include "MLDSPOps.h"
 #include "MLDSPUtils.h"
@@ -46,66 +48,204 @@ class TickGen
   }
 };
 
+// accumulate a 32-bit phase over one DSPVector, as in PhasorGen, storing the
+// phase and step for each sample. Frequencies are clamped to [0, 0.5] cycles per
+// sample. Returns a mask with bit n set if the phase wrapped at sample n. The
+// wrap happened phases[n] / steps[n] samples before sample n.
+inline uint64_t accumulatePhaseWraps(uint32_t& phase, const DSPVector cyclesPerSample,
+                                     uint32_t* phases, uint32_t* steps)
+{
+  constexpr float kStepsPerCycle{static_cast<float>(const_math::pow(2., 32))};
+  const SIMDVectorInt signBit = vecSetInt1(0x80000000);
+  const float* px = cyclesPerSample.getConstBuffer();
+  SIMDVectorInt vPhase = vecSetInt1(phase);
+  uint64_t wraps{0};
+
+  for (int i = 0; i < kSIMDVectorsPerDSPVector; ++i)
+  {
+    // 0.5 cycles rounds to 0x80000000, which is correct as an unsigned step.
+    SIMDVectorFloat cycles = vecClamp(vecLoad(px), vecZeros(), vecSet1(0.5f));
+    SIMDVectorInt vStep = vecFloatToIntRound(vecMul(cycles, vecSet1(kStepsPerCycle)));
+
+    // inclusive prefix sum of the steps, added to the previous phase
+    SIMDVectorInt sum = vecAddInt(vStep, _mm_slli_si128(vStep, 4));
+    sum = vecAddInt(sum, _mm_slli_si128(sum, 8));
+    vPhase = vecAddInt(sum, vPhase);
+
+    // the phase wrapped where it is now less than the step, as unsigned ints.
+    SIMDVectorInt wrapped =
+        _mm_cmplt_epi32(_mm_xor_si128(vPhase, signBit), _mm_xor_si128(vStep, signBit));
+    wraps |= static_cast<uint64_t>(_mm_movemask_ps(VecI2F(wrapped))) << (i * kIntsPerSIMDVector);
+
+    _mm_storeu_si128(reinterpret_cast<SIMDVectorInt*>(phases), vPhase);
+    _mm_storeu_si128(reinterpret_cast<SIMDVectorInt*>(steps), vStep);
+    phases += kIntsPerSIMDVector;
+    steps += kIntsPerSIMDVector;
+    px += kFloatsPerSIMDVector;
+    vPhase = _mm_shuffle_epi32(vPhase, SHUFFLE(3, 3, 3, 3));
+  }
+  phase = phases[-1];
+  return wraps;
+}
+
 // generate an antialiased impulse, repeating at a frequency given by the input.
-// limitations to fix:
-//     frequency can't be higher than sr / table size.
-//     table output is only positioned to the nearest sample.
+// Each impulse is a windowed sinc positioned to a fraction of a sample by
+// interpolating the phase crossing, and has unity area. Impulses may overlap, so
+// any frequency up to sr / 2 can be made. The kernel is centered
+// kKernelSize / 2 samples after the crossing, which is the latency of the
+// generator.
 class ImpulseGen
 {
-  // pick odd table size to get sample-centered sinc and window
-  static constexpr int kTableSize{17};
-  DSPVector _table;
-  static_assert(kTableSize < kFloatsPerDSPVector,
-                "ImpulseGen: table size must be < the DSP vector size.");
+ public:
+  static constexpr int kKernelSize{16};
+  static constexpr int kKernelPhases{64};
+
+ private:
+  static_assert(kKernelSize % kFloatsPerSIMDVector == 0,
+                "ImpulseGen: kernel size must be a multiple of the SIMD vector size.");
+  static_assert(kKernelSize <= kFloatsPerDSPVector,
+                "ImpulseGen: kernel size must be <= the DSP vector size.");
 
-  int _outputCounter;
-  float _omega{0.f};
+  // a table of kernels for each fractional offset in [0, 1], one row per offset.
+  struct KernelTable
+  {
+    alignas(16) std::array<float, (kKernelPhases + 1) * kKernelSize> data;
+
+    KernelTable()
+    {
+      // sinc with a cutoff of sr / 4 in a blackman window, as in the previous
+      // ImpulseGen, each row normalized for unity area.
+      const float omega = 0.25f;
+      for (int p = 0; p <= kKernelPhases; ++p)
+      {
+        float* row = data.data() + p * kKernelSize;
+        float sum{0.f};
+        for (int j = 0; j < kKernelSize; ++j)
+        {
+          float x = j - kKernelSize / 2 + static_cast<float>(p) / kKernelPhases;
+          float pi_x = kTwoPi * omega * x;
+          float sinc = (x == 0.f) ? 1.f : sinf(pi_x) / pi_x;
+          row[j] = sinc * dspwindows::blackman(x / kKernelSize + 0.5f);
+          sum += row[j];
+        }
+        for (int j = 0; j < kKernelSize; ++j)
+        {
+          row[j] /= sum;
+        }
+      }
+    }
+  };
+
+  // one table is shared by all ImpulseGens.
+  static const KernelTable& getTable()
+  {
+    static const KernelTable table;
+    return table;
+  }
+
+  uint32_t _phase{0};
+
+  // the end of the impulses that started in the previous vector
+  alignas(16) std::array<float, kKernelSize> _tail{};
 
  public:
-  ImpulseGen()
-  {
-    // make windowed sinc table
-    DSPVector windowVec;
-    makeWindow(windowVec.getBuffer(), kTableSize, dspwindows::blackman);
-    const float omega = 0.25f;
-    auto sincFn{[&](int i)
-                {
-                  float pi_x = ml::kTwoPi * omega * i;
-                  return (i == 0) ? 1.f : sinf(pi_x) / pi_x;
-                }};
-    DSPVector sincVec = map(sincFn, columnIndexInt() - DSPVectorInt((kTableSize - 1) / 2));
-    _table = normalize(sincVec * windowVec);
-  }
-  ~ImpulseGen() {}
+  void clear()
+  {
+    _phase = 0;
+    _tail.fill(0.f);
+  }
 
   inline DSPVector operator()(const DSPVector cyclesPerSample)
   {
-    // accumulate phase and wrap to generate ticks
-    DSPVector vy{0.f};
-    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    DSPVector vy;
+    process(cyclesPerSample, vy.getBuffer());
+    return vy;
+  }
+
+  // write one DSPVector of output to the aligned pointer pOutput.
+  inline void process(const DSPVector cyclesPerSample, float* pOutput)
+  {
+    const KernelTable& table = getTable();
+    alignas(16) uint32_t phases[kFloatsPerDSPVector];
+    alignas(16) uint32_t steps[kFloatsPerDSPVector];
+    uint64_t wraps = accumulatePhaseWraps(_phase, cyclesPerSample, phases, steps);
+
+    // overlap-add each impulse into an accumulator long enough for the whole
+    // kernel of an impulse starting at the last sample.
+    alignas(16) float acc[kFloatsPerDSPVector + kKernelSize];
+    std::copy(_tail.begin(), _tail.end(), acc);
+    std::fill(acc + kKernelSize, acc + kFloatsPerDSPVector + kKernelSize, 0.f);
+
+    while (wraps)
     {
-      _omega += cyclesPerSample[n];
-      if (_omega > 1.0f)
+      const int n = countTrailingZeros(wraps);
+      wraps &= wraps - 1;
+
+      // interpolate between the two kernels nearest the crossing's offset.
+      const float offset = static_cast<float>(phases[n]) / static_cast<float>(steps[n]);
+      const float p = min(offset, 1.f) * kKernelPhases;
+      const int ip = min(static_cast<int>(p), kKernelPhases - 1);
+      const SIMDVectorFloat vFrac = vecSet1(p - ip);
+      const float* pk0 = table.data.data() + ip * kKernelSize;
+      const float* pk1 = pk0 + kKernelSize;
+      float* pAcc = acc + n;
+      for (int j = 0; j < kKernelSize; j += kFloatsPerSIMDVector)
       {
-        _omega -= 1.0f;
-
-        // start an output impulse
-        _outputCounter = 0;
+        SIMDVectorFloat k0 = vecLoad(pk0 + j);
+        SIMDVectorFloat k1 = vecLoad(pk1 + j);
+        SIMDVectorFloat k = vecAdd(k0, vecMul(vFrac, vecSub(k1, k0)));
+        vecStoreUnaligned(pAcc + j, vecAdd(vecLoadUnaligned(pAcc + j), k));
       }
+    }
 
-      if (_outputCounter < kTableSize)
-      {
-        vy[n] = _table[_outputCounter];
-        _outputCounter++;
-      }
+    for (int i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+    {
+      vecStore(pOutput + i, vecLoad(acc + i));
+    }
+    std::copy(acc + kFloatsPerDSPVector, acc + kFloatsPerDSPVector + kKernelSize, _tail.begin());
+  }
+};
+
+// A bank of ImpulseGens, for many sync or clock pulse trains. Generator j runs
+// at the frequency on row j of the input. All the generators share one kernel
+// table.
+template <size_t ROWS>
+class ImpulseGenBank
+{
+  std::array<ImpulseGen, ROWS> _gens;
+
+ public:
+  void clear()
+  {
+    for (auto& g : _gens)
+    {
+      g.clear();
+    }
+  }
+
+  inline DSPVectorArray<ROWS> operator()(const DSPVectorArray<ROWS>& cyclesPerSample)
+  {
+    DSPVectorArray<ROWS> vy;
+    for (int j = 0; j < ROWS; ++j)
+    {
+      _gens[j].process(cyclesPerSample.constRow(j), vy.getRowData(j));
     }
     return vy;
   }
+
+  ImpulseGen& operator[](size_t n) { return _gens[n]; }
 };
 
+// convert 32 random bits in each element to a float on [-1, 1).
+inline SIMDVectorFloat vecRandomBitsToFloat(SIMDVectorInt v)
+{
+  SIMDVectorInt bits = _mm_or_si128(_mm_srli_epi32(v, 9), vecSetInt1(0x3F800000));
+  return vecSub(vecMul(VecI2F(bits), vecSet1(2.f)), vecSet1(3.f));
+}
+
 // generate a random number from -1 to 1 every sample.
 // NOTE: this will create more energy at higher sample rates!
-// TODO make proper pink noise, white noise gens
+// See also WhiteNoiseGen, PinkNoiseGen and BrownNoiseGen below.
 class NoiseGen
 {
  public:
@@ -128,16 +268,34 @@ class NoiseGen
     return (*reinterpret_cast<float*>(&temp)) * 2.f - 3.f;
   }
 
-  // TODO SIMD
+  // run four copies of the generator in SIMD lanes, each jumping ahead four steps
+  // at a time. The output is the same as stepping one sample at a time.
   inline DSPVector operator()()
   {
+    constexpr uint32_t kA{0x0019660D};
+    constexpr uint32_t kC{0x3C6EF35F};
+    constexpr uint32_t kA4{kA * kA * kA * kA};
+    constexpr uint32_t kC4{kC * (1 + kA + kA * kA + kA * kA * kA)};
+
+    uint32_t s0 = mSeed * kA + kC;
+    uint32_t s1 = s0 * kA + kC;
+    uint32_t s2 = s1 * kA + kC;
+    uint32_t s3 = s2 * kA + kC;
+    SIMDVectorInt vSeeds = vecSetInt4(s0, s1, s2, s3);
+
     DSPVector y;
-    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    float* py = y.getBuffer();
+    SIMDVectorIntUnion lastSeeds;
+    for (int i = 0; i < kSIMDVectorsPerDSPVector; ++i)
     {
-      step();
-      uint32_t temp = ((mSeed >> 9) & 0x007FFFFF) | 0x3F800000;
-      y[i] = (*reinterpret_cast<float*>(&temp)) * 2.f - 3.f;
+      vecStore(py, vecRandomBitsToFloat(vSeeds));
+      py += kFloatsPerSIMDVector;
+      lastSeeds.v = vSeeds;
+      vSeeds = vecAddInt(vecMulIntLo(vSeeds, vecSetInt1(kA4)), vecSetInt1(kC4));
     }
+
+    // the seed of the last output is the new state.
+    mSeed = lastSeeds.i[3];
     return y;
   }
 
@@ -147,6 +305,252 @@ class NoiseGen
   uint32_t mSeed = 0;
 };
 
+// ----------------------------------------------------------------
+// counter-based noise
+
+// Philox2x32-10, a counter-based random number generator from Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3" (SC11). Each 64-bit counter
+// and 32-bit key are scrambled into two 32-bit outputs that pass BigCrush.
+namespace philox
+{
+constexpr uint32_t kMultiplier{0xD256D193};
+constexpr uint32_t kKeyStep{0x9E3779B9};
+constexpr int kRounds{10};
+
+inline void scramble(uint32_t key, uint32_t& c0, uint32_t& c1)
+{
+  for (int r = 0; r < kRounds; ++r)
+  {
+    uint64_t product = static_cast<uint64_t>(kMultiplier) * c0;
+    uint32_t hi = static_cast<uint32_t>(product >> 32);
+    uint32_t lo = static_cast<uint32_t>(product);
+    c0 = hi ^ key ^ c1;
+    c1 = lo;
+    key += kKeyStep;
+  }
+}
+
+// scramble four counters at once.
+inline void scramble(SIMDVectorInt key, SIMDVectorInt& c0, SIMDVectorInt& c1)
+{
+  const SIMDVectorInt m = vecSetInt1(kMultiplier);
+  const SIMDVectorInt keyStep = vecSetInt1(kKeyStep);
+  for (int r = 0; r < kRounds; ++r)
+  {
+    SIMDVectorInt hi, lo;
+    vecMulIntHiLo(c0, m, &hi, &lo);
+    c0 = _mm_xor_si128(_mm_xor_si128(hi, key), c1);
+    c1 = lo;
+    key = vecAddInt(key, keyStep);
+  }
+}
+}  // namespace philox
+
+// White noise on [-1, 1) from a counter-based generator. The value at each sample
+// depends only on the seed and the sample's position, so the output is
+// reproducible no matter how it is divided into vectors or threads, and seeking
+// is free. Use different seeds to make independent streams, for example one per
+// voice.
+class WhiteNoiseGen
+{
+  uint32_t mSeed{0};
+  uint64_t mPosition{0};
+
+ public:
+  WhiteNoiseGen(uint32_t seed = 0) : mSeed(seed) {}
+  ~WhiteNoiseGen() {}
+
+  void setSeed(uint32_t seed) { mSeed = seed; }
+  uint32_t getSeed() const { return mSeed; }
+
+  // set the position in samples of the next output.
+  void seek(uint64_t position) { mPosition = position; }
+  uint64_t getPosition() const { return mPosition; }
+
+  void clear() { mPosition = 0; }
+
+  // return 32 random bits for the given seed and position. Each counter value
+  // makes the bits for two adjacent positions.
+  static inline uint32_t getBits(uint32_t seed, uint64_t position)
+  {
+    uint64_t counter = position >> 1;
+    uint32_t c0 = static_cast<uint32_t>(counter);
+    uint32_t c1 = static_cast<uint32_t>(counter >> 32);
+    philox::scramble(seed, c0, c1);
+    return (position & 1) ? c1 : c0;
+  }
+
+  inline float getSample()
+  {
+    uint32_t temp = ((getBits(mSeed, mPosition++) >> 9) & 0x007FFFFF) | 0x3F800000;
+    float f;
+    std::memcpy(&f, &temp, sizeof(f));
+    return f * 2.f - 3.f;
+  }
+
+  inline DSPVector operator()()
+  {
+    // scramble four counters per SIMD vector, making eight samples. If the
+    // position is odd, make one more group and start the output one sample in.
+    constexpr int kGroups{kFloatsPerDSPVector / (kIntsPerSIMDVector * 2)};
+    alignas(16) uint32_t bits[(kGroups + 1) * kIntsPerSIMDVector * 2];
+    const uint64_t firstCounter = mPosition >> 1;
+    const int offset = static_cast<int>(mPosition & 1);
+    const SIMDVectorInt vSeed = vecSetInt1(mSeed);
+
+    for (int i = 0; i < kGroups + offset; ++i)
+    {
+      uint64_t c = firstCounter + i * kIntsPerSIMDVector;
+      SIMDVectorInt c0 = vecSetInt4(static_cast<uint32_t>(c), static_cast<uint32_t>(c + 1),
+                                    static_cast<uint32_t>(c + 2), static_cast<uint32_t>(c + 3));
+      SIMDVectorInt c1 = vecSetInt4(
+          static_cast<uint32_t>(c >> 32), static_cast<uint32_t>((c + 1) >> 32),
+          static_cast<uint32_t>((c + 2) >> 32), static_cast<uint32_t>((c + 3) >> 32));
+      philox::scramble(vSeed, c0, c1);
+
+      // interleave the two outputs of each counter to put the samples in order.
+      SIMDVectorInt* pDest = reinterpret_cast<SIMDVectorInt*>(bits + i * kIntsPerSIMDVector * 2);
+      _mm_store_si128(pDest, _mm_unpacklo_epi32(c0, c1));
+      _mm_store_si128(pDest + 1, _mm_unpackhi_epi32(c0, c1));
+    }
+
+    DSPVector y;
+    float* py = y.getBuffer();
+    const uint32_t* pBits = bits + offset;
+    for (int i = 0; i < kSIMDVectorsPerDSPVector; ++i)
+    {
+      SIMDVectorInt v = _mm_loadu_si128(reinterpret_cast<const SIMDVectorInt*>(pBits));
+      vecStore(py, vecRandomBitsToFloat(v));
+      pBits += kIntsPerSIMDVector;
+      py += kFloatsPerSIMDVector;
+    }
+    mPosition += kFloatsPerDSPVector;
+    return y;
+  }
+};
+
+// Pink noise: white noise through Paul Kellet's economy filter, a sum of three
+// one-pole lowpass filters and a direct path, within 0.5dB of -3dB / octave
+// above 9Hz at 44.1kHz. The four paths run in SIMD lanes. The output level is
+// scaled to roughly the same RMS as the white noise.
+class PinkNoiseGen
+{
+  WhiteNoiseGen mWhite;
+  alignas(16) std::array<float, kFloatsPerSIMDVector> mState{};
+
+ public:
+  PinkNoiseGen(uint32_t seed = 0) : mWhite(seed) {}
+  ~PinkNoiseGen() {}
+
+  void setSeed(uint32_t seed) { mWhite.setSeed(seed); }
+
+  // seek the white noise source and clear the filter, so that the output after
+  // a seek depends only on the seed and position.
+  void seek(uint64_t position)
+  {
+    mWhite.seek(position);
+    mState.fill(0.f);
+  }
+
+  void clear() { seek(0); }
+
+  inline DSPVector operator()()
+  {
+    constexpr float kOutputGain{0.33f};
+    const SIMDVectorFloat vPoles = vecSetFloat4(0.99765f, 0.96300f, 0.57000f, 0.f);
+    const SIMDVectorFloat vGains = vecMul(vecSetFloat4(0.0990460f, 0.2965164f, 1.0526913f, 0.1848f),
+                                          vecSet1(kOutputGain));
+    DSPVector x = mWhite();
+
+    // run the filters, saving the four path outputs for each sample.
+    SIMDVectorFloat paths[kFloatsPerDSPVector];
+    SIMDVectorFloat s = vecLoad(mState.data());
+    for (int n = 0; n < kFloatsPerDSPVector; ++n)
+    {
+      s = vecAdd(vecMul(vPoles, s), vecMul(vGains, vecSet1(x[n])));
+      paths[n] = s;
+    }
+    vecStore(mState.data(), s);
+
+    // transpose each four samples of paths so that adding them makes four outputs.
+    DSPVector y;
+    float* py = y.getBuffer();
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat p0 = paths[n];
+      SIMDVectorFloat p1 = paths[n + 1];
+      SIMDVectorFloat p2 = paths[n + 2];
+      SIMDVectorFloat p3 = paths[n + 3];
+      _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+      vecStore(py + n, vecAdd(vecAdd(p0, p1), vecAdd(p2, p3)));
+    }
+    return y;
+  }
+};
+
+// Brown noise: white noise through a leaky integrator, falling at -6dB / octave
+// above a corner of about 14Hz at 44.1kHz. The recursion is unrolled so that
+// each four samples depend on the previous output only once. The output level
+// is scaled to roughly the same RMS as the white noise.
+class BrownNoiseGen
+{
+  WhiteNoiseGen mWhite;
+  float mY1{0.f};
+
+ public:
+  BrownNoiseGen(uint32_t seed = 0) : mWhite(seed) {}
+  ~BrownNoiseGen() {}
+
+  void setSeed(uint32_t seed) { mWhite.setSeed(seed); }
+
+  // seek the white noise source and clear the filter, so that the output after
+  // a seek depends only on the seed and position.
+  void seek(uint64_t position)
+  {
+    mWhite.seek(position);
+    mY1 = 0.f;
+  }
+
+  void clear() { seek(0); }
+
+  inline DSPVector operator()()
+  {
+    // y[n] = a*y[n - 1] + g*x[n], with g chosen for unity power gain.
+    constexpr float a{0.998f};
+    const float g = sqrtf(1.f - a * a);
+    const float a2 = a * a;
+    const float a3 = a2 * a;
+    const float a4 = a3 * a;
+
+    // each output of four depends on y[n - 1] and on the inputs up to it.
+    const SIMDVectorFloat vPrev = vecSetFloat4(a, a2, a3, a4);
+    const SIMDVectorFloat vX0 = vecMul(vecSet1(g), vecSetFloat4(1.f, a, a2, a3));
+    const SIMDVectorFloat vX1 = vecMul(vecSet1(g), vecSetFloat4(0.f, 1.f, a, a2));
+    const SIMDVectorFloat vX2 = vecMul(vecSet1(g), vecSetFloat4(0.f, 0.f, 1.f, a));
+    const SIMDVectorFloat vX3 = vecMul(vecSet1(g), vecSetFloat4(0.f, 0.f, 0.f, 1.f));
+
+    DSPVector x = mWhite();
+    const float* px = x.getConstBuffer();
+    DSPVector y;
+    float* py = y.getBuffer();
+    SIMDVectorFloat vy1 = vecSet1(mY1);
+    for (int n = 0; n < kFloatsPerDSPVector; n += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat vx = vecLoad(px + n);
+      SIMDVectorFloat sum =
+          vecAdd(vecMul(vX0, _mm_shuffle_ps(vx, vx, SHUFFLE(0, 0, 0, 0))),
+                 vecMul(vX1, _mm_shuffle_ps(vx, vx, SHUFFLE(1, 1, 1, 1))));
+      sum = vecAdd(sum, vecAdd(vecMul(vX2, _mm_shuffle_ps(vx, vx, SHUFFLE(2, 2, 2, 2))),
+                               vecMul(vX3, _mm_shuffle_ps(vx, vx, SHUFFLE(3, 3, 3, 3)))));
+      SIMDVectorFloat vy = vecAdd(sum, vecMul(vPrev, vy1));
+      vecStore(py + n, vy);
+      vy1 = vecBroadcast3(vy);
+    }
+    mY1 = py[kFloatsPerDSPVector - 1];
+    return y;
+  }
+};
+
 // super slow + accurate sine generator for testing
 class TestSineGen
 {
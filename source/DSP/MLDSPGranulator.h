@@ -0,0 +1,223 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// Granulator: a granular sample-playback engine.
+//
+// Grains are scheduled by a clock running at the density input, in grains per
+// sample, and start at a fraction of a sample like ImpulseGen's impulses. Each
+// grain reads one of up to kMaxSources Samples with linear interpolation,
+// starting at the position input (0-1 over the Sample) plus a random offset
+// scaled by the spread input, at a playback rate given by the pitch input. A
+// grain lasts for the duration input in samples, and is shaped by a window
+// looked up from a precomputed table. Sources are SampleViews, so they can be
+// Samples or memory-mapped files.
+//
+// All grains come from a fixed pool of MAX_GRAINS, so no allocation happens
+// while running. When the pool is empty, new grains are dropped and counted.
+
+#pragma once
+
+#include "MLDSPGens.h"
+#include "MLDSPOps.h"
+#include "MLDSPSample.h"
+#include "MLDSPUtils.h"
+
+namespace ml
+{
+template <size_t MAX_GRAINS, size_t CHANNELS = 1>
+class Granulator
+{
+ public:
+  static constexpr size_t kMaxSources{8};
+  static constexpr int kWindowTableSize{1024};
+
+ private:
+  struct Grain
+  {
+    // a copy of the source's view, so changing the source doesn't affect
+    // grains already playing from it.
+    SampleView source;
+
+    // read position and window phase at the start of the current vector. For a
+    // new grain, these are extrapolated back from its start time.
+    double position;
+    float rate;
+    float windowPhase;
+    float windowStep;
+  };
+
+  std::array<Grain, MAX_GRAINS> _grains;
+
+  // indices of free and active grains
+  std::array<uint32_t, MAX_GRAINS> _freeList;
+  std::array<uint32_t, MAX_GRAINS> _activeList;
+  size_t _freeCount{MAX_GRAINS};
+  size_t _activeCount{0};
+  size_t _droppedGrains{0};
+
+  std::array<SampleView, kMaxSources> _sources{};
+  std::vector<float> _windowTable;
+  WhiteNoiseGen _random;
+  uint32_t _clockPhase{0};
+
+  void startGrain(const SampleView& source, float startTime, double position, float rate,
+                  float duration)
+  {
+    if (!_freeCount)
+    {
+      _droppedGrains++;
+      return;
+    }
+    uint32_t idx = _freeList[--_freeCount];
+    _activeList[_activeCount++] = idx;
+
+    Grain& g = _grains[idx];
+    g.source = source;
+    g.rate = rate;
+    g.windowStep = 1.f / max(duration, 1.f);
+    g.position = position - startTime * rate;
+    g.windowPhase = -startTime * g.windowStep;
+  }
+
+  // add one vector of the grain to the outputs. Returns true if the grain is
+  // still playing afterwards.
+  bool runGrain(Grain& g, float** pOutputs)
+  {
+    const SampleView& src = g.source;
+
+    // window
+    DSPVector phase = clamp(columnIndex() * DSPVector(g.windowStep) + DSPVector(g.windowPhase),
+                            DSPVector(0.f), DSPVector(1.f));
+    alignas(16) int32_t intParts[kFloatsPerDSPVector];
+    DSPVector fracParts, w0, w1;
+    splitOffsets(phase * DSPVector(kWindowTableSize), intParts, fracParts.getBuffer());
+    float* pw0 = w0.getBuffer();
+    float* pw1 = w1.getBuffer();
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      pw0[i] = _windowTable[intParts[i]];
+      pw1[i] = _windowTable[intParts[i] + 1];
+    }
+    DSPVector window = w0 + fracParts * (w1 - w0);
+
+    // read
+    const int64_t startFrame = static_cast<int64_t>(std::floor(g.position));
+    const float startFrac = static_cast<float>(g.position - startFrame);
+    DSPVector offsets = columnIndex() * DSPVector(g.rate) + DSPVector(startFrac);
+    for (int c = 0; c < CHANNELS; ++c)
+    {
+      DSPVector x = readLinear(src, c % src.channels, startFrame, offsets);
+      x *= window;
+      float* py = pOutputs[c];
+      const float* px = x.getConstBuffer();
+      for (int i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+      {
+        vecStore(py + i, vecAdd(vecLoad(py + i), vecLoad(px + i)));
+      }
+    }
+
+    g.position += static_cast<double>(g.rate) * kFloatsPerDSPVector;
+    g.windowPhase += g.windowStep * kFloatsPerDSPVector;
+    return g.windowPhase < 1.f;
+  }
+
+ public:
+  Granulator(Projection windowShape = dspwindows::raisedCosine)
+      : _windowTable(kWindowTableSize + 2)
+  {
+    makeWindow(_windowTable.data(), kWindowTableSize + 1, windowShape);
+    _windowTable[kWindowTableSize + 1] = _windowTable[kWindowTableSize];
+    clear();
+  }
+
+  // set source n to the given view, or to an empty view to remove it. Grains
+  // already playing keep reading the view they started with, so the data must
+  // stay valid until they finish. New grains use the new view.
+  void setSource(size_t n, const SampleView& source)
+  {
+    if (n < kMaxSources)
+    {
+      _sources[n] = source;
+    }
+  }
+
+  void setSource(size_t n, const Sample* pSource)
+  {
+    setSource(n, pSource ? getView(*pSource) : SampleView{});
+  }
+
+  void setSeed(uint32_t seed) { _random.setSeed(seed); }
+
+  // stop all grains.
+  void clear()
+  {
+    for (uint32_t i = 0; i < MAX_GRAINS; ++i)
+    {
+      _freeList[i] = MAX_GRAINS - 1 - i;
+    }
+    _freeCount = MAX_GRAINS;
+    _activeCount = 0;
+    _clockPhase = 0;
+  }
+
+  size_t getActiveGrains() const { return _activeCount; }
+  size_t getDroppedGrains() const { return _droppedGrains; }
+
+  // density: grains per sample, up to 0.5.
+  // position: grain start position, 0-1 over the source.
+  // pitch: playback rate, in source frames per sample. May be negative.
+  // duration: grain duration in samples.
+  // spread: random position offset, 0-1 over the source.
+  // source: index of the source to play.
+  DSPVectorArray<CHANNELS> operator()(const DSPVector density, const DSPVector position,
+                                      const DSPVector pitch, const DSPVector duration,
+                                      const DSPVector spread,
+                                      const DSPVector source = DSPVector(0.f))
+  {
+    // start new grains at each tick of the clock.
+    alignas(16) uint32_t phases[kFloatsPerDSPVector];
+    alignas(16) uint32_t steps[kFloatsPerDSPVector];
+    uint64_t ticks = accumulatePhaseWraps(_clockPhase, density, phases, steps);
+    while (ticks)
+    {
+      const int n = countTrailingZeros(ticks);
+      ticks &= ticks - 1;
+
+      const size_t sourceIdx = clamp(static_cast<int>(source[n]), 0, (int)kMaxSources - 1);
+      const SampleView& src = _sources[sourceIdx];
+      if (!usable(src)) continue;
+
+      const float startTime = n - static_cast<float>(phases[n]) / static_cast<float>(steps[n]);
+      const float jitter = _random.getSample() * spread[n] * 0.5f;
+      const double startPosition =
+          static_cast<double>(clamp(position[n] + jitter, 0.f, 1.f)) * getFrames(src);
+      startGrain(src, startTime, startPosition, pitch[n], duration[n]);
+    }
+
+    // run active grains, removing finished ones from the active list.
+    DSPVectorArray<CHANNELS> vy;
+    std::array<float*, CHANNELS> pOutputs;
+    for (int c = 0; c < CHANNELS; ++c)
+    {
+      pOutputs[c] = vy.getRowData(c);
+    }
+    size_t i = 0;
+    while (i < _activeCount)
+    {
+      uint32_t idx = _activeList[i];
+      if (runGrain(_grains[idx], pOutputs.data()))
+      {
+        i++;
+      }
+      else
+      {
+        _freeList[_freeCount++] = idx;
+        _activeList[i] = _activeList[--_activeCount];
+      }
+    }
+    return vy;
+  }
+};
+
+}  // namespace ml
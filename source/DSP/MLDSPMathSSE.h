@@ -158,6 +158,11 @@ inline SIMDVectorInt vecSetInt4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
   return _mm_set_epi32(d, c, b, a);
 }
 
+inline SIMDVectorFloat vecSetFloat4(float a, float b, float c, float d)
+{
+  return _mm_set_ps(d, c, b, a);
+}
+
 static const int XI = 0xFFFFFFFF;
 static const float X = *(reinterpret_cast<const float*>(&XI));
 
@@ -184,6 +189,28 @@ const SIMDVectorFloat vecMaskF = {X, X, X, X};
 #define vecShiftElementsLeft(x1, i) _mm_slli_si128(x1, 4 * i);
 #define vecShiftElementsRight(x1, i) _mm_srli_si128(x1, 4 * i);
 
+// multiply unsigned 32-bit ints, returning the high and low 32 bits of each
+// 64-bit product. SSE2 has no _mm_mullo_epi32, so we use two 32 x 32 -> 64 bit
+// multiplies on the even and odd elements.
+inline void vecMulIntHiLo(SIMDVectorInt a, SIMDVectorInt b, SIMDVectorInt* hi, SIMDVectorInt* lo)
+{
+  SIMDVectorInt p02 = _mm_mul_epu32(a, b);
+  SIMDVectorInt p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  *lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, SHUFFLE(0, 0, 2, 0)),
+                           _mm_shuffle_epi32(p13, SHUFFLE(0, 0, 2, 0)));
+  *hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, SHUFFLE(0, 0, 3, 1)),
+                           _mm_shuffle_epi32(p13, SHUFFLE(0, 0, 3, 1)));
+}
+
+// multiply 32-bit ints, returning the low 32 bits of each product.
+inline SIMDVectorInt vecMulIntLo(SIMDVectorInt a, SIMDVectorInt b)
+{
+  SIMDVectorInt p02 = _mm_mul_epu32(a, b);
+  SIMDVectorInt p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(p13, SHUFFLE(0, 0, 2, 0)));
+}
+
 inline std::ostream& operator<<(std::ostream& out, SIMDVectorFloat v)
 {
   SIMDVectorFloatUnion u;
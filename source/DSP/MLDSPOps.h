@@ -499,6 +499,10 @@ typedef DSPVectorArrayInt<1> DSPVectorInt;
 
 // ----------------------------------------------------------------
 // DSPVectorDynamic: for holding a number of DSPVectors only known at runtime.
+//
+// Each row can also be attached to a DSPVector's worth of 16-byte aligned
+// memory outside the object, such as a host's audio buffer, so that it can be
+// processed in place. Copies always get their own data.
 
 class DSPVectorDynamic final
 {
@@ -506,18 +510,59 @@ class DSPVectorDynamic final
   DSPVectorDynamic() = default;
   ~DSPVectorDynamic() = default;
 
-  DSPVectorDynamic(size_t rows) { _data.resize(rows); }
+  DSPVectorDynamic(size_t rows) { resize(rows); }
+
+  DSPVectorDynamic(const DSPVectorDynamic& b) : _data(b.size())
+  {
+    for (size_t j = 0; j < size(); ++j)
+    {
+      _data[j] = b[j];
+    }
+    detachRows();
+  }
+
+  DSPVectorDynamic& operator=(const DSPVectorDynamic& b)
+  {
+    if (this != &b)
+    {
+      resize(b.size());
+      for (size_t j = 0; j < size(); ++j)
+      {
+        (*this)[j] = b[j];
+      }
+    }
+    return *this;
+  }
 
-  void resize(size_t rows) { _data.resize(rows); }
+  void resize(size_t rows)
+  {
+    _data.resize(rows);
+    detachRows();
+  }
 
   size_t size() const { return _data.size(); }
 
-  DSPVector& operator[](int j) { return _data[j]; }
+  DSPVector& operator[](int j) { return *_rows[j]; }
 
-  const DSPVector& operator[](int j) const { return _data[j]; }
+  const DSPVector& operator[](int j) const { return *_rows[j]; }
+
+  // make row j refer to the kFloatsPerDSPVector floats at pData, which must be
+  // aligned to 16 bytes, until detachRows() is called.
+  void attachRow(int j, float* pData) { _rows[j] = reinterpret_cast<DSPVector*>(pData); }
+
+  // make all rows refer to this object's own data again.
+  void detachRows()
+  {
+    _rows.resize(_data.size());
+    for (size_t j = 0; j < _data.size(); ++j)
+    {
+      _rows[j] = &_data[j];
+    }
+  }
 
  private:
   std::vector<DSPVector> _data;
+  std::vector<DSPVector*> _rows;
 };
 
 // ----------------------------------------------------------------
@@ -565,6 +610,103 @@ inline void storeAligned(const DSPVectorArray<ROWS>& vecSrc, float* pDest)
   }
 }
 
+// ----------------------------------------------------------------
+// interleave and deinterleave
+//
+// Convert between planar data, with a pointer to each channel, and
+// interleaved frames. Stereo and multiples of four channels use SIMD shuffles.
+// No alignment is required.
+
+inline void interleave(const float* const* pSrc, size_t channels, float* pDest, size_t frames)
+{
+  size_t f = 0;
+  if (channels == 2)
+  {
+    const float* pL = pSrc[0];
+    const float* pR = pSrc[1];
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat l = vecLoadUnaligned(pL + f);
+      SIMDVectorFloat r = vecLoadUnaligned(pR + f);
+      vecStoreUnaligned(pDest + f * 2, _mm_unpacklo_ps(l, r));
+      vecStoreUnaligned(pDest + f * 2 + kFloatsPerSIMDVector, _mm_unpackhi_ps(l, r));
+    }
+  }
+  else if (channels % kFloatsPerSIMDVector == 0)
+  {
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      for (size_t c = 0; c < channels; c += kFloatsPerSIMDVector)
+      {
+        SIMDVectorFloat r0 = vecLoadUnaligned(pSrc[c] + f);
+        SIMDVectorFloat r1 = vecLoadUnaligned(pSrc[c + 1] + f);
+        SIMDVectorFloat r2 = vecLoadUnaligned(pSrc[c + 2] + f);
+        SIMDVectorFloat r3 = vecLoadUnaligned(pSrc[c + 3] + f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        float* py = pDest + f * channels + c;
+        vecStoreUnaligned(py, r0);
+        vecStoreUnaligned(py + channels, r1);
+        vecStoreUnaligned(py + channels * 2, r2);
+        vecStoreUnaligned(py + channels * 3, r3);
+      }
+    }
+  }
+
+  // remaining frames
+  for (; f < frames; ++f)
+  {
+    for (size_t c = 0; c < channels; ++c)
+    {
+      pDest[f * channels + c] = pSrc[c][f];
+    }
+  }
+}
+
+inline void deinterleave(const float* pSrc, size_t channels, float* const* pDest, size_t frames)
+{
+  size_t f = 0;
+  if (channels == 2)
+  {
+    float* pL = pDest[0];
+    float* pR = pDest[1];
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat a = vecLoadUnaligned(pSrc + f * 2);
+      SIMDVectorFloat b = vecLoadUnaligned(pSrc + f * 2 + kFloatsPerSIMDVector);
+      vecStoreUnaligned(pL + f, _mm_shuffle_ps(a, b, SHUFFLE(2, 0, 2, 0)));
+      vecStoreUnaligned(pR + f, _mm_shuffle_ps(a, b, SHUFFLE(3, 1, 3, 1)));
+    }
+  }
+  else if (channels % kFloatsPerSIMDVector == 0)
+  {
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      for (size_t c = 0; c < channels; c += kFloatsPerSIMDVector)
+      {
+        const float* px = pSrc + f * channels + c;
+        SIMDVectorFloat r0 = vecLoadUnaligned(px);
+        SIMDVectorFloat r1 = vecLoadUnaligned(px + channels);
+        SIMDVectorFloat r2 = vecLoadUnaligned(px + channels * 2);
+        SIMDVectorFloat r3 = vecLoadUnaligned(px + channels * 3);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        vecStoreUnaligned(pDest[c] + f, r0);
+        vecStoreUnaligned(pDest[c + 1] + f, r1);
+        vecStoreUnaligned(pDest[c + 2] + f, r2);
+        vecStoreUnaligned(pDest[c + 3] + f, r3);
+      }
+    }
+  }
+
+  // remaining frames
+  for (; f < frames; ++f)
+  {
+    for (size_t c = 0; c < channels; ++c)
+    {
+      pDest[c][f] = pSrc[f * channels + c];
+    }
+  }
+}
+
 // ----------------------------------------------------------------
 // unary vector operators (float) -> float
 
@@ -7,8 +7,12 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
+#include "MLDSPOps.h"
+
 namespace ml
 {
 
@@ -82,18 +86,278 @@ inline float* resize(Sample& s, size_t newFrames, size_t newChans = 1)
   return s.sampleData.data();
 }
 
+// SampleView: a read-only view of interleaved sample data owned elsewhere,
+// such as by a Sample or a memory-mapped file. The owner must outlive the view.
+struct SampleView
+{
+  const float* data{nullptr};
+  size_t frames{0};
+  size_t channels{0};
+  size_t sampleRate{0};
+};
+
+inline SampleView getView(const Sample& s)
+{
+  return SampleView{s.sampleData.data(), getFrames(s), s.channels, s.sampleRate};
+}
+
+inline size_t getFrames(const SampleView& v)
+{
+  return v.frames;
+}
+
+inline bool usable(const SampleView& v)
+{
+  return v.data && v.frames && v.channels;
+}
+
+// ----------------------------------------------------------------
+// analysis and gain
+//
+// These kernels work on runs of floats with SIMD and need no alignment, so
+// they can scan whole interleaved Samples as well as single channels.
+
+// the largest value, or the lowest float if there are none.
+inline float findMaximumValue(const float* px, size_t n)
+{
+  SIMDVectorFloat vMax = vecSet1(std::numeric_limits<float>::lowest());
+  size_t i = 0;
+  for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+  {
+    vMax = vecMax(vMax, vecLoadUnaligned(px + i));
+  }
+  float y = vecMaxH(vMax);
+  for (; i < n; ++i)
+  {
+    y = std::max(y, px[i]);
+  }
+  return y;
+}
+
+// the largest absolute value.
+inline float findPeak(const float* px, size_t n)
+{
+  SIMDVectorFloat vMax = vecZeros();
+  size_t i = 0;
+  for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+  {
+    vMax = vecMax(vMax, vecAbs(vecLoadUnaligned(px + i)));
+  }
+  float y = vecMaxH(vMax);
+  for (; i < n; ++i)
+  {
+    y = std::max(y, fabsf(px[i]));
+  }
+  return y;
+}
+
+// the sum of squares. Partial sums are kept in floats over short blocks and
+// added in double precision, so long runs don't lose accuracy.
+inline double sumOfSquares(const float* px, size_t n)
+{
+  constexpr size_t kBlockSize{4096};
+  double sum{0.};
+  size_t i = 0;
+  while (i + kFloatsPerSIMDVector <= n)
+  {
+    const size_t blockEnd = std::min(n, i + kBlockSize);
+    SIMDVectorFloat vSum = vecZeros();
+    for (; i + kFloatsPerSIMDVector <= blockEnd; i += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat x = vecLoadUnaligned(px + i);
+      vSum = vecAdd(vSum, vecMul(x, x));
+    }
+    sum += vecSumH(vSum);
+  }
+  for (; i < n; ++i)
+  {
+    sum += px[i] * px[i];
+  }
+  return sum;
+}
+
+inline float findRMS(const float* px, size_t n)
+{
+  if (!n) return 0.f;
+  return static_cast<float>(std::sqrt(sumOfSquares(px, n) / n));
+}
+
+inline void applyGain(float* px, size_t n, float gain)
+{
+  const SIMDVectorFloat vGain = vecSet1(gain);
+  size_t i = 0;
+  for (; i + kFloatsPerSIMDVector <= n; i += kFloatsPerSIMDVector)
+  {
+    vecStoreUnaligned(px + i, vecMul(vecLoadUnaligned(px + i), vGain));
+  }
+  for (; i < n; ++i)
+  {
+    px[i] *= gain;
+  }
+}
+
+// ----------------------------------------------------------------
+// channel extract and insert
+//
+// Copy one channel of interleaved frames to or from contiguous floats. Mono,
+// stereo and four channels use SIMD; other channel counts are strided copies.
+
+inline void extractChannel(const float* pSrc, size_t frames, size_t channels, size_t channel,
+                           float* pDest)
+{
+  size_t f = 0;
+  if (channels == 1)
+  {
+    std::copy(pSrc, pSrc + frames, pDest);
+    return;
+  }
+  else if (channels == 2)
+  {
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat a = vecLoadUnaligned(pSrc + f * 2);
+      SIMDVectorFloat b = vecLoadUnaligned(pSrc + f * 2 + kFloatsPerSIMDVector);
+      SIMDVectorFloat y = channel ? _mm_shuffle_ps(a, b, SHUFFLE(3, 1, 3, 1))
+                                  : _mm_shuffle_ps(a, b, SHUFFLE(2, 0, 2, 0));
+      vecStoreUnaligned(pDest + f, y);
+    }
+  }
+  else if (channels == 4)
+  {
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      const float* px = pSrc + f * 4;
+      SIMDVectorFloat r[4] = {vecLoadUnaligned(px), vecLoadUnaligned(px + 4),
+                              vecLoadUnaligned(px + 8), vecLoadUnaligned(px + 12)};
+      _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+      vecStoreUnaligned(pDest + f, r[channel]);
+    }
+  }
+
+  // remaining frames
+  for (; f < frames; ++f)
+  {
+    pDest[f] = pSrc[f * channels + channel];
+  }
+}
+
+inline void insertChannel(const float* pSrc, size_t frames, float* pDest, size_t channels,
+                          size_t channel)
+{
+  size_t f = 0;
+  if (channels == 1)
+  {
+    std::copy(pSrc, pSrc + frames, pDest);
+    return;
+  }
+  else if (channels == 2)
+  {
+    // blend the new channel into each pair of frames.
+    const SIMDVectorFloat vMask = channel ? VecI2F(_mm_set_epi32(-1, 0, -1, 0))
+                                          : VecI2F(_mm_set_epi32(0, -1, 0, -1));
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat x = vecLoadUnaligned(pSrc + f);
+      SIMDVectorFloat lo = _mm_unpacklo_ps(x, x);
+      SIMDVectorFloat hi = _mm_unpackhi_ps(x, x);
+      float* py = pDest + f * 2;
+      SIMDVectorFloat a = vecLoadUnaligned(py);
+      SIMDVectorFloat b = vecLoadUnaligned(py + kFloatsPerSIMDVector);
+      vecStoreUnaligned(py, vecOr(vecAnd(vMask, lo), _mm_andnot_ps(vMask, a)));
+      vecStoreUnaligned(py + kFloatsPerSIMDVector,
+                        vecOr(vecAnd(vMask, hi), _mm_andnot_ps(vMask, b)));
+    }
+  }
+  else if (channels == 4)
+  {
+    for (; f + kFloatsPerSIMDVector <= frames; f += kFloatsPerSIMDVector)
+    {
+      float* py = pDest + f * 4;
+      SIMDVectorFloat r[4] = {vecLoadUnaligned(py), vecLoadUnaligned(py + 4),
+                              vecLoadUnaligned(py + 8), vecLoadUnaligned(py + 12)};
+      _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+      r[channel] = vecLoadUnaligned(pSrc + f);
+      _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+      for (int j = 0; j < 4; ++j)
+      {
+        vecStoreUnaligned(py + j * 4, r[j]);
+      }
+    }
+  }
+
+  // remaining frames
+  for (; f < frames; ++f)
+  {
+    pDest[f * channels + channel] = pSrc[f];
+  }
+}
+
+// ----------------------------------------------------------------
+// Sample analysis and gain
+
 inline float findMaximumValue(const Sample& x)
 {
-  return *std::max_element(x.sampleData.begin(), x.sampleData.end());
+  return findMaximumValue(x.sampleData.data(), x.sampleData.size());
+}
+
+// the peak absolute value over all channels.
+inline float findPeak(const Sample& x)
+{
+  return findPeak(x.sampleData.data(), x.sampleData.size());
+}
+
+inline float findRMS(const Sample& x)
+{
+  return findRMS(x.sampleData.data(), x.sampleData.size());
 }
 
-inline void normalize(Sample& x)
+// per-channel analysis copies the channel a vector at a time into aligned
+// scratch, so the scans run on contiguous data.
+template <typename ScanFn>
+inline void scanChannel(const float* pData, size_t frames, size_t channels, size_t channel,
+                        ScanFn scanFn)
 {
-  if (x.sampleData.size() == 0) return;
-  float ratio = 1.0f / findMaximumValue(x);
-  for (int i = 0; i < x.sampleData.size(); ++i)
+  DSPVector scratch;
+  float* pScratch = scratch.getBuffer();
+  for (size_t f = 0; f < frames; f += kFloatsPerDSPVector)
   {
-    x.sampleData[i] *= ratio;
+    const size_t n = std::min(frames - f, size_t(kFloatsPerDSPVector));
+    extractChannel(pData + f * channels, n, channels, channel, pScratch);
+    scanFn(pScratch, n);
+  }
+}
+
+inline float findPeak(const Sample& x, size_t channel)
+{
+  float peak{0.f};
+  scanChannel(x.sampleData.data(), getFrames(x), x.channels, channel,
+              [&](const float* px, size_t n) { peak = std::max(peak, findPeak(px, n)); });
+  return peak;
+}
+
+inline float findRMS(const Sample& x, size_t channel)
+{
+  const size_t frames = getFrames(x);
+  if (!frames) return 0.f;
+  double sum{0.};
+  scanChannel(x.sampleData.data(), frames, x.channels, channel,
+              [&](const float* px, size_t n) { sum += sumOfSquares(px, n); });
+  return static_cast<float>(std::sqrt(sum / frames));
+}
+
+inline void applyGain(Sample& x, float gain)
+{
+  applyGain(x.sampleData.data(), x.sampleData.size(), gain);
+}
+
+// scale the Sample so that its peak absolute value is the given level. A
+// silent Sample is left alone.
+inline void normalize(Sample& x, float level = 1.f)
+{
+  const float peak = findPeak(x);
+  if (peak > 0.f)
+  {
+    applyGain(x, level / peak);
   }
 }
 
@@ -102,4 +366,320 @@ inline void clear(Sample& x)
   x.sampleData.clear();
 }
 
+inline void extractChannel(const Sample& x, size_t channel, float* pDest)
+{
+  extractChannel(x.sampleData.data(), getFrames(x), x.channels, channel, pDest);
+}
+
+inline void insertChannel(const float* pSrc, Sample& x, size_t channel)
+{
+  insertChannel(pSrc, getFrames(x), x.sampleData.data(), x.channels, channel);
+}
+
+// ----------------------------------------------------------------
+// frame load and store
+//
+// Move a DSPVector's worth of frames between interleaved Sample data and a
+// DSPVectorArray, with one row per channel. loadFrames() reads channel
+// c % channels into row c, so a mono Sample fills every row, and frames past
+// the end read as 0. storeFrames() writes the rows that have a channel, and
+// only the frames inside the Sample.
+
+template <size_t CHANNELS>
+inline DSPVectorArray<CHANNELS> loadFrames(const float* pData, size_t frames, size_t channels,
+                                           size_t startFrame)
+{
+  DSPVectorArray<CHANNELS> y;
+  if (!channels || startFrame >= frames) return y;
+  const size_t n = std::min(frames - startFrame, size_t(kFloatsPerDSPVector));
+  const float* pSrc = pData + startFrame * channels;
+  if (channels == CHANNELS)
+  {
+    float* rows[CHANNELS];
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      rows[c] = y.getRowData(c);
+    }
+    deinterleave(pSrc, channels, rows, n);
+  }
+  else
+  {
+    for (size_t c = 0; c < std::min(channels, CHANNELS); ++c)
+    {
+      extractChannel(pSrc, n, channels, c, y.getRowData(c));
+    }
+    for (size_t c = channels; c < CHANNELS; ++c)
+    {
+      const float* pRow = y.getRowDataConst(c % channels);
+      std::copy(pRow, pRow + kFloatsPerDSPVector, y.getRowData(c));
+    }
+  }
+  return y;
+}
+
+template <size_t CHANNELS>
+inline DSPVectorArray<CHANNELS> loadFrames(const Sample& s, size_t startFrame)
+{
+  return loadFrames<CHANNELS>(s.sampleData.data(), getFrames(s), s.channels, startFrame);
+}
+
+template <size_t CHANNELS>
+inline DSPVectorArray<CHANNELS> loadFrames(const SampleView& v, size_t startFrame)
+{
+  return loadFrames<CHANNELS>(v.data, v.frames, v.channels, startFrame);
+}
+
+template <size_t CHANNELS>
+inline void storeFrames(const DSPVectorArray<CHANNELS>& x, Sample& s, size_t startFrame)
+{
+  const size_t frames = getFrames(s);
+  if (startFrame >= frames) return;
+  const size_t n = std::min(frames - startFrame, size_t(kFloatsPerDSPVector));
+  float* pDest = getFramePtr(s, startFrame);
+  if (s.channels == CHANNELS)
+  {
+    const float* rows[CHANNELS];
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      rows[c] = x.getRowDataConst(c);
+    }
+    interleave(rows, CHANNELS, pDest, n);
+  }
+  else
+  {
+    for (size_t c = 0; c < std::min(s.channels, CHANNELS); ++c)
+    {
+      insertChannel(x.getRowDataConst(c), n, pDest, s.channels, c);
+    }
+  }
+}
+
+// ----------------------------------------------------------------
+// interpolated reads
+//
+// These read one channel of interleaved sample data at the frame positions
+// startFrame + offsets[i]. Keeping the integer start separate from the offsets
+// keeps the positions precise in long samples. Frames outside the data read as 0.
+
+// split each offset into its floor and fractional part.
+inline void splitOffsets(const DSPVector& offsets, int32_t* pIntParts, float* pFracParts)
+{
+  const float* px = offsets.getConstBuffer();
+  for (int i = 0; i < kSIMDVectorsPerDSPVector; ++i)
+  {
+    SIMDVectorFloat x = vecLoad(px);
+    SIMDVectorInt xi = vecFloatToIntTruncate(x);
+    SIMDVectorFloat xf = vecIntToFloat(xi);
+
+    // truncation rounds negative numbers up, so correct to floor.
+    SIMDVectorFloat roundedUp = vecGreaterThan(xf, x);
+    xi = vecAddInt(xi, VecF2I(roundedUp));
+    xf = vecSub(xf, vecAnd(roundedUp, vecSet1(1.f)));
+
+    _mm_storeu_si128(reinterpret_cast<SIMDVectorInt*>(pIntParts), xi);
+    vecStoreUnaligned(pFracParts, vecSub(x, xf));
+    px += kFloatsPerSIMDVector;
+    pIntParts += kIntsPerSIMDVector;
+    pFracParts += kFloatsPerSIMDVector;
+  }
+}
+
+// gather the frames at startFrame + pIntParts[i] + tap into pDest.
+inline void gatherFrames(const float* pData, size_t frames, size_t channels, size_t channel,
+                         int64_t startFrame, const int32_t* pIntParts, int tap, float* pDest)
+{
+  const int32_t* pMin = std::min_element(pIntParts, pIntParts + kFloatsPerDSPVector);
+  const int32_t* pMax = std::max_element(pIntParts, pIntParts + kFloatsPerDSPVector);
+  const int64_t first = startFrame + *pMin + tap;
+  const int64_t last = startFrame + *pMax + tap;
+  const float* pChannel = pData + channel;
+  if ((first >= 0) && (last < static_cast<int64_t>(frames)))
+  {
+    const float* pStart = pChannel + (startFrame + tap) * static_cast<int64_t>(channels);
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      pDest[i] = pStart[pIntParts[i] * static_cast<int64_t>(channels)];
+    }
+  }
+  else
+  {
+    for (int i = 0; i < kFloatsPerDSPVector; ++i)
+    {
+      int64_t frame = startFrame + pIntParts[i] + tap;
+      bool inside = (frame >= 0) && (frame < static_cast<int64_t>(frames));
+      pDest[i] = inside ? pChannel[frame * static_cast<int64_t>(channels)] : 0.f;
+    }
+  }
+}
+
+inline DSPVector readLinear(const float* pData, size_t frames, size_t channels, size_t channel,
+                            int64_t startFrame, const DSPVector& offsets)
+{
+  alignas(16) int32_t intParts[kFloatsPerDSPVector];
+  DSPVector fracParts, x0, x1;
+  splitOffsets(offsets, intParts, fracParts.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, 0, x0.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, 1, x1.getBuffer());
+  return x0 + fracParts * (x1 - x0);
+}
+
+inline DSPVector readLinear(const Sample& s, size_t channel, int64_t startFrame,
+                            const DSPVector& offsets)
+{
+  return readLinear(s.sampleData.data(), getFrames(s), s.channels, channel, startFrame, offsets);
+}
+
+inline DSPVector readLinear(const SampleView& v, size_t channel, int64_t startFrame,
+                            const DSPVector& offsets)
+{
+  return readLinear(v.data, v.frames, v.channels, channel, startFrame, offsets);
+}
+
+// 4-point, 3rd-order Hermite interpolation, as in herp().
+inline DSPVector readHermite(const float* pData, size_t frames, size_t channels, size_t channel,
+                             int64_t startFrame, const DSPVector& offsets)
+{
+  alignas(16) int32_t intParts[kFloatsPerDSPVector];
+  DSPVector f, t0, t1, t2, t3;
+  splitOffsets(offsets, intParts, f.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, -1, t0.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, 0, t1.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, 1, t2.getBuffer());
+  gatherFrames(pData, frames, channels, channel, startFrame, intParts, 2, t3.getBuffer());
+  DSPVector c = (t2 - t0) * DSPVector(0.5f);
+  DSPVector v = t1 - t2;
+  DSPVector w = c + v;
+  DSPVector a = w + v + (t3 - t1) * DSPVector(0.5f);
+  DSPVector b = w + a;
+  return (((a * f) - b) * f + c) * f + t1;
+}
+
+inline DSPVector readHermite(const Sample& s, size_t channel, int64_t startFrame,
+                             const DSPVector& offsets)
+{
+  return readHermite(s.sampleData.data(), getFrames(s), s.channels, channel, startFrame, offsets);
+}
+
+inline DSPVector readHermite(const SampleView& v, size_t channel, int64_t startFrame,
+                             const DSPVector& offsets)
+{
+  return readHermite(v.data, v.frames, v.channels, channel, startFrame, offsets);
+}
+
+// Windowed sinc interpolation from a polyphase table. The kernel has
+// kSincTaps taps, and kernels for offsets between table phases are linearly
+// interpolated. The cutoff is fixed, so transposing up by more than a few
+// semitones will alias.
+struct SincTable
+{
+  static constexpr int kSincTaps{8};
+  static constexpr int kSincPhases{256};
+  alignas(16) std::array<float, (kSincPhases + 1) * kSincTaps> data;
+
+  SincTable()
+  {
+    // a sinc with a cutoff just under sr / 2 in a blackman window. Row p is the
+    // kernel for a fractional offset of p / kSincPhases, with taps for frames
+    // -3 through 4, normalized to unity gain at DC.
+    constexpr float kCutoff{0.45f};
+    for (int p = 0; p <= kSincPhases; ++p)
+    {
+      float* row = data.data() + p * kSincTaps;
+      float sum{0.f};
+      for (int j = 0; j < kSincTaps; ++j)
+      {
+        float x = (j - kSincTaps / 2 + 1) - static_cast<float>(p) / kSincPhases;
+        float pi_x = kTwoPi * kCutoff * x;
+        float sinc = (x == 0.f) ? 1.f : sinf(pi_x) / pi_x;
+        float window = 0.42f + 0.5f * cosf(kTwoPi * x / kSincTaps) +
+                       0.08f * cosf(2.f * kTwoPi * x / kSincTaps);
+        row[j] = sinc * window;
+        sum += row[j];
+      }
+      for (int j = 0; j < kSincTaps; ++j)
+      {
+        row[j] /= sum;
+      }
+    }
+  }
+};
+
+// one table is shared by all readers.
+inline const SincTable& getSincTable()
+{
+  static const SincTable table;
+  return table;
+}
+
+inline DSPVector readSinc(const float* pData, size_t frames, size_t channels, size_t channel,
+                          int64_t startFrame, const DSPVector& offsets)
+{
+  constexpr int kTaps{SincTable::kSincTaps};
+  constexpr int kFirstTap{1 - kTaps / 2};
+  const SincTable& table = getSincTable();
+  alignas(16) int32_t intParts[kFloatsPerDSPVector];
+  alignas(16) float taps[kTaps];
+  DSPVector fracParts;
+  splitOffsets(offsets, intParts, fracParts.getBuffer());
+
+  const int32_t* pMin = std::min_element(intParts, intParts + kFloatsPerDSPVector);
+  const int32_t* pMax = std::max_element(intParts, intParts + kFloatsPerDSPVector);
+  const bool inside = (startFrame + *pMin + kFirstTap >= 0) &&
+                      (startFrame + *pMax + kFirstTap + kTaps <= static_cast<int64_t>(frames));
+  const bool contiguous = inside && (channels == 1);
+  const float* pChannel = pData + channel;
+
+  DSPVector vy;
+  float* py = vy.getBuffer();
+  for (int i = 0; i < kFloatsPerDSPVector; ++i)
+  {
+    // interpolate the kernel between the two nearest phases.
+    float p = fracParts[i] * SincTable::kSincPhases;
+    int ip = min(static_cast<int>(p), SincTable::kSincPhases - 1);
+    SIMDVectorFloat vFrac = vecSet1(p - ip);
+    const float* pk0 = table.data.data() + ip * kTaps;
+    const float* pk1 = pk0 + kTaps;
+
+    // get the taps.
+    const int64_t firstFrame = startFrame + intParts[i] + kFirstTap;
+    const float* pTaps;
+    if (contiguous)
+    {
+      pTaps = pChannel + firstFrame;
+    }
+    else
+    {
+      for (int j = 0; j < kTaps; ++j)
+      {
+        int64_t frame = firstFrame + j;
+        bool valid = inside || ((frame >= 0) && (frame < static_cast<int64_t>(frames)));
+        taps[j] = valid ? pChannel[frame * static_cast<int64_t>(channels)] : 0.f;
+      }
+      pTaps = taps;
+    }
+
+    SIMDVectorFloat sum = vecZeros();
+    for (int j = 0; j < kTaps; j += kFloatsPerSIMDVector)
+    {
+      SIMDVectorFloat k0 = vecLoad(pk0 + j);
+      SIMDVectorFloat k = vecAdd(k0, vecMul(vFrac, vecSub(vecLoad(pk1 + j), k0)));
+      sum = vecAdd(sum, vecMul(k, vecLoadUnaligned(pTaps + j)));
+    }
+    py[i] = vecSumH(sum);
+  }
+  return vy;
+}
+
+inline DSPVector readSinc(const Sample& s, size_t channel, int64_t startFrame,
+                          const DSPVector& offsets)
+{
+  return readSinc(s.sampleData.data(), getFrames(s), s.channels, channel, startFrame, offsets);
+}
+
+inline DSPVector readSinc(const SampleView& v, size_t channel, int64_t startFrame,
+                          const DSPVector& offsets)
+{
+  return readSinc(v.data, v.frames, v.channels, channel, startFrame, offsets);
+}
+
 }  // namespace ml
@@ -0,0 +1,287 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// conversions between floats and the sample formats stored in audio files.
+//
+// Integers are scaled so that full scale is [-1, 1), and floats are clamped to
+// that range when converted to integers. The bigEndian flags give the byte
+// order of the file data. The host is assumed to be little-endian. 16-bit,
+// 32-bit and float samples are converted four or eight at a time with SSE2.
+// SSE2 has no byte shuffle, so 24-bit samples are assembled one at a time.
+
+#pragma once
+
+#include <cstring>
+
+#include "MLDSPOps.h"
+
+namespace ml
+{
+enum SampleFormat
+{
+  kInt16 = 0,
+  kInt24,
+  kInt32,
+  kFloat32
+};
+
+inline size_t getBytesPerSample(SampleFormat format)
+{
+  constexpr size_t kBytes[4]{2, 3, 4, 4};
+  return kBytes[format];
+}
+
+namespace sampleformat
+{
+constexpr float kInt16Scale{1.f / 32768.f};
+constexpr float kInt24Scale{1.f / 8388608.f};
+constexpr float kInt32Scale{1.f / 2147483648.f};
+
+// the largest float below 1, which still converts to a valid 32-bit int.
+constexpr float kMaxBelowOne{0.99999994f};
+
+inline SIMDVectorInt byteSwap16(SIMDVectorInt x)
+{
+  return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+inline SIMDVectorInt byteSwap32(SIMDVectorInt x)
+{
+  x = byteSwap16(x);
+  return _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+}
+
+inline uint32_t byteSwap32(uint32_t x)
+{
+  return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+inline SIMDVectorInt loadInts(const uint8_t* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const SIMDVectorInt*>(p));
+}
+
+inline void storeInts(uint8_t* p, SIMDVectorInt x)
+{
+  _mm_storeu_si128(reinterpret_cast<SIMDVectorInt*>(p), x);
+}
+
+// read and write single samples.
+
+inline float readInt16(const uint8_t* p, bool bigEndian)
+{
+  int16_t x = bigEndian ? static_cast<int16_t>((p[0] << 8) | p[1])
+                        : static_cast<int16_t>(p[0] | (p[1] << 8));
+  return x * kInt16Scale;
+}
+
+inline float readInt24(const uint8_t* p, bool bigEndian)
+{
+  // assemble into the top bytes of an int, then shift back down with sign.
+  uint32_t u = bigEndian ? ((p[0] << 24) | (p[1] << 16) | (p[2] << 8))
+                         : ((p[2] << 24) | (p[1] << 16) | (p[0] << 8));
+  return (static_cast<int32_t>(u) >> 8) * kInt24Scale;
+}
+
+inline float readInt32(const uint8_t* p, bool bigEndian)
+{
+  uint32_t u;
+  std::memcpy(&u, p, 4);
+  if (bigEndian) u = byteSwap32(u);
+  return static_cast<int32_t>(u) * kInt32Scale;
+}
+
+inline float readFloat32(const uint8_t* p, bool bigEndian)
+{
+  uint32_t u;
+  std::memcpy(&u, p, 4);
+  if (bigEndian) u = byteSwap32(u);
+  float f;
+  std::memcpy(&f, &u, 4);
+  return f;
+}
+
+inline void writeInt16(uint8_t* p, float x, bool bigEndian)
+{
+  int32_t i = static_cast<int32_t>(lrintf(ml::clamp(x, -1.f, 1.f) * 32768.f));
+  uint16_t u = static_cast<uint16_t>(ml::clamp(i, -32768, 32767));
+  p[bigEndian ? 1 : 0] = u & 0xFF;
+  p[bigEndian ? 0 : 1] = u >> 8;
+}
+
+inline void writeInt24(uint8_t* p, float x, bool bigEndian)
+{
+  int32_t i = static_cast<int32_t>(lrintf(ml::clamp(x, -1.f, 1.f) * 8388608.f));
+  uint32_t u = static_cast<uint32_t>(ml::clamp(i, -8388608, 8388607));
+  p[bigEndian ? 2 : 0] = u & 0xFF;
+  p[1] = (u >> 8) & 0xFF;
+  p[bigEndian ? 0 : 2] = (u >> 16) & 0xFF;
+}
+
+inline void writeInt32(uint8_t* p, float x, bool bigEndian)
+{
+  uint32_t u = static_cast<uint32_t>(
+      static_cast<int32_t>(lrintf(ml::clamp(x, -1.f, kMaxBelowOne) * 2147483648.f)));
+  if (bigEndian) u = byteSwap32(u);
+  std::memcpy(p, &u, 4);
+}
+
+inline void writeFloat32(uint8_t* p, float x, bool bigEndian)
+{
+  uint32_t u;
+  std::memcpy(&u, &x, 4);
+  if (bigEndian) u = byteSwap32(u);
+  std::memcpy(p, &u, 4);
+}
+}  // namespace sampleformat
+
+// convert n samples in the given format to floats.
+inline void convertToFloat(const uint8_t* pSrc, float* pDest, size_t samples, SampleFormat format,
+                           bool bigEndian)
+{
+  using namespace sampleformat;
+  size_t i = 0;
+  switch (format)
+  {
+    case kInt16:
+    {
+      const SIMDVectorFloat scale = vecSet1(kInt16Scale);
+      for (; i + 8 <= samples; i += 8)
+      {
+        SIMDVectorInt x = loadInts(pSrc + i * 2);
+        if (bigEndian) x = byteSwap16(x);
+
+        // unpacking a vector with itself puts each sample in the top half of an
+        // int, then the arithmetic shift extends its sign.
+        SIMDVectorInt lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        SIMDVectorInt hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        vecStoreUnaligned(pDest + i, vecMul(vecIntToFloat(lo), scale));
+        vecStoreUnaligned(pDest + i + 4, vecMul(vecIntToFloat(hi), scale));
+      }
+      for (; i < samples; ++i)
+      {
+        pDest[i] = readInt16(pSrc + i * 2, bigEndian);
+      }
+      break;
+    }
+    case kInt24:
+    {
+      for (; i < samples; ++i)
+      {
+        pDest[i] = readInt24(pSrc + i * 3, bigEndian);
+      }
+      break;
+    }
+    case kInt32:
+    {
+      const SIMDVectorFloat scale = vecSet1(kInt32Scale);
+      for (; i + 4 <= samples; i += 4)
+      {
+        SIMDVectorInt x = loadInts(pSrc + i * 4);
+        if (bigEndian) x = byteSwap32(x);
+        vecStoreUnaligned(pDest + i, vecMul(vecIntToFloat(x), scale));
+      }
+      for (; i < samples; ++i)
+      {
+        pDest[i] = readInt32(pSrc + i * 4, bigEndian);
+      }
+      break;
+    }
+    case kFloat32:
+    {
+      if (!bigEndian)
+      {
+        std::memcpy(pDest, pSrc, samples * 4);
+        break;
+      }
+      for (; i + 4 <= samples; i += 4)
+      {
+        vecStoreUnaligned(pDest + i, VecI2F(byteSwap32(loadInts(pSrc + i * 4))));
+      }
+      for (; i < samples; ++i)
+      {
+        pDest[i] = readFloat32(pSrc + i * 4, bigEndian);
+      }
+      break;
+    }
+  }
+}
+
+// convert n floats to samples in the given format.
+inline void convertFromFloat(const float* pSrc, uint8_t* pDest, size_t samples,
+                             SampleFormat format, bool bigEndian)
+{
+  using namespace sampleformat;
+  size_t i = 0;
+  switch (format)
+  {
+    case kInt16:
+    {
+      // packing saturates +1 to the int16 maximum.
+      const SIMDVectorFloat scale = vecSet1(32768.f);
+      const SIMDVectorFloat lower = vecSet1(-1.f);
+      const SIMDVectorFloat upper = vecSet1(1.f);
+      for (; i + 8 <= samples; i += 8)
+      {
+        SIMDVectorFloat x0 = vecClamp(vecLoadUnaligned(pSrc + i), lower, upper);
+        SIMDVectorFloat x1 = vecClamp(vecLoadUnaligned(pSrc + i + 4), lower, upper);
+        SIMDVectorInt lo = vecFloatToIntRound(vecMul(x0, scale));
+        SIMDVectorInt hi = vecFloatToIntRound(vecMul(x1, scale));
+        SIMDVectorInt x = _mm_packs_epi32(lo, hi);
+        if (bigEndian) x = byteSwap16(x);
+        storeInts(pDest + i * 2, x);
+      }
+      for (; i < samples; ++i)
+      {
+        writeInt16(pDest + i * 2, pSrc[i], bigEndian);
+      }
+      break;
+    }
+    case kInt24:
+    {
+      for (; i < samples; ++i)
+      {
+        writeInt24(pDest + i * 3, pSrc[i], bigEndian);
+      }
+      break;
+    }
+    case kInt32:
+    {
+      const SIMDVectorFloat scale = vecSet1(2147483648.f);
+      const SIMDVectorFloat lower = vecSet1(-1.f);
+      const SIMDVectorFloat upper = vecSet1(kMaxBelowOne);
+      for (; i + 4 <= samples; i += 4)
+      {
+        SIMDVectorFloat x = vecClamp(vecLoadUnaligned(pSrc + i), lower, upper);
+        SIMDVectorInt xi = vecFloatToIntRound(vecMul(x, scale));
+        if (bigEndian) xi = byteSwap32(xi);
+        storeInts(pDest + i * 4, xi);
+      }
+      for (; i < samples; ++i)
+      {
+        writeInt32(pDest + i * 4, pSrc[i], bigEndian);
+      }
+      break;
+    }
+    case kFloat32:
+    {
+      if (!bigEndian)
+      {
+        std::memcpy(pDest, pSrc, samples * 4);
+        break;
+      }
+      for (; i + 4 <= samples; i += 4)
+      {
+        storeInts(pDest + i * 4, byteSwap32(VecF2I(vecLoadUnaligned(pSrc + i))));
+      }
+      for (; i < samples; ++i)
+      {
+        writeFloat32(pDest + i * 4, pSrc[i], bigEndian);
+      }
+      break;
+    }
+  }
+}
+
+}  // namespace ml
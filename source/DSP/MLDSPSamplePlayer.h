@@ -0,0 +1,289 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// SamplePlayer: plays a Sample or SampleView at a pitch ratio that can change every
+// sample, with a choice of linear, Hermite or windowed sinc interpolation and
+// an optional forward loop with a crossfade.
+//
+// The read position is kept as a double and each vector is read as an integer
+// start frame plus float offsets, so long samples play back precisely. The
+// offsets are computed once per vector and shared by all channels.
+//
+// SamplerBank runs a number of players and mixes them to CHANNELS outputs.
+// The interpolation tables are static, so any number of players share them.
+
+#pragma once
+
+#include "MLDSPOps.h"
+#include "MLDSPSample.h"
+
+namespace ml
+{
+// write the running sum of the rate input, not including the current sample,
+// plus the start offset, to pOffsets. Returns the sum of all the rates.
+inline float accumulateOffsets(const DSPVector& rate, float start, float* pOffsets)
+{
+  const float* px = rate.getConstBuffer();
+  SIMDVectorFloat vSum = vecSet1(start);
+  for (int i = 0; i < kSIMDVectorsPerDSPVector; ++i)
+  {
+    // exclusive prefix sum of the rates, added to the previous sum
+    SIMDVectorFloat x = vecLoad(px);
+    SIMDVectorFloat sum = vecAdd(x, VecI2F(_mm_slli_si128(VecF2I(x), 4)));
+    sum = vecAdd(sum, VecI2F(_mm_slli_si128(VecF2I(sum), 8)));
+    vecStore(pOffsets, vecAdd(vSum, vecSub(sum, x)));
+    vSum = vecAdd(vSum, _mm_shuffle_ps(sum, sum, SHUFFLE(3, 3, 3, 3)));
+    px += kFloatsPerSIMDVector;
+    pOffsets += kFloatsPerSIMDVector;
+  }
+  return _mm_cvtss_f32(vSum) - start;
+}
+
+template <size_t CHANNELS = 1>
+class SamplePlayer
+{
+ public:
+  enum Interpolation
+  {
+    kLinear = 0,
+    kHermite,
+    kSinc
+  };
+
+ private:
+  SampleView _source;
+  Interpolation _interpolation{kHermite};
+  double _position{0.};
+  bool _playing{false};
+
+  // loop in frames. _loopEnd is exclusive, and 0 means no loop.
+  int64_t _loopStart{0};
+  int64_t _loopEnd{0};
+  int64_t _crossfade{0};
+
+  DSPVector read(const SampleView& src, size_t channel, int64_t startFrame,
+                 const DSPVector& offsets) const
+  {
+    switch (_interpolation)
+    {
+      case kLinear:
+        return readLinear(src, channel, startFrame, offsets);
+      case kHermite:
+        return readHermite(src, channel, startFrame, offsets);
+      case kSinc:
+      default:
+        return readSinc(src, channel, startFrame, offsets);
+    }
+  }
+
+  // read all channels of the loop segment starting at base into the rows of
+  // vy where mask is set, crossfading with the frames one loop length earlier
+  // in the last _crossfade frames of the loop.
+  void readLoopSegment(const SampleView& src, int64_t base, const DSPVector& offsets,
+                       const DSPVector& mask, DSPVectorArray<CHANNELS>& vy) const
+  {
+    const int64_t loopLength = _loopEnd - _loopStart;
+    bool fading{false};
+    DSPVector fade;
+    if (_crossfade > 0)
+    {
+      const float fadeStart = static_cast<float>(_loopEnd - _crossfade - base);
+      fade = clamp((offsets - DSPVector(fadeStart)) * DSPVector(1.f / _crossfade), DSPVector(0.f),
+                   DSPVector(1.f)) *
+             mask;
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        fading |= (fade[i] > 0.f);
+      }
+    }
+
+    for (int c = 0; c < CHANNELS; ++c)
+    {
+      const size_t channel = c % src.channels;
+      DSPVector x = read(src, channel, base, offsets);
+      if (fading)
+      {
+        DSPVector xPre = read(src, channel, base - loopLength, offsets);
+        x += fade * (xPre - x);
+      }
+      DSPVector y = vy.constRow(c) + x * mask;
+      std::copy(y.getConstBuffer(), y.getConstBuffer() + kFloatsPerDSPVector, vy.getRowData(c));
+    }
+  }
+
+ public:
+  // set the data to play, which must stay valid while playing.
+  void setSample(const SampleView& source)
+  {
+    _source = source;
+    _playing = false;
+  }
+
+  void setSample(const Sample* pSample) { setSample(pSample ? getView(*pSample) : SampleView{}); }
+
+  void setInterpolation(Interpolation i) { _interpolation = i; }
+
+  // set a loop from startFrame up to but not including endFrame. The last
+  // crossfadeFrames of the loop are faded into the frames before the loop
+  // start, so the crossfade is limited to startFrame. Loops only play forwards:
+  // with a negative pitch ratio, playback runs back through the loop start.
+  void setLoop(size_t startFrame, size_t endFrame, size_t crossfadeFrames = 0)
+  {
+    if (endFrame > startFrame)
+    {
+      _loopStart = startFrame;
+      _loopEnd = endFrame;
+      _crossfade = min(crossfadeFrames, min(startFrame, endFrame - startFrame));
+    }
+    else
+    {
+      clearLoop();
+    }
+  }
+
+  void clearLoop()
+  {
+    _loopStart = _loopEnd = _crossfade = 0;
+  }
+
+  bool isLooping() const { return _loopEnd > 0; }
+
+  // start playing from the given frame.
+  void trigger(double startFrame = 0.)
+  {
+    _position = startFrame;
+    _playing = usable(_source);
+  }
+
+  void stop() { _playing = false; }
+
+  bool isPlaying() const { return _playing; }
+  double getPosition() const { return _position; }
+
+  // pitchRatio: playback rate in source frames per sample. May be negative.
+  DSPVectorArray<CHANNELS> operator()(const DSPVector pitchRatio)
+  {
+    DSPVectorArray<CHANNELS> vy;
+    if (!_playing) return vy;
+
+    const SampleView& src = _source;
+    const int64_t frames = src.frames;
+    const int64_t startFrame = static_cast<int64_t>(std::floor(_position));
+    const float startFrac = static_cast<float>(_position - startFrame);
+    DSPVector offsets;
+    const float advance = accumulateOffsets(pitchRatio, startFrac, offsets.getBuffer());
+    const double endPosition = _position + advance;
+
+    if (isLooping() && (max(_position, endPosition) >= _loopEnd - _crossfade))
+    {
+      // count the loop wraps before each sample, then read the frames for each
+      // number of wraps as a separate segment.
+      const int64_t loopLength = _loopEnd - _loopStart;
+      const float loopEndOffset = static_cast<float>(_loopEnd - startFrame);
+      int wraps[kFloatsPerDSPVector];
+      int maxWraps{0};
+      for (int i = 0; i < kFloatsPerDSPVector; ++i)
+      {
+        const float pastEnd = offsets[i] - loopEndOffset;
+        wraps[i] = (pastEnd >= 0.f) ? 1 + static_cast<int>(pastEnd / loopLength) : 0;
+        maxWraps = max(maxWraps, wraps[i]);
+      }
+      for (int k = 0; k <= maxWraps; ++k)
+      {
+        DSPVector mask;
+        for (int i = 0; i < kFloatsPerDSPVector; ++i)
+        {
+          mask[i] = (wraps[i] == k) ? 1.f : 0.f;
+        }
+        readLoopSegment(src, startFrame - k * loopLength, offsets, mask, vy);
+      }
+    }
+    else
+    {
+      for (int c = 0; c < CHANNELS; ++c)
+      {
+        DSPVector x = read(src, c % src.channels, startFrame, offsets);
+        std::copy(x.getConstBuffer(), x.getConstBuffer() + kFloatsPerDSPVector,
+                  vy.getRowData(c));
+      }
+    }
+
+    // advance, wrapping into the loop or stopping when either end of the
+    // sample has been played, including the interpolator's tail. Playing
+    // backwards, a looping voice stops at the start like any other.
+    _position = endPosition;
+    if (isLooping() && (_position >= _loopEnd))
+    {
+      _position = _loopStart + std::fmod(_position - _loopStart, double(_loopEnd - _loopStart));
+    }
+    if ((_position >= frames + SincTable::kSincTaps) || (_position < -SincTable::kSincTaps))
+    {
+      _playing = false;
+    }
+    return vy;
+  }
+};
+
+// a bank of SamplePlayers mixed to CHANNELS outputs.
+template <size_t VOICES, size_t CHANNELS = 1>
+class SamplerBank
+{
+  std::array<SamplePlayer<CHANNELS>, VOICES> _players;
+
+ public:
+  SamplePlayer<CHANNELS>& operator[](size_t n) { return _players[n]; }
+  const SamplePlayer<CHANNELS>& operator[](size_t n) const { return _players[n]; }
+
+  void setInterpolation(typename SamplePlayer<CHANNELS>::Interpolation i)
+  {
+    for (auto& p : _players)
+    {
+      p.setInterpolation(i);
+    }
+  }
+
+  void stop()
+  {
+    for (auto& p : _players)
+    {
+      p.stop();
+    }
+  }
+
+  size_t getPlayingVoices() const
+  {
+    size_t n{0};
+    for (const auto& p : _players)
+    {
+      n += p.isPlaying();
+    }
+    return n;
+  }
+
+  // pitchRatios: the pitch ratio for each voice. gains: the output gain for
+  // each voice. Voices that are not playing are skipped.
+  DSPVectorArray<CHANNELS> operator()(const DSPVectorArray<VOICES>& pitchRatios,
+                                      const DSPVectorArray<VOICES>& gains)
+  {
+    DSPVectorArray<CHANNELS> vy;
+    for (int v = 0; v < VOICES; ++v)
+    {
+      if (!_players[v].isPlaying()) continue;
+      DSPVectorArray<CHANNELS> x = _players[v](pitchRatios.constRow(v));
+      const float* pg = gains.getRowDataConst(v);
+      for (int c = 0; c < CHANNELS; ++c)
+      {
+        float* py = vy.getRowData(c);
+        const float* px = x.getRowDataConst(c);
+        for (int i = 0; i < kFloatsPerDSPVector; i += kFloatsPerSIMDVector)
+        {
+          vecStore(py + i, vecAdd(vecLoad(py + i), vecMul(vecLoad(px + i), vecLoad(pg + i))));
+        }
+      }
+    }
+    return vy;
+  }
+};
+
+}  // namespace ml
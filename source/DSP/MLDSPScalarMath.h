@@ -13,6 +13,10 @@
 
 #include <limits>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #ifdef WIN32
 #undef min
 #undef max
@@ -129,6 +133,18 @@ inline int ilog2(int x)
   return b;
 }
 
+// return the index of the lowest set bit in x, which must not be 0.
+inline int countTrailingZeros(uint64_t x)
+{
+#if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return static_cast<int>(i);
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
 inline int isNaN(float x) { return std::isnan(x); }
 
 inline int isNaN(double x) { return std::isnan(x); }
@@ -49,6 +49,11 @@ const Projection flatTop(
 // VectorProcessBuffer: utility class to serve a main loop with varying
 // arbitrary chunk sizes, buffer inputs and outputs, and compute DSP in
 // DSPVector-sized chunks.
+//
+// When the host's buffers are aligned and distinct, whole DSPVectors are
+// processed in place in the host's buffers. Each output vector is written
+// after any frames still buffered from earlier blocks, so only frames at the
+// ends of a block go through the buffers.
 
 using MainInputs = const DSPVectorDynamic&;
 using MainOutputs = DSPVectorDynamic&;
@@ -58,71 +63,181 @@ class VectorProcessBuffer
 {
   DSPVectorDynamic _inputVectors;
   DSPVectorDynamic _outputVectors;
-  std::vector<ml::DSPBuffer> _inputBuffers;
-  std::vector<ml::DSPBuffer> _outputBuffers;
+  MultiChannelDSPBuffer _inputBuffer;
+  MultiChannelDSPBuffer _outputBuffer;
+  std::vector<const float*> _inputPtrs;
+  std::vector<float*> _outputPtrs;
   size_t _maxFrames;
+  size_t _latency{0};
 
- public:
-  VectorProcessBuffer(size_t inputs, size_t outputs, size_t maxFrames)
-      : _inputVectors(inputs), _outputVectors(outputs), _maxFrames(maxFrames)
+  static bool isAligned(const void* p)
+  {
+    return p && !(reinterpret_cast<uintptr_t>(p) & (sizeof(SIMDVectorFloat) - 1));
+  }
+
+  // if whole vectors can be processed in place, set the frames of the host's
+  // inputs and outputs at which the first in-place vector starts and return
+  // true. Input frames before inStart complete any partly buffered vector,
+  // and output frames before outStart are read from the output buffer.
+  bool getInPlaceStart(const float** inputs, float** outputs, size_t nFrames, size_t& inStart,
+                       size_t& outStart) const
   {
-    _inputBuffers.resize(inputs);
-    for (int i = 0; i < inputs; ++i)
+    const size_t inBuffered = _inputBuffer.getReadAvailable();
+    const size_t outBuffered = _outputBuffer.getReadAvailable();
+    if (inBuffered && !inputs) return false;
+
+    const size_t inFrame =
+        (kFloatsPerDSPVector - inBuffered % kFloatsPerDSPVector) % kFloatsPerDSPVector;
+    const size_t outFrame = outBuffered + inBuffered + inFrame;
+    if (outFrame + kFloatsPerDSPVector > nFrames) return false;
+
+    for (size_t o = 0; o < _outputVectors.size(); ++o)
+    {
+      if (!isAligned(outputs[o] ? outputs[o] + outFrame : nullptr)) return false;
+    }
+    if (inputs)
     {
-      _inputBuffers[i].resize((int)_maxFrames);
+      for (size_t i = 0; i < _inputVectors.size(); ++i)
+      {
+        if (!isAligned(inputs[i] ? inputs[i] + inFrame : nullptr)) return false;
+
+        // processFn may write an output before reading an input.
+        for (size_t o = 0; o < _outputVectors.size(); ++o)
+        {
+          if (inputs[i] == outputs[o]) return false;
+        }
+      }
     }
+    inStart = inFrame;
+    outStart = outFrame;
+    return true;
+  }
 
-    _outputBuffers.resize(outputs);
-    for (int i = 0; i < outputs; ++i)
+  // write frames of the inputs starting at startFrame to the input buffer.
+  // Missing inputs are written as silence.
+  void bufferInputs(const float** inputs, size_t startFrame, size_t frames)
+  {
+    for (size_t c = 0; c < _inputVectors.size(); c++)
     {
-      _outputBuffers[i].resize((int)_maxFrames);
+      _inputPtrs[c] = inputs[c] ? inputs[c] + startFrame : nullptr;
     }
+    _inputBuffer.write(_inputPtrs.data(), frames);
+  }
+
+ public:
+  VectorProcessBuffer(size_t inputs, size_t outputs, size_t maxFrames)
+      : _inputVectors(inputs),
+        _outputVectors(outputs),
+        _inputPtrs(inputs),
+        _outputPtrs(outputs),
+        _maxFrames(maxFrames)
+  {
+    // inputs and outputs can each be up to one vector ahead of the host.
+    _inputBuffer.resize(inputs, (int)(_maxFrames + kFloatsPerDSPVector));
+    _outputBuffer.resize(outputs, (int)(_maxFrames + kFloatsPerDSPVector));
   }
 
   ~VectorProcessBuffer() {}
 
+  // return the number of frames by which the outputs are delayed from the
+  // inputs, in addition to any latency of processFn. This is 0 as long as
+  // every block has been a multiple of kFloatsPerDSPVector frames, and
+  // kFloatsPerDSPVector once any other block size has been processed. Blocks
+  // keep being processed in place at this latency.
+  size_t getLatency() const { return _latency; }
+
   void process(const float** inputs, float** outputs, int nFrames, ProcessVectorFn processFn,
                void* stateData = nullptr)
   {
-    size_t nInputs = _inputVectors.size();
-    size_t nOutputs = _outputVectors.size();
+    const size_t nInputs = _inputVectors.size();
+    const size_t nOutputs = _outputVectors.size();
     if (nOutputs < 1) return;
-    if(!outputs) return;
-    if (nFrames > (int)_maxFrames) return;
+    if (!outputs) return;
+    if ((nFrames < 0) || (nFrames > (int)_maxFrames)) return;
+    const size_t frames = nFrames;
+    if (!nInputs) inputs = nullptr;
 
-    // write vectors from inputs (if any) to inputBuffers
-    for(int c = 0; c < nInputs; c++)
+    // process whole vectors in place if possible.
+    size_t inFrame = 0;
+    size_t outFrame = 0;
+    if (getInPlaceStart(inputs, outputs, frames, inFrame, outFrame))
     {
-      if(inputs[c])
+      // complete and process any buffered input vectors, then read everything
+      // ahead of the first in-place output vector.
+      if (inputs)
       {
-        _inputBuffers[c].write(inputs[c], nFrames);
+        bufferInputs(inputs, 0, inFrame);
       }
-    }
-
-    // process until we have nFrames of output
-    while(_outputBuffers[0].getReadAvailable() < nFrames)
-    {
-      for(int c = 0; c < nInputs; c++)
+      while (_inputBuffer.read(_inputVectors))
       {
-        _inputVectors[c] = _inputBuffers[c].read();
+        processFn(_inputVectors, _outputVectors, stateData);
+        _outputBuffer.write(_outputVectors);
       }
+      _outputBuffer.read(outputs, outFrame);
 
-      processFn(_inputVectors, _outputVectors, stateData);
-
-      for(int c = 0; c < nOutputs; c++)
+      if (!inputs)
+      {
+        for (size_t c = 0; c < nInputs; c++)
+        {
+          _inputVectors[c] = DSPVector();
+        }
+      }
+      for (; outFrame + kFloatsPerDSPVector <= frames;
+           inFrame += kFloatsPerDSPVector, outFrame += kFloatsPerDSPVector)
       {
-        _outputBuffers[c].write(_outputVectors[c]);
+        if (inputs)
+        {
+          for (size_t c = 0; c < nInputs; c++)
+          {
+            _inputVectors.attachRow(c, const_cast<float*>(inputs[c] + inFrame));
+          }
+        }
+        for (size_t c = 0; c < nOutputs; c++)
+        {
+          _outputVectors.attachRow(c, outputs[c] + outFrame);
+        }
+        processFn(_inputVectors, _outputVectors, stateData);
       }
+      _inputVectors.detachRows();
+      _outputVectors.detachRows();
     }
 
-    // read from outputBuffers to outputs
-    for(int c = 0; c < nOutputs; c++)
+    // buffer any remaining frames.
+    if (inputs)
     {
-      if(outputs[c])
+      bufferInputs(inputs, inFrame, frames - inFrame);
+    }
+    const size_t bufferFrames = frames - outFrame;
+    if (!bufferFrames) return;
+    for (size_t c = 0; c < nOutputs; c++)
+    {
+      _outputPtrs[c] = outputs[c] ? outputs[c] + outFrame : nullptr;
+    }
+
+    // process until we have enough output. If a whole vector of input is not
+    // yet available, the processFn runs on zeros and the inputs are delayed
+    // by another vector.
+    while (_outputBuffer.getReadAvailable() < bufferFrames)
+    {
+      if (!_inputBuffer.read(_inputVectors))
       {
-        _outputBuffers[c].read(outputs[c], nFrames);
+        for (size_t c = 0; c < nInputs; c++)
+        {
+          _inputVectors[c] = DSPVector();
+        }
+        if (inputs)
+        {
+          _latency += kFloatsPerDSPVector;
+        }
       }
+
+      processFn(_inputVectors, _outputVectors, stateData);
+
+      _outputBuffer.write(_outputVectors);
     }
+
+    // read from the output buffer to outputs
+    _outputBuffer.read(_outputPtrs.data(), bufferFrames);
   }
 };
 
@@ -4,6 +4,8 @@
 
 #include "MLActor.h"
 
+#include "MLActorRuntime.h"
+
 using namespace ml;
 
 Actor* ActorRegistry::getActor(Path actorName) { return _actors[actorName]; }
@@ -28,3 +30,104 @@ void ActorRegistry::doRemove(Actor* actorToRemove)
 }
 
 void ActorRegistry::dump() { _actors.dump(); }
+
+void Actor::startThread()
+{
+  stop();
+  _threadRunning = true;
+  _thread = std::thread([this]() { threadLoop(); });
+}
+
+void Actor::start(ActorRuntime& runtime)
+{
+  stop();
+  _pRuntime.store(&runtime, std::memory_order_release);
+  _runState.store(kIdle, std::memory_order_release);
+
+  // schedule any messages sent before starting.
+  if (getMessagesAvailable())
+  {
+    notifyRuntime(&runtime);
+  }
+}
+
+void Actor::notifyRuntime(ActorRuntime* pRuntime)
+{
+  // every change is made with a compare-exchange, so each sender sees the
+  // latest state and either a worker sees its message or it schedules the
+  // Actor itself.
+  int state = _runState.load(std::memory_order_acquire);
+  while (true)
+  {
+    const int nextState =
+        (state == kIdle) ? kScheduled : (state == kScheduled) ? kNotified : state;
+    if (_runState.compare_exchange_weak(state, nextState, std::memory_order_acq_rel,
+                                        std::memory_order_acquire))
+    {
+      if (state == kIdle)
+      {
+        pRuntime->schedule(this);
+      }
+      return;
+    }
+  }
+}
+
+void Actor::stop()
+{
+  _queueTimer.stop();
+
+  // wait for the runtime to finish with the Actor. On one of the runtime's
+  // workers, run other Actors meanwhile, because this one may be waiting in
+  // this worker's queue.
+  if (ActorRuntime* pRuntime = _pRuntime.load(std::memory_order_acquire))
+  {
+    int state = kIdle;
+    while (!_runState.compare_exchange_weak(state, kStopped, std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+    {
+      if (state == kStopped) break;
+      state = kIdle;
+      if (!pRuntime->runQueuedActor())
+      {
+        std::this_thread::yield();
+      }
+    }
+    _pRuntime.store(nullptr, std::memory_order_release);
+  }
+  if (_thread.joinable())
+  {
+    _threadRunning = false;
+    {
+      std::unique_lock<std::mutex> lock(_wakeMutex);
+      _wakeCondition.notify_one();
+    }
+    _thread.join();
+  }
+}
+
+void Actor::wakeThread()
+{
+  // notifying with the lock held means the thread can't miss the wakeup
+  // between checking for messages and waiting.
+  std::unique_lock<std::mutex> lock(_wakeMutex);
+  _wakeCondition.notify_one();
+}
+
+void Actor::threadLoop()
+{
+  while (_threadRunning.load(std::memory_order_acquire))
+  {
+    handleMessagesInQueue();
+
+    // sleep until a message is sent.
+    _threadSleeping.exchange(1, std::memory_order_acq_rel);
+    {
+      std::unique_lock<std::mutex> lock(_wakeMutex);
+      _wakeCondition.wait(lock, [&]() {
+        return !_threadRunning.load(std::memory_order_acquire) || getMessagesAvailable();
+      });
+    }
+    _threadSleeping.store(0, std::memory_order_release);
+  }
+}
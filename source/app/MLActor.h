@@ -4,6 +4,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "MLLatencyHistogram.h"
 #include "MLMessage.h"
 #include "MLQueue.h"
 #include "MLTimer.h"
@@ -12,11 +21,20 @@
 // Combining Actors is a simple and scalable way to make distributed systems.
 // This is a very minimal implementation of the concept, with only the features
 // needed for applications in current development.
+//
+// start() handles messages from a Timer, so a message can wait a timer
+// interval or more. startThread() instead gives the Actor a thread of its own
+// that sleeps until a message is sent, for paths like controllers to synths
+// that need low latency. Sending a message to a busy thread takes no lock.
+// start(runtime) runs the Actor on the worker threads of an ActorRuntime,
+// which can run many Actors with a few threads.
 
 namespace ml
 {
 
 class Actor;
+class ActorRuntime;
+
 class ActorRegistry
 {
   Tree<Actor*> _actors;
@@ -36,21 +54,116 @@ class ActorRegistry
 class Actor
 {
   friend ActorRegistry;
+  friend ActorRuntime;
 
   static constexpr size_t kDefaultMessageQueueSize{128};
   static constexpr size_t kDefaultMessageInterval{1000 / 60};
 
-  Queue< Message > _messageQueue{kDefaultMessageQueueSize};
+  // a message and the time it was sent, for measuring latency.
+  struct TimedMessage
+  {
+    Message message;
+    std::chrono::steady_clock::time_point sendTime;
+
+    explicit operator bool() const { return static_cast<bool>(message); }
+  };
+
+  Queue< TimedMessage > _messageQueue{kDefaultMessageQueueSize};
+  MPMCQueue< TimedMessage > _sharedMessageQueue{0};
   Timer _queueTimer;
 
+  // for startThread().
+  std::thread _thread;
+  std::atomic<bool> _threadRunning{false};
+  std::atomic<int> _threadSleeping{0};
+  std::mutex _wakeMutex;
+  std::condition_variable _wakeCondition;
+
+  // for start(ActorRuntime&). While the Actor is scheduled, it is in one
+  // of the runtime's queues or being run by one worker. kNotified means a
+  // message was sent while it was scheduled, so it must be run again.
+  enum RunState
+  {
+    kStopped = 0,
+    kIdle,
+    kScheduled,
+    kNotified
+  };
+  std::atomic<ActorRuntime*> _pRuntime{nullptr};
+  std::atomic<int> _runState{kStopped};
+
+  LatencyHistogram _messageLatency;
+  LatencyHistogram _handlingTime;
+
+  void threadLoop();
+  void wakeThread();
+  void notifyRuntime(ActorRuntime* pRuntime);
+
+  void handleMessage(TimedMessage& m)
+  {
+    using namespace std::chrono;
+    const auto startTime = steady_clock::now();
+    _messageLatency.add(duration<double>(startTime - m.sendTime).count());
+    onMessage(std::move(m.message));
+    _handlingTime.add(duration<double>(steady_clock::now() - startTime).count());
+  }
+
+ public:
+  // kSingleProducer is fastest, but only one thread may send messages to the
+  // Actor. With kMultipleProducers, messages can be sent from any number of
+  // threads at once.
+  enum QueueMode
+  {
+    kSingleProducer = 0,
+    kMultipleProducers
+  };
+
+ private:
+  QueueMode _queueMode{kSingleProducer};
+  size_t _queueSize{kDefaultMessageQueueSize};
+
  protected:
-  size_t getMessagesAvailable() { return _messageQueue.elementsAvailable(); }
+  size_t getMessagesAvailable()
+  {
+    return (_queueMode == kMultipleProducers) ? _sharedMessageQueue.elementsAvailable()
+                                              : _messageQueue.elementsAvailable();
+  }
 
  public:
   Actor() = default;
-  virtual ~Actor() = default;
+  explicit Actor(QueueMode mode) { setQueueMode(mode); }
+
+  // the Actor's timer, thread or runtime may call onMessage() until stop()
+  // returns, so subclasses must call stop() in their destructors, while
+  // onMessage() is still safe to call.
+  virtual ~Actor()
+  {
+    assert(!_thread.joinable() && !_pRuntime.load() && "Actor destroyed without stop()");
+  }
   
-  void resizeQueue(size_t n) {_messageQueue.resize(n);}
+  void resizeQueue(size_t n)
+  {
+    _queueSize = n;
+    if (_queueMode == kMultipleProducers)
+    {
+      _sharedMessageQueue.resize(n);
+    }
+    else
+    {
+      _messageQueue.resize(n);
+    }
+  }
+
+  // set the kind of queue used. Like resizeQueue(), this is not thread-safe,
+  // so call it before starting the Actor or sending it messages.
+  void setQueueMode(QueueMode mode)
+  {
+    _queueMode = mode;
+    _messageQueue.resize((mode == kSingleProducer) ? _queueSize : 0);
+    _sharedMessageQueue.resize((mode == kMultipleProducers) ? _queueSize : 0);
+  }
+
+  QueueMode getQueueMode() const { return _queueMode; }
 
   // Actors can override onFullQueue to specify what action to take when
   // the message queue is full.
@@ -66,46 +179,92 @@ class Actor
   Actor& operator=(Actor const&) = delete;  // Copy assign
   Actor& operator=(Actor&&) = delete;       // Move assign
 
+  // each of the start methods stops the Actor first, so it is only ever
+  // running in one way at once.
   void start(size_t interval = kDefaultMessageInterval)
   {
+    stop();
+
     // we currently attempt to handle all the messages in the queue.
     // in the future we may want to do just a few at a time instead.
     _queueTimer.start([=]() { handleMessagesInQueue(); }, milliseconds(interval));
   }
 
-  void stop() { _queueTimer.stop(); }
+  // start handling messages on a thread of the Actor's own as soon as they
+  // are sent.
+  void startThread();
+
+  // start handling messages on the worker threads of the runtime. The
+  // runtime must outlive the Actor or the Actor must be stopped first.
+  void start(ActorRuntime& runtime);
 
-  // enqueueMessage just pushes the message onto the queue.
+  // stop handling messages with the timer, the thread or the runtime. With a
+  // runtime, this waits for messages already scheduled to be handled, so it
+  // must not be called from the Actor's own onMessage(). It may be called from
+  // another Actor's onMessage(), in which case the worker runs other Actors
+  // while it waits.
+  void stop();
+
+  // enqueueMessage pushes the message onto the queue, and wakes the Actor's
+  // thread if it is sleeping.
   void enqueueMessage(Message m)
   {
+    TimedMessage tm{std::move(m), std::chrono::steady_clock::now()};
+
     // queue returns true unless full.
-    if (!(_messageQueue.push(m)))
+    bool pushed = (_queueMode == kMultipleProducers) ? _sharedMessageQueue.push(std::move(tm))
+                                                     : _messageQueue.push(std::move(tm));
+    if (!pushed)
     {
       onFullQueue();
     }
+    else if (ActorRuntime* pRuntime = _pRuntime.load(std::memory_order_acquire))
+    {
+      notifyRuntime(pRuntime);
+    }
+    else if (_threadSleeping.fetch_add(0, std::memory_order_acq_rel))
+    {
+      // reading with a read-modify-write orders the push with the thread's
+      // setting of _threadSleeping: either the thread sees the message or
+      // we see it sleeping.
+      wakeThread();
+    }
   }
 
   void enqueueMessageList(const MessageList& ml)
   {
-    for (auto m : ml)
+    for (const auto& m : ml)
     {
       enqueueMessage(m);
     }
   }
 
-  // handle all the messages in the queue immediately.
-  void handleMessagesInQueue()
+  // handle the messages in the queue immediately, up to maxMessages of them.
+  // Returns the number handled.
+  size_t handleMessagesInQueue(size_t maxMessages = std::numeric_limits<size_t>::max())
   {
-    while (Message m = _messageQueue.pop())
+    size_t handled{0};
+    while (handled < maxMessages)
     {
-      onMessage(m);
+      TimedMessage m =
+          (_queueMode == kMultipleProducers) ? _sharedMessageQueue.pop() : _messageQueue.pop();
+      if (!m) break;
+      handleMessage(m);
+      handled++;
     }
+    return handled;
   }
   
   void clearMessageQueue()
   {
     _messageQueue.clear();
+    _sharedMessageQueue.clear();
   }
+
+  // the time from sending each message until its handling starts, and the
+  // time onMessage() takes.
+  const LatencyHistogram& getMessageLatency() const { return _messageLatency; }
+  const LatencyHistogram& getHandlingTime() const { return _handlingTime; }
   
 };
 
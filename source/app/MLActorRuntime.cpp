@@ -0,0 +1,154 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLActorRuntime.h"
+
+#include <algorithm>
+
+#include "MLActor.h"
+#include "MLThreadPool.h"
+
+using namespace ml;
+
+namespace
+{
+ActorRuntime::Options hardwareOptions()
+{
+  ActorRuntime::Options options;
+  options.workers = ThreadPool::getHardwareThreads();
+  return options;
+}
+
+// the runtime and worker index of the current thread, if it is a worker.
+thread_local ActorRuntime* tpWorkerRuntime{nullptr};
+thread_local size_t tWorker{0};
+}  // namespace
+
+ActorRuntime::ActorRuntime() : ActorRuntime(hardwareOptions()) {}
+
+ActorRuntime::ActorRuntime(const Options& options)
+    : _options(options), _parking(options.spinMicroseconds, 0)
+{
+  _options.workers = std::max(_options.workers, size_t(1));
+  _options.messageBudget = std::max(_options.messageBudget, size_t(1));
+  for (size_t i = 0; i < _options.workers; ++i)
+  {
+    _runQueues.push_back(std::make_unique<MPMCQueue<Actor*> >(_options.maxActors));
+  }
+  for (size_t i = 0; i < _options.workers; ++i)
+  {
+    _threads.emplace_back([this, i]() { workerLoop(i); });
+  }
+}
+
+ActorRuntime::~ActorRuntime()
+{
+  _parking.stop();
+  for (auto& t : _threads)
+  {
+    t.join();
+  }
+}
+
+void ActorRuntime::schedule(Actor* pActor)
+{
+  // spread Actors scheduled from other threads among the workers.
+  size_t worker = tWorker;
+  if (tpWorkerRuntime != this)
+  {
+    worker = _nextQueue.fetch_add(1, std::memory_order_relaxed) % _runQueues.size();
+  }
+  pushActor(worker, pActor);
+}
+
+bool ActorRuntime::runQueuedActor()
+{
+  // only a worker of this runtime can run its Actors.
+  if (tpWorkerRuntime != this) return false;
+  Actor* pActor{nullptr};
+  if (!findActor(tWorker, pActor)) return false;
+  runActor(tWorker, pActor);
+  return true;
+}
+
+void ActorRuntime::pushActor(size_t worker, Actor* pActor)
+{
+  _queuedActors.fetch_add(1, std::memory_order_seq_cst);
+
+  // the worker's own queue can only be full with more than maxActors
+  // started, in which case we look for room in the others.
+  const size_t n = _runQueues.size();
+  for (size_t i = 0; !_runQueues[(worker + i) % n]->push(pActor); ++i)
+  {
+    if (i % n == n - 1)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  _parking.wakeOne();
+}
+
+bool ActorRuntime::findActor(size_t worker, Actor*& pActor)
+{
+  const size_t n = _runQueues.size();
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (_runQueues[(worker + i) % n]->pop(pActor))
+    {
+      _queuedActors.fetch_sub(1, std::memory_order_acq_rel);
+      if (i)
+      {
+        _steals.fetch_add(1, std::memory_order_relaxed);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void ActorRuntime::runActor(size_t worker, Actor* pActor)
+{
+  _activations.fetch_add(1, std::memory_order_relaxed);
+
+  // from here, messages sent to the Actor will be seen by this activation
+  // or will notify it to run again.
+  pActor->_runState.exchange(Actor::kScheduled, std::memory_order_acq_rel);
+
+  const size_t budget = _options.messageBudget;
+  if (pActor->handleMessagesInQueue(budget) < budget)
+  {
+    // the queue was empty. Go idle unless a message was sent meanwhile. Once
+    // idle, the Actor may be stopped, so it must not be touched again.
+    int state = Actor::kScheduled;
+    if (pActor->_runState.compare_exchange_strong(state, Actor::kIdle, std::memory_order_acq_rel,
+                                                  std::memory_order_acquire))
+    {
+      return;
+    }
+  }
+
+  // there may be more messages: go to the back of the queue, still scheduled.
+  pushActor(worker, pActor);
+}
+
+void ActorRuntime::workerLoop(size_t worker)
+{
+  tpWorkerRuntime = this;
+  tWorker = worker;
+
+  Actor* pActor{nullptr};
+  auto lastWorkTime = WorkerParking::Clock::now();
+  while (_parking.running())
+  {
+    if (findActor(worker, pActor))
+    {
+      runActor(worker, pActor);
+      lastWorkTime = WorkerParking::Clock::now();
+      continue;
+    }
+    _parking.park(lastWorkTime,
+                  [&]() { return _queuedActors.load(std::memory_order_seq_cst) != 0; });
+  }
+}
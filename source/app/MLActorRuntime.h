@@ -0,0 +1,92 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ActorRuntime: runs many Actors on a fixed set of worker threads, so a slow
+// Actor doesn't hold up the others and Actors can use more than one core.
+//
+// An Actor started with start(runtime) is scheduled when a message is sent
+// to it while it is idle. Each worker has a queue of scheduled Actors.
+// Actors scheduled by a worker, as when one Actor sends to another, go on
+// that worker's queue, and the others are spread among the workers. A worker
+// with nothing in its queue steals from the others.
+//
+// An Actor is run by at most one worker at a time. Each time it runs, it
+// handles at most messageBudget messages and then goes to the back of a
+// queue if it has more, so a busy Actor can't starve the others. Idle
+// workers spin for a while before sleeping until an Actor is scheduled.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "MLQueue.h"
+#include "MLWorkerParking.h"
+
+namespace ml
+{
+class Actor;
+
+class ActorRuntime
+{
+ public:
+  struct Options
+  {
+    size_t workers{1};
+    size_t messageBudget{16};
+
+    // the most Actors that can be started in the runtime at once.
+    size_t maxActors{1024};
+
+    int spinMicroseconds{200};
+  };
+
+  // make a runtime with one worker per hardware thread.
+  ActorRuntime();
+  explicit ActorRuntime(const Options& options);
+
+  // all Actors started in the runtime must be stopped first.
+  ~ActorRuntime();
+
+  ActorRuntime(ActorRuntime const&) = delete;
+  ActorRuntime& operator=(ActorRuntime const&) = delete;
+
+  size_t getWorkers() const { return _threads.size(); }
+  size_t getMessageBudget() const { return _options.messageBudget; }
+
+  // the number of times Actors were run, and how many of those were by a
+  // worker that stole the Actor from another's queue.
+  uint64_t getActivations() const { return _activations.load(std::memory_order_relaxed); }
+  uint64_t getSteals() const { return _steals.load(std::memory_order_relaxed); }
+
+ private:
+  friend Actor;
+
+  void schedule(Actor* pActor);
+  bool runQueuedActor();
+  void pushActor(size_t worker, Actor* pActor);
+  bool findActor(size_t worker, Actor*& pActor);
+  void runActor(size_t worker, Actor* pActor);
+  void workerLoop(size_t worker);
+
+  Options _options;
+
+  // queue i belongs to worker i. An Actor is in at most one queue at once,
+  // so with maxActors places no queue can fill up.
+  std::vector<std::unique_ptr<MPMCQueue<Actor*> > > _runQueues;
+  std::vector<std::thread> _threads;
+
+  alignas(64) std::atomic<size_t> _queuedActors{0};
+  std::atomic<size_t> _nextQueue{0};
+  std::atomic<uint64_t> _activations{0};
+  std::atomic<uint64_t> _steals{0};
+
+  // Actors are scheduled with wakeOne(), so sleeping workers need no recheck.
+  WorkerParking _parking;
+};
+
+}  // namespace ml
@@ -0,0 +1,692 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLAudioFile.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace ml;
+
+namespace
+{
+// frames converted at a time when (de)interleaving, small enough that the
+// floats stay in cache.
+constexpr size_t kConvertFrames{1024};
+
+constexpr uint16_t kWAVFormatPCM{1};
+constexpr uint16_t kWAVFormatFloat{3};
+constexpr uint16_t kWAVFormatExtensible{0xFFFE};
+constexpr uint32_t kAIFCVersion{0xA2805140};
+constexpr uint32_t kMax32{0xFFFFFFFF};
+
+// the rest of the subformat GUID after the format code.
+constexpr uint8_t kSubformatGUID[14]{0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                     0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+bool seekFile(FILE* f, uint64_t pos)
+{
+#if ML_WINDOWS
+  return _fseeki64(f, static_cast<__int64>(pos), SEEK_SET) == 0;
+#else
+  return fseeko(f, static_cast<off_t>(pos), SEEK_SET) == 0;
+#endif
+}
+
+uint64_t getFileSize(FILE* f)
+{
+#if ML_WINDOWS
+  if (_fseeki64(f, 0, SEEK_END) != 0) return 0;
+  return static_cast<uint64_t>(_ftelli64(f));
+#else
+  if (fseeko(f, 0, SEEK_END) != 0) return 0;
+  return static_cast<uint64_t>(ftello(f));
+#endif
+}
+
+bool isID(const uint8_t* p, const char* id) { return !std::memcmp(p, id, 4); }
+
+uint16_t readLE16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+uint32_t readLE32(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t readLE64(const uint8_t* p) { return readLE32(p) | (uint64_t(readLE32(p + 4)) << 32); }
+
+uint16_t readBE16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+uint32_t readBE32(const uint8_t* p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// read an 80-bit IEEE extended float, as used for the AIFF sample rate.
+double readExtended(const uint8_t* p)
+{
+  const int exponent = ((p[0] & 0x7F) << 8) | p[1];
+  uint64_t mantissa{0};
+  for (int i = 0; i < 8; ++i)
+  {
+    mantissa = (mantissa << 8) | p[2 + i];
+  }
+  if (!exponent && !mantissa) return 0.;
+  const double x = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+  return (p[0] & 0x80) ? -x : x;
+}
+
+void appendID(std::vector<uint8_t>& v, const char* id) { v.insert(v.end(), id, id + 4); }
+
+void appendLE16(std::vector<uint8_t>& v, uint32_t x)
+{
+  v.push_back(x & 0xFF);
+  v.push_back((x >> 8) & 0xFF);
+}
+
+void appendLE32(std::vector<uint8_t>& v, uint32_t x)
+{
+  appendLE16(v, x & 0xFFFF);
+  appendLE16(v, x >> 16);
+}
+
+void appendLE64(std::vector<uint8_t>& v, uint64_t x)
+{
+  appendLE32(v, static_cast<uint32_t>(x));
+  appendLE32(v, static_cast<uint32_t>(x >> 32));
+}
+
+void appendBE16(std::vector<uint8_t>& v, uint32_t x)
+{
+  v.push_back((x >> 8) & 0xFF);
+  v.push_back(x & 0xFF);
+}
+
+void appendBE32(std::vector<uint8_t>& v, uint32_t x)
+{
+  appendBE16(v, x >> 16);
+  appendBE16(v, x & 0xFFFF);
+}
+
+void appendExtended(std::vector<uint8_t>& v, uint32_t x)
+{
+  uint32_t exponent{0};
+  uint64_t mantissa{0};
+  if (x)
+  {
+    int n = 31;
+    while (!(x >> n)) --n;
+    exponent = 16383 + n;
+    mantissa = static_cast<uint64_t>(x) << (63 - n);
+  }
+  appendBE16(v, exponent);
+  for (int i = 7; i >= 0; --i)
+  {
+    v.push_back((mantissa >> (i * 8)) & 0xFF);
+  }
+}
+
+bool getIntFormat(size_t bits, SampleFormat* pFormat)
+{
+  switch (bits)
+  {
+    case 16:
+      *pFormat = kInt16;
+      return true;
+    case 24:
+      *pFormat = kInt24;
+      return true;
+    case 32:
+      *pFormat = kInt32;
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t getBlockSize(size_t blockBytes, size_t bytesPerFrame)
+{
+  return max(blockBytes / bytesPerFrame, size_t(1)) * bytesPerFrame;
+}
+}  // namespace
+
+// ----------------------------------------------------------------
+// AudioFileReader
+
+bool AudioFileReader::open(const char* path)
+{
+  close();
+  _file = fopen(path, "rb");
+  if (!_file) return false;
+
+  // we read in large blocks, so stdio's buffer would only add a copy.
+  setvbuf(_file, nullptr, _IONBF, 0);
+  _fileSize = getFileSize(_file);
+
+  uint8_t header[12];
+  bool ok = seekFile(_file, 0) && (fread(header, 1, 12, _file) == 12);
+  if (ok)
+  {
+    if ((isID(header, "RIFF") || isID(header, "RF64")) && isID(header + 8, "WAVE"))
+    {
+      const bool isRF64 = isID(header, "RF64");
+      _fileType = isRF64 ? kRF64File : kWAVFile;
+      ok = readWAVHeader(isRF64);
+    }
+    else if (isID(header, "FORM") && (isID(header + 8, "AIFF") || isID(header + 8, "AIFC")))
+    {
+      const bool isAIFC = isID(header + 8, "AIFC");
+      _fileType = isAIFC ? kAIFCFile : kAIFFFile;
+      ok = readAIFFHeader(isAIFC);
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+
+  if (ok)
+  {
+    try
+    {
+      _block.resize(getBlockSize(kBlockBytes, _bytesPerFrame));
+      _scratch.resize(kConvertFrames * _channels);
+      _channelPtrs.resize(_channels);
+    }
+    catch (std::bad_alloc&)
+    {
+      ok = false;
+    }
+  }
+
+  if (!ok || !seek(0))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool AudioFileReader::readWAVHeader(bool isRF64)
+{
+  uint64_t dataSize64{0};
+  bool haveFormat{false};
+  uint64_t pos = 12;
+  uint8_t header[8];
+  while (pos + 8 <= _fileSize)
+  {
+    if (!seekFile(_file, pos) || (fread(header, 1, 8, _file) != 8)) return false;
+    uint64_t chunkSize = readLE32(header + 4);
+    const uint64_t dataPos = pos + 8;
+
+    if (isID(header, "ds64"))
+    {
+      uint8_t ds64[16];
+      if (chunkSize < 16 || (fread(ds64, 1, 16, _file) != 16)) return false;
+      dataSize64 = readLE64(ds64 + 8);
+    }
+    else if (isID(header, "fmt "))
+    {
+      uint8_t fmt[40]{};
+      if (chunkSize < 16) return false;
+      const size_t n = static_cast<size_t>(min(chunkSize, uint64_t(40)));
+      if (fread(fmt, 1, n, _file) != n) return false;
+
+      uint16_t formatTag = readLE16(fmt);
+      if (formatTag == kWAVFormatExtensible && n >= 40)
+      {
+        // the format code starts the subformat GUID.
+        formatTag = readLE16(fmt + 24);
+      }
+      const size_t bits = readLE16(fmt + 14);
+      if (formatTag == kWAVFormatPCM)
+      {
+        if (!getIntFormat(bits, &_format)) return false;
+      }
+      else if (formatTag == kWAVFormatFloat && bits == 32)
+      {
+        _format = kFloat32;
+      }
+      else
+      {
+        return false;
+      }
+      _channels = readLE16(fmt + 2);
+      _sampleRate = readLE32(fmt + 4);
+      _bytesPerFrame = _channels * getBytesPerSample(_format);
+      _bigEndian = false;
+      haveFormat = true;
+    }
+    else if (isID(header, "data"))
+    {
+      if (!haveFormat || !_channels) return false;
+      if (isRF64 && chunkSize == kMax32)
+      {
+        chunkSize = dataSize64;
+      }
+
+      // the data may be cut short if the file was not closed properly.
+      _dataOffset = dataPos;
+      _frames = static_cast<size_t>(min(chunkSize, _fileSize - dataPos) / _bytesPerFrame);
+      return true;
+    }
+
+    // chunks are padded to even sizes.
+    pos = dataPos + chunkSize + (chunkSize & 1);
+  }
+  return false;
+}
+
+bool AudioFileReader::readAIFFHeader(bool isAIFC)
+{
+  bool haveFormat{false};
+  uint64_t commFrames{0};
+  uint64_t pos = 12;
+  uint8_t header[8];
+  while (pos + 8 <= _fileSize)
+  {
+    if (!seekFile(_file, pos) || (fread(header, 1, 8, _file) != 8)) return false;
+    const uint64_t chunkSize = readBE32(header + 4);
+    const uint64_t dataPos = pos + 8;
+
+    if (isID(header, "COMM"))
+    {
+      uint8_t comm[22]{};
+      const size_t minSize = isAIFC ? 22 : 18;
+      if (chunkSize < minSize || (fread(comm, 1, minSize, _file) != minSize)) return false;
+
+      const size_t bits = readBE16(comm + 6);
+      const char* compression = isAIFC ? reinterpret_cast<const char*>(comm + 18) : "NONE";
+      const uint8_t* pCompression = reinterpret_cast<const uint8_t*>(compression);
+      _bigEndian = true;
+      if (isID(pCompression, "NONE") || isID(pCompression, "twos"))
+      {
+        if (!getIntFormat(bits, &_format)) return false;
+      }
+      else if (isID(pCompression, "sowt"))
+      {
+        if (!getIntFormat(bits, &_format)) return false;
+        _bigEndian = false;
+      }
+      else if (isID(pCompression, "in24"))
+      {
+        _format = kInt24;
+      }
+      else if (isID(pCompression, "in32"))
+      {
+        _format = kInt32;
+      }
+      else if (isID(pCompression, "fl32") || isID(pCompression, "FL32"))
+      {
+        _format = kFloat32;
+      }
+      else
+      {
+        return false;
+      }
+      _channels = readBE16(comm);
+      commFrames = readBE32(comm + 2);
+      _sampleRate = static_cast<size_t>(std::lround(readExtended(comm + 8)));
+      _bytesPerFrame = _channels * getBytesPerSample(_format);
+      haveFormat = true;
+    }
+    else if (isID(header, "SSND"))
+    {
+      uint8_t ssnd[8];
+      if (!haveFormat || !_channels || chunkSize < 8) return false;
+      if (fread(ssnd, 1, 8, _file) != 8) return false;
+
+      // the data can start after an offset, for alignment.
+      _dataOffset = dataPos + 8 + readBE32(ssnd);
+      if (_dataOffset > _fileSize) return false;
+      const uint64_t available = min(chunkSize - 8, _fileSize - _dataOffset);
+      _frames = static_cast<size_t>(min(commFrames, available / _bytesPerFrame));
+      return true;
+    }
+
+    pos = dataPos + chunkSize + (chunkSize & 1);
+  }
+  return false;
+}
+
+void AudioFileReader::close()
+{
+  if (_file)
+  {
+    fclose(_file);
+  }
+  _file = nullptr;
+  _channels = _sampleRate = _frames = _position = _bytesPerFrame = 0;
+  _dataOffset = _fileSize = 0;
+  _blockStart = _blockFrames = 0;
+}
+
+bool AudioFileReader::seek(size_t frame)
+{
+  if (!isOpen() || frame > _frames) return false;
+  if (!seekFile(_file, _dataOffset + static_cast<uint64_t>(frame) * _bytesPerFrame)) return false;
+  _position = frame;
+  _blockStart = _blockFrames = 0;
+  return true;
+}
+
+size_t AudioFileReader::fillBlock()
+{
+  const size_t frames = min(_frames - _position, _block.size() / _bytesPerFrame);
+  const size_t bytes = fread(_block.data(), 1, frames * _bytesPerFrame, _file);
+  _blockStart = 0;
+  _blockFrames = bytes / _bytesPerFrame;
+  return _blockFrames;
+}
+
+void AudioFileReader::consume(size_t frames)
+{
+  _blockStart += frames * _bytesPerFrame;
+  _blockFrames -= frames;
+  _position += frames;
+}
+
+size_t AudioFileReader::read(float* pDest, size_t frames)
+{
+  if (!isOpen()) return 0;
+  size_t done{0};
+  while (done < frames)
+  {
+    if (!_blockFrames && !fillBlock()) break;
+    const size_t n = min(frames - done, _blockFrames);
+    convertToFloat(_block.data() + _blockStart, pDest + done * _channels, n * _channels, _format,
+                   _bigEndian);
+    consume(n);
+    done += n;
+  }
+  return done;
+}
+
+size_t AudioFileReader::read(float* const* pDest, size_t frames)
+{
+  if (!isOpen()) return 0;
+  size_t done{0};
+  while (done < frames)
+  {
+    if (!_blockFrames && !fillBlock()) break;
+    const uint8_t* pSrc = _block.data() + _blockStart;
+    if (_channels == 1)
+    {
+      const size_t n = min(frames - done, _blockFrames);
+      convertToFloat(pSrc, pDest[0] + done, n, _format, _bigEndian);
+      consume(n);
+      done += n;
+    }
+    else
+    {
+      const size_t n = min(frames - done, min(_blockFrames, kConvertFrames));
+      convertToFloat(pSrc, _scratch.data(), n * _channels, _format, _bigEndian);
+      for (size_t c = 0; c < _channels; ++c)
+      {
+        _channelPtrs[c] = pDest[c] + done;
+      }
+      deinterleave(_scratch.data(), _channels, _channelPtrs.data(), n);
+      consume(n);
+      done += n;
+    }
+  }
+  return done;
+}
+
+// ----------------------------------------------------------------
+// AudioFileWriter
+
+bool AudioFileWriter::open(const char* path, AudioFileType type, SampleFormat format,
+                           size_t channels, size_t sampleRate)
+{
+  close();
+  if (!channels || channels > 0xFFFF) return false;
+  if (type == kAIFFFile && format == kFloat32)
+  {
+    type = kAIFCFile;
+  }
+  _fileType = type;
+  _format = format;
+  _channels = channels;
+  _sampleRate = sampleRate;
+  _bytesPerFrame = channels * getBytesPerSample(format);
+  _bigEndian = (type == kAIFFFile) || (type == kAIFCFile);
+  _frames = 0;
+  _blockBytes = 0;
+  _error = false;
+
+  // AIFF sizes are 32 bits, leaving room for the header.
+  _maxFrames = _bigEndian ? (kMax32 - 256) / _bytesPerFrame
+                          : std::numeric_limits<size_t>::max() / _bytesPerFrame;
+
+  try
+  {
+    _block.resize(getBlockSize(kBlockBytes, _bytesPerFrame));
+    _scratch.resize(kConvertFrames * _channels);
+    _channelPtrs.resize(_channels);
+  }
+  catch (std::bad_alloc&)
+  {
+    return false;
+  }
+
+  _file = fopen(path, "wb");
+  if (!_file) return false;
+  setvbuf(_file, nullptr, _IONBF, 0);
+
+  std::vector<uint8_t> header = makeHeader(0);
+  _headerBytes = header.size();
+  if (fwrite(header.data(), 1, header.size(), _file) != header.size())
+  {
+    fclose(_file);
+    _file = nullptr;
+    return false;
+  }
+  return true;
+}
+
+std::vector<uint8_t> AudioFileWriter::makeHeader(uint64_t dataBytes) const
+{
+  const size_t bits = getBytesPerSample(_format) * 8;
+  const uint64_t padding = dataBytes & 1;
+  std::vector<uint8_t> h;
+
+  if (_bigEndian)
+  {
+    const bool isAIFC = (_fileType == kAIFCFile);
+    std::vector<uint8_t> comm;
+    appendBE16(comm, static_cast<uint32_t>(_channels));
+    appendBE32(comm, static_cast<uint32_t>(_frames));
+    appendBE16(comm, static_cast<uint32_t>(bits));
+    appendExtended(comm, static_cast<uint32_t>(_sampleRate));
+    if (isAIFC)
+    {
+      // compression type and name, a Pascal string padded to an even length.
+      const char* name = (_format == kFloat32) ? "\x08" "Float 32" : "\x0E" "not compressed";
+      appendID(comm, (_format == kFloat32) ? "fl32" : "NONE");
+      comm.insert(comm.end(), name, name + name[0] + 1);
+      if (comm.size() & 1) comm.push_back(0);
+    }
+
+    const size_t headerBytes = 12 + (isAIFC ? 12 : 0) + 8 + comm.size() + 16;
+    appendID(h, "FORM");
+    appendBE32(h, static_cast<uint32_t>(headerBytes - 8 + dataBytes + padding));
+    appendID(h, isAIFC ? "AIFC" : "AIFF");
+    if (isAIFC)
+    {
+      appendID(h, "FVER");
+      appendBE32(h, 4);
+      appendBE32(h, kAIFCVersion);
+    }
+    appendID(h, "COMM");
+    appendBE32(h, static_cast<uint32_t>(comm.size()));
+    h.insert(h.end(), comm.begin(), comm.end());
+    appendID(h, "SSND");
+    appendBE32(h, static_cast<uint32_t>(8 + dataBytes));
+    appendBE32(h, 0);
+    appendBE32(h, 0);
+    return h;
+  }
+
+  // WAV. Integers of more than 16 bits and more than two channels need the
+  // extensible format.
+  const bool extensible = (_channels > 2) || (_format == kInt24) || (_format == kInt32);
+  const uint16_t formatCode = (_format == kFloat32) ? kWAVFormatFloat : kWAVFormatPCM;
+  std::vector<uint8_t> fmt;
+  appendLE16(fmt, extensible ? kWAVFormatExtensible : formatCode);
+  appendLE16(fmt, static_cast<uint32_t>(_channels));
+  appendLE32(fmt, static_cast<uint32_t>(_sampleRate));
+  appendLE32(fmt, static_cast<uint32_t>(_sampleRate * _bytesPerFrame));
+  appendLE16(fmt, static_cast<uint32_t>(_bytesPerFrame));
+  appendLE16(fmt, static_cast<uint32_t>(bits));
+  if (extensible)
+  {
+    const uint32_t channelMask = (_channels == 1) ? 0x4 : (_channels == 2) ? 0x3 : 0;
+    appendLE16(fmt, 22);
+    appendLE16(fmt, static_cast<uint32_t>(bits));
+    appendLE32(fmt, channelMask);
+    appendLE16(fmt, formatCode);
+    fmt.insert(fmt.end(), kSubformatGUID, kSubformatGUID + 14);
+  }
+
+  // a JUNK chunk the size of a ds64 chunk reserves space to become one.
+  constexpr uint32_t kDS64Bytes{28};
+  const size_t headerBytes = 12 + 8 + kDS64Bytes + 8 + fmt.size() + 8;
+  const uint64_t riffSize = headerBytes - 8 + dataBytes + padding;
+  const bool isRF64 = (_fileType == kRF64File) || (riffSize > kMax32);
+
+  appendID(h, isRF64 ? "RF64" : "RIFF");
+  appendLE32(h, isRF64 ? kMax32 : static_cast<uint32_t>(riffSize));
+  appendID(h, "WAVE");
+  appendID(h, isRF64 ? "ds64" : "JUNK");
+  appendLE32(h, kDS64Bytes);
+  if (isRF64)
+  {
+    appendLE64(h, riffSize);
+    appendLE64(h, dataBytes);
+    appendLE64(h, _frames);
+    appendLE32(h, 0);
+  }
+  else
+  {
+    h.insert(h.end(), kDS64Bytes, 0);
+  }
+  appendID(h, "fmt ");
+  appendLE32(h, static_cast<uint32_t>(fmt.size()));
+  h.insert(h.end(), fmt.begin(), fmt.end());
+  appendID(h, "data");
+  appendLE32(h, isRF64 ? kMax32 : static_cast<uint32_t>(dataBytes));
+  return h;
+}
+
+bool AudioFileWriter::flushBlock()
+{
+  if (_blockBytes && (fwrite(_block.data(), 1, _blockBytes, _file) != _blockBytes))
+  {
+    _error = true;
+  }
+  _blockBytes = 0;
+  return !_error;
+}
+
+bool AudioFileWriter::close()
+{
+  if (!_file) return false;
+  bool ok = flushBlock();
+
+  // pad the data chunk to an even size, then rewrite the header with the
+  // final sizes.
+  const uint64_t dataBytes = static_cast<uint64_t>(_frames) * _bytesPerFrame;
+  if (dataBytes & 1)
+  {
+    ok = ok && (fputc(0, _file) != EOF);
+  }
+  std::vector<uint8_t> header = makeHeader(dataBytes);
+  ok = ok && (header.size() == _headerBytes) && seekFile(_file, 0) &&
+       (fwrite(header.data(), 1, header.size(), _file) == header.size());
+  ok = (fclose(_file) == 0) && ok;
+  _file = nullptr;
+  return ok;
+}
+
+size_t AudioFileWriter::write(const float* pSrc, size_t frames)
+{
+  if (!isOpen() || _error) return 0;
+  frames = min(frames, _maxFrames - _frames);
+  const size_t blockFrames = _block.size() / _bytesPerFrame;
+  size_t done{0};
+  while (done < frames)
+  {
+    const size_t n = min(frames - done, blockFrames - _blockBytes / _bytesPerFrame);
+    convertFromFloat(pSrc + done * _channels, _block.data() + _blockBytes, n * _channels, _format,
+                     _bigEndian);
+    _blockBytes += n * _bytesPerFrame;
+    _frames += n;
+    done += n;
+    if ((_blockBytes == _block.size()) && !flushBlock()) break;
+  }
+  return done;
+}
+
+size_t AudioFileWriter::write(const float* const* pSrc, size_t frames)
+{
+  if (!isOpen() || _error) return 0;
+  frames = min(frames, _maxFrames - _frames);
+  const size_t blockFrames = _block.size() / _bytesPerFrame;
+  size_t done{0};
+  while (done < frames)
+  {
+    uint8_t* pDest = _block.data() + _blockBytes;
+    size_t n = min(frames - done, blockFrames - _blockBytes / _bytesPerFrame);
+    if (_channels == 1)
+    {
+      convertFromFloat(pSrc[0] + done, pDest, n, _format, _bigEndian);
+    }
+    else
+    {
+      n = min(n, kConvertFrames);
+      for (size_t c = 0; c < _channels; ++c)
+      {
+        _channelPtrs[c] = pSrc[c] + done;
+      }
+      interleave(_channelPtrs.data(), _channels, _scratch.data(), n);
+      convertFromFloat(_scratch.data(), pDest, n * _channels, _format, _bigEndian);
+    }
+    _blockBytes += n * _bytesPerFrame;
+    _frames += n;
+    done += n;
+    if ((_blockBytes == _block.size()) && !flushBlock()) break;
+  }
+  return done;
+}
+
+// ----------------------------------------------------------------
+// whole files
+
+bool ml::readAudioFile(const char* path, Sample& dest)
+{
+  AudioFileReader reader;
+  if (!reader.open(path)) return false;
+  const size_t frames = reader.getFrames();
+  if (frames && !resize(dest, frames, reader.getChannels())) return false;
+  dest.channels = reader.getChannels();
+  dest.sampleRate = reader.getSampleRate();
+  if (!frames)
+  {
+    dest.sampleData.clear();
+    return true;
+  }
+  return reader.read(dest.sampleData.data(), frames) == frames;
+}
+
+bool ml::writeAudioFile(const char* path, const Sample& src, AudioFileType type,
+                        SampleFormat format)
+{
+  AudioFileWriter writer;
+  if (!writer.open(path, type, format, src.channels, src.sampleRate)) return false;
+  const size_t frames = getFrames(src);
+  const bool ok = (writer.write(src.sampleData.data(), frames) == frames);
+  return writer.close() && ok;
+}
@@ -0,0 +1,212 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// AudioFileReader and AudioFileWriter: streaming access to WAV, RF64 and AIFF /
+// AIFC files of 16, 24 or 32-bit integer or 32-bit float samples.
+//
+// Files are read and written in blocks of about kBlockBytes using the C stdio
+// functions with their own buffering turned off, so large files stream at the
+// disk's sequential rate without being held in memory. Samples are converted
+// to and from floats a block at a time with the SIMD kernels in
+// MLDSPSampleFormat.h, and frames can be read or written as interleaved
+// floats, planar channels or DSPVectorArrays.
+//
+// The writer leaves room in a WAV header to upgrade the file to RF64 when it
+// is closed, so there is no need to know the length of a WAV file in advance.
+
+#pragma once
+
+#include <array>
+#include <cstdio>
+#include <vector>
+
+#include "MLDSPSample.h"
+#include "MLDSPSampleFormat.h"
+#include "MLPlatform.h"
+
+namespace ml
+{
+enum AudioFileType
+{
+  kWAVFile = 0,
+  kRF64File,
+  kAIFFFile,
+  kAIFCFile
+};
+
+class AudioFileReader
+{
+ public:
+  static constexpr size_t kBlockBytes{1 << 18};
+
+  AudioFileReader() = default;
+  ~AudioFileReader() { close(); }
+
+  AudioFileReader(AudioFileReader const&) = delete;
+  AudioFileReader& operator=(AudioFileReader const&) = delete;
+
+  // open a file and read its header. Returns true if the file is in one of
+  // the supported formats.
+  bool open(const char* path);
+  void close();
+
+  bool isOpen() const { return _file != nullptr; }
+  AudioFileType getFileType() const { return _fileType; }
+  SampleFormat getFormat() const { return _format; }
+  size_t getChannels() const { return _channels; }
+  size_t getSampleRate() const { return _sampleRate; }
+  size_t getFrames() const { return _frames; }
+
+  // the next frame that will be read.
+  size_t getPosition() const { return _position; }
+
+  // move the read position to the given frame. Returns false if it is past the
+  // end of the file.
+  bool seek(size_t frame);
+
+  // read up to the given number of frames as interleaved floats. Returns the
+  // number of frames read, which is less than requested only at the end of
+  // the file or on an error.
+  size_t read(float* pDest, size_t frames);
+
+  // read up to the given number of frames into one buffer per channel.
+  size_t read(float* const* pDest, size_t frames);
+
+  // read the next vector of frames. Output row c gets file channel
+  // c % getChannels(), and any frames after the end of the file are zero.
+  template <size_t CHANNELS>
+  size_t read(DSPVectorArray<CHANNELS>& vy)
+  {
+    float* pRows[CHANNELS];
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      pRows[c] = vy.getRowData(c);
+    }
+
+    // channels past CHANNELS are read into the discard buffer.
+    _rowPtrs.resize(_channels);
+    for (size_t c = 0; c < _channels; ++c)
+    {
+      _rowPtrs[c] = (c < CHANNELS) ? pRows[c] : _discard.data();
+    }
+    size_t n = isOpen() ? read(_rowPtrs.data(), kFloatsPerDSPVector) : 0;
+
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      if (c >= _channels && _channels > 0)
+      {
+        std::copy(pRows[c % _channels], pRows[c % _channels] + n, pRows[c]);
+      }
+      std::fill(pRows[c] + n, pRows[c] + kFloatsPerDSPVector, 0.f);
+    }
+    return n;
+  }
+
+ private:
+  bool readWAVHeader(bool isRF64);
+  bool readAIFFHeader(bool isAIFC);
+
+  // make the next block of the file available. Returns the number of whole
+  // frames in the block.
+  size_t fillBlock();
+  void consume(size_t frames);
+
+  FILE* _file{nullptr};
+  AudioFileType _fileType{kWAVFile};
+  SampleFormat _format{kInt16};
+  bool _bigEndian{false};
+  size_t _channels{0};
+  size_t _sampleRate{0};
+  size_t _frames{0};
+  size_t _position{0};
+  size_t _bytesPerFrame{0};
+  uint64_t _dataOffset{0};
+  uint64_t _fileSize{0};
+
+  // the current block of file data, of which _blockFrames frames are unread.
+  std::vector<uint8_t> _block;
+  size_t _blockStart{0};
+  size_t _blockFrames{0};
+
+  std::vector<float> _scratch;
+  std::vector<float*> _channelPtrs;
+  std::vector<float*> _rowPtrs;
+  std::array<float, kFloatsPerDSPVector> _discard;
+};
+
+class AudioFileWriter
+{
+ public:
+  static constexpr size_t kBlockBytes{1 << 18};
+
+  AudioFileWriter() = default;
+  ~AudioFileWriter() { close(); }
+
+  AudioFileWriter(AudioFileWriter const&) = delete;
+  AudioFileWriter& operator=(AudioFileWriter const&) = delete;
+
+  // create a file and write a provisional header. A kWAVFile is written as
+  // RF64 if its data grows past 4GB. An AIFF file of floats is written as AIFC.
+  // Returns true on success.
+  bool open(const char* path, AudioFileType type, SampleFormat format, size_t channels,
+            size_t sampleRate);
+
+  // write any buffered data, complete the header and close the file. Returns
+  // true if everything written was saved.
+  bool close();
+
+  bool isOpen() const { return _file != nullptr; }
+  size_t getFramesWritten() const { return _frames; }
+
+  // write interleaved floats. Returns the number of frames written, which is
+  // less than requested only on an error or when an AIFF file is full.
+  size_t write(const float* pSrc, size_t frames);
+
+  // write frames from one buffer per channel.
+  size_t write(const float* const* pSrc, size_t frames);
+
+  // write the first frames of a vector. File channel c gets row c % CHANNELS.
+  template <size_t CHANNELS>
+  size_t write(const DSPVectorArray<CHANNELS>& vx, size_t frames = kFloatsPerDSPVector)
+  {
+    _rowPtrs.resize(_channels);
+    for (size_t c = 0; c < _channels; ++c)
+    {
+      _rowPtrs[c] = vx.getRowDataConst(c % CHANNELS);
+    }
+    return isOpen() ? write(_rowPtrs.data(), min(frames, size_t(kFloatsPerDSPVector))) : 0;
+  }
+
+ private:
+  std::vector<uint8_t> makeHeader(uint64_t dataBytes) const;
+  bool flushBlock();
+
+  FILE* _file{nullptr};
+  AudioFileType _fileType{kWAVFile};
+  SampleFormat _format{kInt16};
+  bool _bigEndian{false};
+  bool _error{false};
+  size_t _channels{0};
+  size_t _sampleRate{0};
+  size_t _frames{0};
+  size_t _maxFrames{0};
+  size_t _bytesPerFrame{0};
+  size_t _headerBytes{0};
+
+  std::vector<uint8_t> _block;
+  size_t _blockBytes{0};
+
+  std::vector<float> _scratch;
+  std::vector<const float*> _channelPtrs;
+  std::vector<const float*> _rowPtrs;
+};
+
+// read a whole file into a Sample. Returns false if the file can't be read.
+bool readAudioFile(const char* path, Sample& dest);
+
+// write a Sample to a new file. Returns false if the file can't be written.
+bool writeAudioFile(const char* path, const Sample& src, AudioFileType type = kWAVFile,
+                    SampleFormat format = kFloat32);
+
+}  // namespace ml
@@ -0,0 +1,262 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLDiskStreamer.h"
+
+#include <chrono>
+
+using namespace ml;
+
+// ----------------------------------------------------------------
+// StreamingSample
+
+bool StreamingSample::open(const std::string& path, size_t headFrames)
+{
+  _frames = 0;
+  AudioFileReader reader;
+  if (!reader.open(path.c_str()) || !reader.getFrames()) return false;
+
+  const size_t frames = min(headFrames, reader.getFrames());
+  if (!resize(_head, frames, reader.getChannels())) return false;
+  _head.sampleRate = reader.getSampleRate();
+  if (reader.read(_head.sampleData.data(), frames) != frames) return false;
+
+  _path = path;
+  _frames = reader.getFrames();
+  return true;
+}
+
+// ----------------------------------------------------------------
+// DiskStreamer
+
+DiskStreamer::DiskStreamer(size_t voices, size_t maxChannels, size_t bufferFrames)
+    : _maxChannels(maxChannels), _requests(voices * 4)
+{
+  bufferFrames = max(bufferFrames, kReadFrames);
+  for (size_t v = 0; v < voices; ++v)
+  {
+    auto pStream = std::make_unique<Stream>();
+    pStream->buffer.resize(static_cast<int>(bufferFrames * maxChannels));
+    pStream->interleaved.resize(kFloatsPerDSPVector * maxChannels);
+    pStream->rowPtrs.resize(maxChannels);
+    _streams.push_back(std::move(pStream));
+  }
+  _readBuffer.resize(kReadFrames * maxChannels);
+}
+
+DiskStreamer::~DiskStreamer() { stop(); }
+
+void DiskStreamer::start(int idleMilliseconds)
+{
+  if (_running || _pPool) return;
+  _running = true;
+  _thread = std::thread{[this, idleMilliseconds]() {
+    while (_running)
+    {
+      if (!service())
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(idleMilliseconds));
+      }
+    }
+  }};
+}
+
+void DiskStreamer::start(ThreadPool& pool)
+{
+  if (_running || _pPool) return;
+  _pPool = &pool;
+}
+
+void DiskStreamer::stop()
+{
+  _running = false;
+  if (_thread.joinable())
+  {
+    _thread.join();
+  }
+
+  // wait for any pending job.
+  _pPool = nullptr;
+  while (_serviceQueued.load(std::memory_order_acquire))
+  {
+    std::this_thread::yield();
+  }
+}
+
+void DiskStreamer::requestService()
+{
+  ThreadPool* pPool = _pPool.load(std::memory_order_acquire);
+  if (!pPool || _serviceQueued.exchange(true, std::memory_order_acq_rel)) return;
+  if (!pPool->submit(serviceJob, this))
+  {
+    _serviceQueued.store(false, std::memory_order_release);
+  }
+}
+
+void DiskStreamer::serviceJob(void* pContext)
+{
+  // only one job is pending at a time, so service() is never run twice at once.
+  DiskStreamer* pStreamer = static_cast<DiskStreamer*>(pContext);
+  while (pStreamer->service())
+  {
+  }
+  pStreamer->_serviceQueued.store(false, std::memory_order_release);
+}
+
+bool DiskStreamer::service()
+{
+  bool didWork{false};
+  Request r;
+  while (_requests.pop(r))
+  {
+    handleRequest(r);
+    didWork = true;
+  }
+  for (auto& pStream : _streams)
+  {
+    didWork |= fillBuffer(*pStream);
+  }
+  return didWork;
+}
+
+void DiskStreamer::handleRequest(const Request& r)
+{
+  Stream& s = *_streams[r.voice];
+  bool ok{true};
+  s.reading = false;
+  if (r.pSample)
+  {
+    // the audio thread plays the head, so reading starts after it.
+    const size_t startFrame = max(r.startFrame, r.pSample->getHeadFrames());
+    if (startFrame < r.pSample->getFrames())
+    {
+      if (s.pOpenSample != r.pSample)
+      {
+        s.pOpenSample = s.reader.open(r.pSample->getPath().c_str()) ? r.pSample : nullptr;
+      }
+      ok = s.pOpenSample && s.reader.seek(startFrame);
+      s.reading = ok;
+    }
+  }
+
+  s.ackMark.store(ok ? s.samplesWritten : kFailedMark, std::memory_order_relaxed);
+  s.ackGeneration.store(r.generation, std::memory_order_release);
+}
+
+bool DiskStreamer::fillBuffer(Stream& s)
+{
+  if (!s.reading) return false;
+
+  // wait for room for a whole block unless the file is nearly done.
+  const size_t channels = s.reader.getChannels();
+  const size_t framesLeft = s.reader.getFrames() - s.reader.getPosition();
+  const size_t frames = min(kReadFrames, framesLeft);
+  if (s.buffer.getWriteAvailable() < frames * channels) return false;
+
+  const size_t framesRead = s.reader.read(_readBuffer.data(), frames);
+  s.buffer.write(_readBuffer.data(), framesRead * channels);
+  s.samplesWritten += framesRead * channels;
+  if (framesRead < frames || framesRead == framesLeft)
+  {
+    s.reading = false;
+  }
+  return true;
+}
+
+bool DiskStreamer::trigger(size_t voice, const StreamingSample& sample, size_t startFrame)
+{
+  Stream& s = *_streams[voice];
+  s.playing = false;
+  if (!sample.isOpen() || sample.getChannels() > _maxChannels) return false;
+  if (startFrame >= sample.getFrames()) return false;
+
+  s.generation++;
+  if (!_requests.push(Request{voice, s.generation, &sample, startFrame}))
+  {
+    _droppedRequests.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  s.pSample = &sample;
+  s.position = startFrame;
+  s.synced = false;
+  s.playing = true;
+  requestService();
+  return true;
+}
+
+void DiskStreamer::stopVoice(size_t voice)
+{
+  Stream& s = *_streams[voice];
+  if (!s.playing) return;
+  s.playing = false;
+
+  // if the request can't be sent, the I/O thread stops when the buffer fills.
+  s.generation++;
+  if (!_requests.push(Request{voice, s.generation, nullptr, 0}))
+  {
+    _droppedRequests.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+size_t DiskStreamer::readFrames(Stream& s)
+{
+  const StreamingSample& sample = *s.pSample;
+  const size_t channels = sample.getChannels();
+  const size_t headFrames = sample.getHeadFrames();
+  const size_t frames = min(size_t(kFloatsPerDSPVector), sample.getFrames() - s.position);
+  float* pDest = s.interleaved.data();
+  size_t done{0};
+
+  if (s.position < headFrames)
+  {
+    done = min(frames, headFrames - s.position);
+    const float* pHead = getConstFramePtr(sample.getHead(), s.position);
+    std::copy(pHead, pHead + done * channels, pDest);
+  }
+
+  if (done < frames)
+  {
+    if (!s.synced && (s.ackGeneration.load(std::memory_order_acquire) == s.generation))
+    {
+      // skip anything written before the I/O thread handled our request.
+      const uint64_t mark = s.ackMark.load(std::memory_order_relaxed);
+      if (mark == kFailedMark)
+      {
+        s.playing = false;
+        return done;
+      }
+      s.buffer.discard(static_cast<size_t>(mark - s.samplesRead));
+      s.samplesRead = mark;
+      s.synced = true;
+    }
+    if (s.synced)
+    {
+      const size_t samples =
+          s.buffer.read(pDest + done * channels, (frames - done) * channels);
+      s.samplesRead += samples;
+      done += samples / channels;
+    }
+    if (done < frames)
+    {
+      s.underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  s.position += done;
+  if (s.position >= sample.getFrames())
+  {
+    s.playing = false;
+  }
+  return done;
+}
+
+size_t DiskStreamer::getUnderruns() const
+{
+  size_t n{0};
+  for (const auto& pStream : _streams)
+  {
+    n += pStream->underruns.load(std::memory_order_relaxed);
+  }
+  return n;
+}
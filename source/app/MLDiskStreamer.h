@@ -0,0 +1,220 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// DiskStreamer: plays samples too large to keep in memory directly from disk.
+//
+// A StreamingSample is an audio file with the first headFrames frames read
+// into memory. DiskStreamer plays a number of voices, each streaming from a
+// StreamingSample at its original rate. When a voice is triggered, it starts
+// playing from the head segment at once while an I/O thread opens the file
+// and starts reading the frames after the head into a DSPBuffer for that
+// voice. The head should be long enough to cover the time it takes to open a
+// file and read the first block.
+//
+// The audio thread sends trigger and stop requests to the I/O thread through a
+// lock-free Queue, and reads frames from the voice buffers. It never waits for
+// the I/O thread: if a voice's buffer runs dry, the voice outputs silence and
+// pauses until more frames arrive, and an underrun is counted. Each request
+// carries a generation number, so frames the I/O thread wrote for an earlier
+// trigger of the same voice can be recognized and skipped.
+//
+// trigger(), stopVoice() and read() must all be called from one audio thread.
+// The I/O thread is started with start(). Or, start(pool) runs the I/O as
+// jobs in a ThreadPool shared with other work, or service() can be called
+// periodically from a thread of the caller's own.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MLAudioFile.h"
+#include "MLDSPBuffer.h"
+#include "MLQueue.h"
+#include "MLThreadPool.h"
+
+namespace ml
+{
+class StreamingSample
+{
+ public:
+  static constexpr size_t kDefaultHeadFrames{16384};
+
+  StreamingSample() = default;
+
+  StreamingSample(StreamingSample const&) = delete;
+  StreamingSample& operator=(StreamingSample const&) = delete;
+
+  // read the header and head segment of a file. This reads from disk, so it
+  // should not be called from the audio thread. Returns true on success.
+  bool open(const std::string& path, size_t headFrames = kDefaultHeadFrames);
+
+  bool isOpen() const { return _frames > 0; }
+  const std::string& getPath() const { return _path; }
+  size_t getChannels() const { return _head.channels; }
+  size_t getSampleRate() const { return _head.sampleRate; }
+  size_t getFrames() const { return _frames; }
+  size_t getHeadFrames() const { return ml::getFrames(_head); }
+  const Sample& getHead() const { return _head; }
+
+ private:
+  std::string _path;
+  size_t _frames{0};
+  Sample _head;
+};
+
+class DiskStreamer
+{
+ public:
+  // frames read from a file at a time.
+  static constexpr size_t kReadFrames{4096};
+
+  // voices: the number of voices. maxChannels: the most channels a sample can
+  // have. bufferFrames: the size of each voice's buffer, at least kReadFrames.
+  DiskStreamer(size_t voices, size_t maxChannels, size_t bufferFrames = 32768);
+  ~DiskStreamer();
+
+  DiskStreamer(DiskStreamer const&) = delete;
+  DiskStreamer& operator=(DiskStreamer const&) = delete;
+
+  // start and stop the I/O thread, which calls service() and sleeps for
+  // idleMilliseconds whenever there is nothing to do.
+  void start(int idleMilliseconds = 1);
+  void stop();
+
+  // instead of a thread, call service() from jobs in the pool. The audio
+  // thread submits a job whenever a voice is triggered or read and none is
+  // pending, and the job services until there is nothing to do. The pool
+  // must outlive stop().
+  void start(ThreadPool& pool);
+
+  // handle any requests, then read from disk for voices with room in their
+  // buffers. Returns true if there was anything to do. Called from the I/O
+  // thread.
+  bool service();
+
+  // audio thread methods
+
+  // start playing the sample on the voice from the given frame. Starting
+  // within the head segment is instant. The sample must stay open while the
+  // voice is playing. Returns false if the request could not be sent.
+  bool trigger(size_t voice, const StreamingSample& sample, size_t startFrame = 0);
+
+  void stopVoice(size_t voice);
+
+  bool isPlaying(size_t voice) const { return _streams[voice]->playing; }
+
+  // the next frame of the sample the voice will play.
+  size_t getPosition(size_t voice) const { return _streams[voice]->position; }
+
+  // read the next vector of a voice. Output row c gets sample channel
+  // c % channels. Frames after the end of the sample or missing because of an
+  // underrun are zero.
+  template <size_t CHANNELS>
+  DSPVectorArray<CHANNELS> read(size_t voice)
+  {
+    DSPVectorArray<CHANNELS> vy;
+    Stream& s = *_streams[voice];
+    if (!s.playing) return vy;
+    requestService();
+
+    const size_t channels = s.pSample->getChannels();
+    const size_t frames = readFrames(s);
+    float* pRows[CHANNELS];
+    for (size_t c = 0; c < CHANNELS; ++c)
+    {
+      pRows[c] = vy.getRowData(c);
+    }
+    for (size_t c = 0; c < channels; ++c)
+    {
+      s.rowPtrs[c] = (c < CHANNELS) ? pRows[c] : s.discard.data();
+    }
+    deinterleave(s.interleaved.data(), channels, s.rowPtrs.data(), frames);
+    for (size_t c = channels; c < CHANNELS; ++c)
+    {
+      std::copy(pRows[c % channels], pRows[c % channels] + frames, pRows[c]);
+    }
+    return vy;
+  }
+
+  // underruns are counted once for each vector that could not be filled.
+  // These can be called from any thread.
+  size_t getUnderruns(size_t voice) const
+  {
+    return _streams[voice]->underruns.load(std::memory_order_relaxed);
+  }
+  size_t getUnderruns() const;
+  size_t getDroppedRequests() const { return _droppedRequests.load(std::memory_order_relaxed); }
+
+ private:
+  struct Request
+  {
+    size_t voice{0};
+    uint32_t generation{0};
+    const StreamingSample* pSample{nullptr};
+    size_t startFrame{0};
+  };
+
+  struct Stream
+  {
+    // interleaved frames from the I/O thread to the audio thread.
+    DSPBuffer buffer;
+
+    // audio thread state. The samples read from the buffer are counted so
+    // that stale frames can be skipped after a new trigger.
+    const StreamingSample* pSample{nullptr};
+    uint32_t generation{0};
+    bool playing{false};
+    bool synced{false};
+    size_t position{0};
+    uint64_t samplesRead{0};
+    std::vector<float> interleaved;
+    std::vector<float*> rowPtrs;
+    std::array<float, kFloatsPerDSPVector> discard;
+
+    // I/O thread state
+    AudioFileReader reader;
+    const StreamingSample* pOpenSample{nullptr};
+    bool reading{false};
+    uint64_t samplesWritten{0};
+
+    // set by the I/O thread when it has handled a request: the generation of
+    // the request, and the count of samples written before any for it.
+    std::atomic<uint32_t> ackGeneration{0};
+    std::atomic<uint64_t> ackMark{0};
+
+    std::atomic<size_t> underruns{0};
+  };
+
+  // a mark meaning the file for the request could not be read.
+  static constexpr uint64_t kFailedMark{~uint64_t(0)};
+
+  // read up to a vector of frames for the voice into its interleaved buffer.
+  // Returns the number of frames read.
+  size_t readFrames(Stream& s);
+  void handleRequest(const Request& r);
+  bool fillBuffer(Stream& s);
+
+  // submit a service job to the pool, if there is one and no job is pending.
+  void requestService();
+  static void serviceJob(void* pContext);
+
+  std::vector<std::unique_ptr<Stream> > _streams;
+  size_t _maxChannels;
+  Queue<Request> _requests;
+  std::atomic<size_t> _droppedRequests{0};
+  std::vector<float> _readBuffer;
+
+  std::thread _thread;
+  std::atomic<bool> _running{false};
+
+  std::atomic<ThreadPool*> _pPool{nullptr};
+  std::atomic<bool> _serviceQueued{false};
+};
+
+}  // namespace ml
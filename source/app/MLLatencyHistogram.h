@@ -0,0 +1,125 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// LatencyHistogram: counts durations in bins spaced four to an octave, from
+// 1 microsecond up to about 65 milliseconds, for measuring the cost and jitter
+// of periodic tasks like audio callbacks.
+//
+// add() does no allocation or locking, so it can be called from the audio
+// thread, or from several threads at once, while another thread reads the
+// statistics. Reads made while adds are happening may be off by the samples
+// in flight.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace ml
+{
+class LatencyHistogram
+{
+ public:
+  static constexpr size_t kBins{66};
+  static constexpr size_t kBinsPerOctave{4};
+  static constexpr double kMinSeconds{1e-6};
+
+  LatencyHistogram() { clear(); }
+
+  LatencyHistogram(LatencyHistogram const&) = delete;
+  LatencyHistogram& operator=(LatencyHistogram const&) = delete;
+
+  void clear()
+  {
+    for (auto& bin : _bins)
+    {
+      bin.store(0, std::memory_order_relaxed);
+    }
+    _count.store(0, std::memory_order_relaxed);
+    _totalNanoseconds.store(0, std::memory_order_relaxed);
+    _minNanoseconds.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    _maxNanoseconds.store(0, std::memory_order_relaxed);
+  }
+
+  void add(double seconds)
+  {
+    const uint64_t ns = static_cast<uint64_t>(std::max(seconds, 0.) * 1e9);
+    _bins[getBin(seconds)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _totalNanoseconds.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t prevMin = _minNanoseconds.load(std::memory_order_relaxed);
+    while ((ns < prevMin) &&
+           !_minNanoseconds.compare_exchange_weak(prevMin, ns, std::memory_order_relaxed))
+    {
+    }
+    uint64_t prevMax = _maxNanoseconds.load(std::memory_order_relaxed);
+    while ((ns > prevMax) &&
+           !_maxNanoseconds.compare_exchange_weak(prevMax, ns, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  size_t getCount() const { return _count.load(std::memory_order_relaxed); }
+
+  double getMean() const
+  {
+    const size_t n = getCount();
+    return n ? _totalNanoseconds.load(std::memory_order_relaxed) * 1e-9 / n : 0.;
+  }
+
+  double getMin() const
+  {
+    return getCount() ? _minNanoseconds.load(std::memory_order_relaxed) * 1e-9 : 0.;
+  }
+
+  double getMax() const { return _maxNanoseconds.load(std::memory_order_relaxed) * 1e-9; }
+
+  // return the upper edge of the bin containing the given fraction of the
+  // durations, such as 0.99 for the 99th percentile. The top bin has no upper
+  // edge, so the maximum is returned for it.
+  double getPercentile(double fraction) const
+  {
+    const size_t n = getCount();
+    if (!n) return 0.;
+    const double target = std::min(std::max(fraction, 0.), 1.) * n;
+    size_t sum{0};
+    for (size_t b = 0; b < kBins - 1; ++b)
+    {
+      sum += getBinCount(b);
+      if (sum >= target && sum > 0) return std::min(getBinUpperEdge(b), getMax());
+    }
+    return getMax();
+  }
+
+  size_t getBinCount(size_t bin) const { return _bins[bin].load(std::memory_order_relaxed); }
+
+  // bin 0 counts durations under kMinSeconds, and the last bin counts all
+  // durations too long for the others.
+  static double getBinUpperEdge(size_t bin)
+  {
+    if (bin >= kBins - 1) return std::numeric_limits<double>::infinity();
+    return kMinSeconds * std::exp2(static_cast<double>(bin) / kBinsPerOctave);
+  }
+
+  static size_t getBin(double seconds)
+  {
+    if (!(seconds >= kMinSeconds)) return 0;
+    const double octaves = std::log2(seconds / kMinSeconds);
+    return std::min(static_cast<size_t>(octaves * kBinsPerOctave) + 1, kBins - 1);
+  }
+
+ private:
+  std::array<std::atomic<size_t>, kBins> _bins;
+  std::atomic<size_t> _count;
+  std::atomic<uint64_t> _totalNanoseconds;
+  std::atomic<uint64_t> _minNanoseconds;
+  std::atomic<uint64_t> _maxNanoseconds;
+};
+
+}  // namespace ml
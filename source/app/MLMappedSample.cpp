@@ -0,0 +1,282 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLMappedSample.h"
+
+#include <cstring>
+
+#if ML_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ml;
+
+namespace
+{
+uint32_t readLE32(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t readLE16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+// find the float32 sample data in a WAV file. Returns false if the file is not
+// a WAV file in that format.
+bool findWAVFloatData(const uint8_t* pFile, size_t fileSize, size_t* pOffset, size_t* pBytes,
+                      size_t* pChannels, size_t* pSampleRate)
+{
+  constexpr uint16_t kFormatFloat{3};
+  constexpr uint16_t kFormatExtensible{0xFFFE};
+
+  if (fileSize < 12) return false;
+  if (std::memcmp(pFile, "RIFF", 4) || std::memcmp(pFile + 8, "WAVE", 4)) return false;
+
+  bool haveFormat{false};
+  size_t pos = 12;
+  while (pos + 8 <= fileSize)
+  {
+    const uint8_t* pChunk = pFile + pos;
+    const size_t chunkSize = readLE32(pChunk + 4);
+    const size_t dataPos = pos + 8;
+    if (!std::memcmp(pChunk, "fmt ", 4))
+    {
+      if (chunkSize < 16 || dataPos + chunkSize > fileSize) return false;
+      uint16_t format = readLE16(pFile + dataPos);
+      if (format == kFormatExtensible && chunkSize >= 40)
+      {
+        // the format code starts the subformat GUID.
+        format = readLE16(pFile + dataPos + 24);
+      }
+      const uint16_t bitsPerSample = readLE16(pFile + dataPos + 14);
+      if (format != kFormatFloat || bitsPerSample != 32) return false;
+      *pChannels = readLE16(pFile + dataPos + 2);
+      *pSampleRate = readLE32(pFile + dataPos + 4);
+      haveFormat = true;
+    }
+    else if (!std::memcmp(pChunk, "data", 4))
+    {
+      if (!haveFormat || !*pChannels) return false;
+      *pOffset = dataPos;
+      *pBytes = (std::min)(chunkSize, fileSize - dataPos);
+      return true;
+    }
+
+    // chunks are padded to even sizes.
+    pos = dataPos + chunkSize + (chunkSize & 1);
+  }
+  return false;
+}
+}  // namespace
+
+// ----------------------------------------------------------------
+// MappedSampleFile
+
+bool MappedSampleFile::openWAV(const char* path)
+{
+  if (!map(path)) return false;
+
+  size_t offset{0}, bytes{0}, channels{0}, sampleRate{0};
+  if (!findWAVFloatData(_pBase, _fileSize, &offset, &bytes, &channels, &sampleRate) ||
+      (offset % sizeof(float)))
+  {
+    unmap();
+    return false;
+  }
+
+  _view.data = reinterpret_cast<const float*>(_pBase + offset);
+  _view.channels = channels;
+  _view.frames = bytes / sizeof(float) / channels;
+  _view.sampleRate = sampleRate;
+  return true;
+}
+
+bool MappedSampleFile::openRaw(const char* path, size_t channels, size_t sampleRate)
+{
+  if (!channels) return false;
+  if (!map(path)) return false;
+
+  _view.data = reinterpret_cast<const float*>(_pBase);
+  _view.channels = channels;
+  _view.frames = _fileSize / sizeof(float) / channels;
+  _view.sampleRate = sampleRate;
+  return true;
+}
+
+void MappedSampleFile::close()
+{
+  unmap();
+}
+
+#if ML_WINDOWS
+
+bool MappedSampleFile::map(const char* path)
+{
+  unmap();
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!pView)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  _fileHandle = file;
+  _mappingHandle = mapping;
+  _pBase = static_cast<const uint8_t*>(pView);
+  _fileSize = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedSampleFile::unmap()
+{
+  if (_pBase) UnmapViewOfFile(_pBase);
+  if (_mappingHandle) CloseHandle(_mappingHandle);
+  if (_fileHandle) CloseHandle(_fileHandle);
+  _pBase = nullptr;
+  _mappingHandle = _fileHandle = nullptr;
+  _fileSize = 0;
+  _view = SampleView{};
+}
+
+void MappedSampleFile::prefetch(size_t startFrame, size_t frames) const
+{
+#if (_WIN32_WINNT >= 0x0602)
+  if (!isOpen() || startFrame >= _view.frames) return;
+  frames = (std::min)(frames, _view.frames - startFrame);
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<float*>(_view.data + startFrame * _view.channels);
+  range.NumberOfBytes = frames * _view.channels * sizeof(float);
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+#else
+
+bool MappedSampleFile::map(const char* path)
+{
+  unmap();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+  // the mapping keeps its own reference to the file.
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+
+  _pBase = static_cast<const uint8_t*>(p);
+  _fileSize = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void MappedSampleFile::unmap()
+{
+  if (_pBase)
+  {
+    munmap(const_cast<uint8_t*>(_pBase), _fileSize);
+  }
+  _pBase = nullptr;
+  _fileSize = 0;
+  _view = SampleView{};
+}
+
+void MappedSampleFile::prefetch(size_t startFrame, size_t frames) const
+{
+  if (!isOpen() || startFrame >= _view.frames) return;
+  frames = (std::min)(frames, _view.frames - startFrame);
+
+  // madvise() needs a page-aligned start.
+  const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const uint8_t* pStart =
+      reinterpret_cast<const uint8_t*>(_view.data + startFrame * _view.channels);
+  const uint8_t* pEnd = pStart + frames * _view.channels * sizeof(float);
+  const size_t startOffset = (static_cast<size_t>(pStart - _pBase) / pageSize) * pageSize;
+  madvise(const_cast<uint8_t*>(_pBase + startOffset), pEnd - (_pBase + startOffset),
+          MADV_WILLNEED);
+}
+
+#endif
+
+// ----------------------------------------------------------------
+// SampleFileRegistry
+
+template <typename OpenFn>
+std::shared_ptr<const MappedSampleFile> SampleFileRegistry::open(const FileKey& key,
+                                                                 OpenFn openFn)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (auto existing = _files[key].lock()) return existing;
+
+  auto pFile = std::make_shared<MappedSampleFile>();
+  if (!openFn(*pFile))
+  {
+    _files.erase(key);
+    return nullptr;
+  }
+  _files[key] = pFile;
+  return pFile;
+}
+
+std::shared_ptr<const MappedSampleFile> SampleFileRegistry::openWAV(const std::string& path)
+{
+  return open(FileKey{path, 0, 0},
+              [&](MappedSampleFile& f) { return f.openWAV(path.c_str()); });
+}
+
+std::shared_ptr<const MappedSampleFile> SampleFileRegistry::openRaw(const std::string& path,
+                                                                    size_t channels,
+                                                                    size_t sampleRate)
+{
+  return open(FileKey{path, channels, sampleRate},
+              [&](MappedSampleFile& f) { return f.openRaw(path.c_str(), channels, sampleRate); });
+}
+
+size_t SampleFileRegistry::getOpenFiles()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  size_t n{0};
+  for (auto it = _files.begin(); it != _files.end();)
+  {
+    if (it->second.expired())
+    {
+      it = _files.erase(it);
+    }
+    else
+    {
+      ++n;
+      ++it;
+    }
+  }
+  return n;
+}
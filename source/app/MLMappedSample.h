@@ -0,0 +1,97 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// MappedSampleFile: a read-only memory map of a file of float samples, either
+// raw interleaved 32-bit floats or a WAV file in 32-bit float format. The OS
+// reads pages of the file on demand when the data are first touched, so opening
+// even a very large file is fast and only the parts played take up memory.
+// prefetch() can be called ahead of time from a non-audio thread as a hint that
+// a range of frames will be needed soon.
+//
+// Samples are read in the host's byte order, which is little-endian like WAV
+// on all supported platforms.
+//
+// SampleFileRegistry shares one mapping of each file among all its users in the
+// process, such as a number of SignalProcessors.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "MLDSPSample.h"
+#include "MLPlatform.h"
+#include "MLSharedResource.h"
+
+namespace ml
+{
+class MappedSampleFile
+{
+ public:
+  MappedSampleFile() = default;
+  ~MappedSampleFile() { close(); }
+
+  MappedSampleFile(MappedSampleFile const&) = delete;
+  MappedSampleFile& operator=(MappedSampleFile const&) = delete;
+
+  // map a WAV file in 32-bit float format. Returns true on success.
+  bool openWAV(const char* path);
+
+  // map a file of raw, interleaved 32-bit floats. Returns true on success.
+  bool openRaw(const char* path, size_t channels, size_t sampleRate);
+
+  void close();
+
+  bool isOpen() const { return _view.data != nullptr; }
+
+  // the view is valid until the file is closed.
+  const SampleView& getView() const { return _view; }
+
+  // ask the OS to start reading the given range of frames into memory.
+  void prefetch(size_t startFrame, size_t frames) const;
+
+ private:
+  bool map(const char* path);
+  void unmap();
+
+  const uint8_t* _pBase{nullptr};
+  size_t _fileSize{0};
+#if ML_WINDOWS
+  void* _fileHandle{nullptr};
+  void* _mappingHandle{nullptr};
+#endif
+  SampleView _view;
+};
+
+class SampleFileRegistry
+{
+ public:
+  // return a shared, open mapping of the file at the path, mapping it if it is
+  // not already open in the same format. A raw file opened with different
+  // channels or sample rates gets a separate mapping for each. Returns nullptr
+  // if the file can't be mapped. The file is closed when the last pointer to
+  // it is released.
+  std::shared_ptr<const MappedSampleFile> openWAV(const std::string& path);
+  std::shared_ptr<const MappedSampleFile> openRaw(const std::string& path, size_t channels,
+                                                  size_t sampleRate);
+
+  // return the number of files currently open.
+  size_t getOpenFiles();
+
+ private:
+  // path, channels and sample rate. WAV files, which have their format in
+  // the header, have 0 channels and sample rate.
+  using FileKey = std::tuple<std::string, size_t, size_t>;
+
+  template <typename OpenFn>
+  std::shared_ptr<const MappedSampleFile> open(const FileKey& key, OpenFn openFn);
+
+  std::mutex _mutex;
+  std::map<FileKey, std::weak_ptr<const MappedSampleFile> > _files;
+};
+
+}  // namespace ml
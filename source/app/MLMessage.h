@@ -18,7 +18,10 @@ struct Message final
   Value value{};
   uint32_t flags{0};
 
-  Message(Path h = Path(), Value v = Value(), uint32_t f = 0) : address(h), value(v), flags(f) {}
+  Message(Path h = Path(), Value v = Value(), uint32_t f = 0)
+      : address(h), value(std::move(v)), flags(f)
+  {
+  }
 
   explicit operator bool() const { return (address != Path()); }
 };
@@ -0,0 +1,194 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLOfflineRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace ml;
+
+namespace
+{
+ThreadPool::Options poolOptions(size_t threads)
+{
+  // the calling thread renders too, so the pool needs one less thread.
+  ThreadPool::Options options;
+  options.threads = threads - 1;
+  return options;
+}
+}  // namespace
+
+OfflineRenderer::OfflineRenderer(size_t threads)
+    : _threads(threads ? threads : max(std::thread::hardware_concurrency(), 1u)),
+      _pool(poolOptions(_threads))
+{
+}
+
+OfflineRenderer::Result OfflineRenderer::render(Job& job)
+{
+  Result result;
+  const auto startTime = std::chrono::steady_clock::now();
+
+  // a processor supplies any functions not given.
+  ProcessVectorFn processFn = job.processFn;
+  ParamFn paramFn = job.paramFn;
+  TimeFn timeFn = job.timeFn;
+  if (SignalProcessor* pProc = job.pProcessor)
+  {
+    if (!processFn)
+    {
+      processFn = [pProc](MainInputs ins, MainOutputs outs, void*) {
+        pProc->processVector(ins, outs);
+      };
+    }
+    if (!paramFn)
+    {
+      paramFn = [pProc](Path name, float value) {
+        pProc->setParamFromNormalizedValue(name, value);
+      };
+    }
+    if (!timeFn)
+    {
+      timeFn = [pProc](double secs, double ppqPos, double bpm, bool isPlaying, double sampleRate) {
+        pProc->setTimeAndRate(secs, ppqPos, bpm, isPlaying, sampleRate);
+      };
+    }
+  }
+  if (!processFn || !job.outputs || job.sampleRate <= 0.) return result;
+
+  auto byFrame = [](const auto& a, const auto& b) { return a.frame < b.frame; };
+  std::vector<ParamChange> automation = job.automation;
+  std::vector<TimedEvent> events = job.events;
+  std::stable_sort(automation.begin(), automation.end(), byFrame);
+  std::stable_sort(events.begin(), events.end(), byFrame);
+
+  // destinations
+  const size_t sampleRate = static_cast<size_t>(job.sampleRate);
+  AudioFileWriter writer;
+  if (!job.outputPath.empty() &&
+      !writer.open(job.outputPath.c_str(), job.fileType, job.fileFormat, job.outputs, sampleRate))
+  {
+    return result;
+  }
+  if (job.pOutput)
+  {
+    if (job.frames && !resize(*job.pOutput, job.frames, job.outputs)) return result;
+    job.pOutput->channels = job.outputs;
+    job.pOutput->sampleRate = sampleRate;
+  }
+
+  DSPVectorDynamic inputs(job.inputs);
+  DSPVectorDynamic outputs(job.outputs);
+  std::vector<const float*> outputRows(job.outputs);
+  for (size_t c = 0; c < job.outputs; ++c)
+  {
+    outputRows[c] = outputs[c].getConstBuffer();
+  }
+
+  // input Sample channels are deinterleaved into sourceVectors, then copied to
+  // the inputs.
+  const size_t sourceChannels = usable(job.pInput) ? job.pInput->channels : 0;
+  const size_t sourceFrames = sourceChannels ? getFrames(*job.pInput) : 0;
+  DSPVectorDynamic sourceVectors(sourceChannels);
+  std::vector<float*> sourceRows(sourceChannels);
+  for (size_t c = 0; c < sourceChannels; ++c)
+  {
+    sourceRows[c] = sourceVectors[c].getBuffer();
+  }
+
+  const size_t blockFrames =
+      max(job.blockFrames / kFloatsPerDSPVector, size_t(1)) * kFloatsPerDSPVector;
+  size_t nextChange{0};
+  size_t nextEvent{0};
+  bool ok{true};
+
+  for (size_t frame = 0; frame < job.frames; frame += kFloatsPerDSPVector)
+  {
+    const size_t vectorEnd = frame + kFloatsPerDSPVector;
+    const size_t frames = min(job.frames - frame, size_t(kFloatsPerDSPVector));
+
+    if (timeFn && (frame % blockFrames == 0))
+    {
+      const double secs = frame / job.sampleRate;
+      timeFn(secs, secs * job.bpm / 60., job.bpm, job.isPlaying, job.sampleRate);
+    }
+    for (; nextChange < automation.size(); ++nextChange)
+    {
+      const ParamChange& change = automation[nextChange];
+      if (change.frame >= vectorEnd) break;
+      if (paramFn) paramFn(change.name, change.normalizedValue);
+    }
+    for (; nextEvent < events.size(); ++nextEvent)
+    {
+      const TimedEvent& timedEvent = events[nextEvent];
+      if (timedEvent.frame >= vectorEnd) break;
+      if (job.eventFn)
+      {
+        EventsToSignals::Event e = timedEvent.event;
+        e.time = static_cast<int>(timedEvent.frame - frame);
+        job.eventFn(e);
+      }
+    }
+
+    if (sourceChannels && job.inputs)
+    {
+      const size_t framesIn = (frame < sourceFrames) ? min(sourceFrames - frame, frames) : 0;
+      if (framesIn < kFloatsPerDSPVector)
+      {
+        for (size_t c = 0; c < sourceChannels; ++c)
+        {
+          sourceVectors[c] = DSPVector(0.f);
+        }
+      }
+      deinterleave(getConstFramePtr(*job.pInput, min(frame, sourceFrames)), sourceChannels,
+                   sourceRows.data(), framesIn);
+      for (size_t c = 0; c < job.inputs; ++c)
+      {
+        inputs[c] = sourceVectors[c % sourceChannels];
+      }
+    }
+
+    processFn(inputs, outputs, job.processState);
+
+    if (job.pOutput)
+    {
+      interleave(outputRows.data(), job.outputs, getFramePtr(*job.pOutput, frame), frames);
+    }
+    if (writer.isOpen() && (writer.write(outputRows.data(), frames) != frames))
+    {
+      ok = false;
+      break;
+    }
+  }
+
+  if (writer.isOpen())
+  {
+    ok = writer.close() && ok;
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+  result.ok = ok;
+  result.frames = job.frames;
+  result.seconds = elapsed.count();
+  result.realtimeMultiple =
+      (result.seconds > 0.) ? (job.frames / job.sampleRate) / result.seconds : 0.;
+  return result;
+}
+
+std::vector<OfflineRenderer::Result> OfflineRenderer::render(std::vector<Job>& jobs)
+{
+  std::vector<Result> results(jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i)
+  {
+    // if the queue is full, render the job here.
+    if (!_pool.submit([this, &jobs, &results, i]() { results[i] = render(jobs[i]); }))
+    {
+      results[i] = render(jobs[i]);
+    }
+  }
+  _pool.wait();
+  return results;
+}
@@ -0,0 +1,121 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// OfflineRenderer: runs a SignalProcessor or a ProcessVectorFn as fast as
+// possible, without an audio device, and writes the outputs to a Sample, an
+// audio file or both.
+//
+// A render is described by a Job. Parameter changes and events are given
+// with frame times. Parameter changes are applied before the vector that
+// contains their frame, and events are sent before that vector with their
+// time set to the offset within it. Host time is sent at the start of each
+// block of blockFrames, as a host would, so ProcessTime runs the same way it
+// does live. Nothing depends on the speed of the machine, so rendering the
+// same Job twice gives the same result.
+//
+// A list of independent Jobs can be rendered on a number of threads. Each Job
+// runs on one thread, so the Jobs must not share processors or other state.
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "MLAudioFile.h"
+#include "MLEventsToSignals.h"
+#include "MLSignalProcessor.h"
+#include "MLThreadPool.h"
+
+namespace ml
+{
+class OfflineRenderer
+{
+ public:
+  struct ParamChange
+  {
+    size_t frame{0};
+    Path name;
+    float normalizedValue{0.f};
+  };
+
+  struct TimedEvent
+  {
+    size_t frame{0};
+    EventsToSignals::Event event;
+  };
+
+  using ParamFn = std::function<void(Path, float)>;
+  using EventFn = std::function<void(const EventsToSignals::Event&)>;
+  using TimeFn = std::function<void(double secs, double ppqPos, double bpm, bool isPlaying,
+                                    double sampleRate)>;
+
+  struct Job
+  {
+    // the processor to run. If pProcessor is set, its processVector() is
+    // called, parameter changes go to setParamFromNormalizedValue() and time
+    // goes to setTimeAndRate(), unless other functions are given below.
+    SignalProcessor* pProcessor{nullptr};
+    ProcessVectorFn processFn;
+    void* processState{nullptr};
+    ParamFn paramFn;
+    EventFn eventFn;
+    TimeFn timeFn;
+
+    size_t inputs{0};
+    size_t outputs{2};
+    double sampleRate{48000.};
+    size_t frames{0};
+
+    // host time, sent every blockFrames frames.
+    double bpm{120.};
+    bool isPlaying{true};
+    size_t blockFrames{512};
+
+    // changes and events, in any order.
+    std::vector<ParamChange> automation;
+    std::vector<TimedEvent> events;
+
+    // interleaved input. Input channel c reads channel c % channels of the
+    // Sample, and frames after its end are zero.
+    const Sample* pInput{nullptr};
+
+    // destinations for the outputs: a Sample, a file, or both.
+    Sample* pOutput{nullptr};
+    std::string outputPath;
+    AudioFileType fileType{kWAVFile};
+    SampleFormat fileFormat{kFloat32};
+  };
+
+  struct Result
+  {
+    bool ok{false};
+    size_t frames{0};
+    double seconds{0.};
+
+    // the duration rendered divided by the time it took.
+    double realtimeMultiple{0.};
+  };
+
+  // threads: the most threads used to render lists of Jobs, including the
+  // calling thread, or 0 to use one per hardware thread. The others are kept
+  // in a ThreadPool.
+  explicit OfflineRenderer(size_t threads = 0);
+  ~OfflineRenderer() = default;
+
+  // render a Job on the calling thread.
+  Result render(Job& job);
+
+  // render Jobs in parallel. The results are in the order of the Jobs. Only
+  // one thread at a time should call this.
+  std::vector<Result> render(std::vector<Job>& jobs);
+
+  size_t getThreads() const { return _threads; }
+
+ private:
+  size_t _threads;
+  ThreadPool _pool;
+};
+
+}  // namespace ml
@@ -0,0 +1,117 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLParallelVoiceRenderer.h"
+
+#include <algorithm>
+
+using namespace ml;
+
+ParallelVoiceRenderer::ParallelVoiceRenderer(size_t workers, size_t maxVoices,
+                                             size_t voicesPerGroup, int spinMicroseconds)
+    : _maxVoices(maxVoices),
+      _voicesPerGroup(voicesPerGroup ? voicesPerGroup : 1),
+      _parking(spinMicroseconds, 1)
+{
+  // a deque never holds more tasks than there are groups.
+  const size_t maxGroups = (_maxVoices + _voicesPerGroup - 1) / _voicesPerGroup;
+  for (size_t i = 0; i < workers + 1; ++i)
+  {
+    _deques.push_back(std::make_unique<WorkStealingDeque<Task> >(maxGroups + 1));
+  }
+  for (size_t i = 0; i < workers; ++i)
+  {
+    _threads.emplace_back([this, i]() { workerLoop(i + 1); });
+  }
+}
+
+ParallelVoiceRenderer::~ParallelVoiceRenderer()
+{
+  _parking.stop();
+  for (auto& t : _threads)
+  {
+    t.join();
+  }
+}
+
+void ParallelVoiceRenderer::renderTasks(size_t voices)
+{
+  const size_t groups = (voices + _voicesPerGroup - 1) / _voicesPerGroup;
+  if (!groups) return;
+  _voices = voices;
+  _groupsRemaining.store(groups, std::memory_order_relaxed);
+  _deques[0]->push(Task{0, static_cast<uint32_t>(groups)});
+
+  // wake the workers.
+  _generation.fetch_add(1, std::memory_order_seq_cst);
+  _parking.wake();
+
+  // render voices until all are done, including those other threads took.
+  Task task;
+  while (_groupsRemaining.load(std::memory_order_acquire))
+  {
+    if (findTask(0, task))
+    {
+      runTask(0, task);
+    }
+  }
+}
+
+bool ParallelVoiceRenderer::findTask(size_t participant, Task& task)
+{
+  if (_deques[participant]->pop(task)) return true;
+  const size_t n = _deques.size();
+  for (size_t i = 1; i < n; ++i)
+  {
+    if (_deques[(participant + i) % n]->steal(task)) return true;
+  }
+  return false;
+}
+
+void ParallelVoiceRenderer::runTask(size_t participant, Task task)
+{
+  // split off the upper half for other threads until one group is left.
+  while (task.end - task.begin > 1)
+  {
+    const uint32_t middle = task.begin + (task.end - task.begin) / 2;
+    if (!_deques[participant]->push(Task{middle, task.end})) break;
+    task.end = middle;
+  }
+
+  const size_t firstVoice = task.begin * _voicesPerGroup;
+  const size_t endVoice = std::min(size_t(task.end) * _voicesPerGroup, _voices);
+  for (size_t v = firstVoice; v < endVoice; ++v)
+  {
+    _invoke(_pContext, v);
+  }
+
+  const size_t groups = task.end - task.begin;
+  if (participant)
+  {
+    _workerGroups.fetch_add(groups, std::memory_order_relaxed);
+  }
+  _groupsRemaining.fetch_sub(groups, std::memory_order_acq_rel);
+}
+
+void ParallelVoiceRenderer::workerLoop(size_t participant)
+{
+  Task task;
+  auto lastWorkTime = WorkerParking::Clock::now();
+  while (_parking.running())
+  {
+    if (findTask(participant, task))
+    {
+      runTask(participant, task);
+      lastWorkTime = WorkerParking::Clock::now();
+      continue;
+    }
+
+    // sleep until the next render, then spin again for the renders that
+    // follow.
+    const uint64_t generation = _generation.load(std::memory_order_seq_cst);
+    _parking.park(lastWorkTime, [&]() {
+      return _generation.load(std::memory_order_seq_cst) != generation;
+    });
+  }
+}
@@ -0,0 +1,111 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ParallelVoiceRenderer: renders the voices of a synth on a fixed set of
+// worker threads within one process call, so polyphony is not limited to
+// what one core can do in a buffer period.
+//
+// Voices are rendered in groups of voicesPerGroup. render() pushes one task
+// covering all the groups to the calling thread's WorkStealingDeque. Whoever
+// runs a task splits it in half, pushing the upper half to its own deque,
+// until one group is left, so the other threads find work by stealing. The
+// calling thread renders voices too, and render() returns only once every
+// voice is done, so the results can be mixed right away.
+//
+// The workers are started by the constructor. render() does not allocate or
+// lock, so it can be called from the audio thread. Idle workers spin for a
+// while before sleeping, so voices rendered every process call get going
+// quickly. The render function is called for each voice index from multiple
+// threads at once, so it must only touch that voice's state.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MLQueue.h"
+#include "MLWorkerParking.h"
+
+namespace ml
+{
+class ParallelVoiceRenderer
+{
+ public:
+  // workers: the number of threads to start in addition to the calling
+  // thread. With 0, voices are rendered in order on the calling thread.
+  // spinMicroseconds: how long an idle worker looks for work before sleeping.
+  ParallelVoiceRenderer(size_t workers, size_t maxVoices, size_t voicesPerGroup = 1,
+                        int spinMicroseconds = 200);
+  ~ParallelVoiceRenderer();
+
+  ParallelVoiceRenderer(ParallelVoiceRenderer const&) = delete;
+  ParallelVoiceRenderer& operator=(ParallelVoiceRenderer const&) = delete;
+
+  // call fn(v) for each voice v in [0, voices) and wait until all are done.
+  // voices must not be more than the maxVoices given to the constructor.
+  template <typename Fn>
+  void render(size_t voices, Fn&& fn)
+  {
+    using FnType = std::remove_reference_t<Fn>;
+    assert(voices <= _maxVoices && "ParallelVoiceRenderer: too many voices");
+    if (_threads.empty())
+    {
+      for (size_t v = 0; v < voices; ++v)
+      {
+        fn(v);
+      }
+      return;
+    }
+    _pContext = const_cast<void*>(static_cast<const void*>(&fn));
+    _invoke = [](void* pContext, size_t v) { (*static_cast<FnType*>(pContext))(v); };
+    renderTasks(voices);
+  }
+
+  size_t getWorkers() const { return _threads.size(); }
+  size_t getVoicesPerGroup() const { return _voicesPerGroup; }
+
+  // the number of groups rendered by the workers rather than the calling
+  // thread since the renderer was made.
+  size_t getWorkerGroups() const { return _workerGroups.load(std::memory_order_relaxed); }
+
+ private:
+  // a range of voice groups [begin, end).
+  struct Task
+  {
+    uint32_t begin{0};
+    uint32_t end{0};
+  };
+
+  void renderTasks(size_t voices);
+  void workerLoop(size_t participant);
+  bool findTask(size_t participant, Task& task);
+  void runTask(size_t participant, Task task);
+
+  size_t _maxVoices;
+  size_t _voicesPerGroup;
+  size_t _voices{0};
+
+  // the function of the current render.
+  void* _pContext{nullptr};
+  void (*_invoke)(void*, size_t){nullptr};
+
+  // deque 0 belongs to the calling thread and deque i + 1 to worker i.
+  std::vector<std::unique_ptr<WorkStealingDeque<Task> > > _deques;
+  std::vector<std::thread> _threads;
+
+  std::atomic<size_t> _groupsRemaining{0};
+  std::atomic<size_t> _workerGroups{0};
+  std::atomic<uint64_t> _generation{0};
+
+  // render() is called from the audio thread, so it wakes workers without
+  // locking, and they recheck for a new render every millisecond.
+  WorkerParking _parking;
+};
+
+}  // namespace ml
@@ -10,7 +10,10 @@
 
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace ml
@@ -32,6 +35,7 @@ class Queue final
     return (exp);
   }
 
+  // not thread-safe: call before using the queue.
   void resize(size_t capacity)
   {
     // when _readIndex = _writeIndex the queue is considered empty. So
@@ -40,9 +44,13 @@ class Queue final
     // will contain that many elements.
     size_t powerOfTwoSize = 1ULL << bitsToContain((int)capacity + 1);
 
+    _data.clear();
     _data.resize(powerOfTwoSize);
     _sizeMask = powerOfTwoSize - 1;
-    clear();
+    _writeIndex.store(0, std::memory_order_relaxed);
+    _readIndex.store(0, std::memory_order_relaxed);
+    _cachedReadIndex = 0;
+    _cachedWriteIndex = 0;
   }
 
   size_t size() { return _data.size(); }
@@ -51,23 +59,62 @@ class Queue final
   {
     const auto currentWriteIndex = _writeIndex.load(std::memory_order_relaxed);
     const auto nextWriteIndex = increment(currentWriteIndex);
-    if (nextWriteIndex != _readIndex.load(std::memory_order_acquire))
+    if (!hasRoomFor(nextWriteIndex)) return false;
+    _data[currentWriteIndex] = item;
+    _writeIndex.store(nextWriteIndex, std::memory_order_release);
+    return true;
+  }
+
+  bool push(Element&& item)
+  {
+    const auto currentWriteIndex = _writeIndex.load(std::memory_order_relaxed);
+    const auto nextWriteIndex = increment(currentWriteIndex);
+    if (!hasRoomFor(nextWriteIndex)) return false;
+    _data[currentWriteIndex] = std::move(item);
+    _writeIndex.store(nextWriteIndex, std::memory_order_release);
+    return true;
+  }
+
+  // make an Element from the arguments and push it.
+  template <typename... Args>
+  bool emplace(Args&&... args)
+  {
+    const auto currentWriteIndex = _writeIndex.load(std::memory_order_relaxed);
+    const auto nextWriteIndex = increment(currentWriteIndex);
+    if (!hasRoomFor(nextWriteIndex)) return false;
+    _data[currentWriteIndex] = Element(std::forward<Args>(args)...);
+    _writeIndex.store(nextWriteIndex, std::memory_order_release);
+    return true;
+  }
+
+  // push up to n elements, making them visible to the reader all at once.
+  // Returns the number pushed.
+  size_t pushN(const Element* pItems, size_t n)
+  {
+    const auto currentWriteIndex = _writeIndex.load(std::memory_order_relaxed);
+    size_t room = (_cachedReadIndex - currentWriteIndex - 1) & _sizeMask;
+    if (room < n)
+    {
+      _cachedReadIndex = _readIndex.load(std::memory_order_acquire);
+      room = (_cachedReadIndex - currentWriteIndex - 1) & _sizeMask;
+    }
+    n = (n < room) ? n : room;
+    for (size_t i = 0; i < n; ++i)
     {
-      _data[currentWriteIndex] = item;
-      _writeIndex.store(nextWriteIndex, std::memory_order_release);
-      return true;
+      _data[(currentWriteIndex + i) & _sizeMask] = pItems[i];
     }
-    return false;
+    _writeIndex.store((currentWriteIndex + n) & _sizeMask, std::memory_order_release);
+    return n;
   }
 
   bool pop(Element& item)
   {
     const auto currentReadIndex = _readIndex.load(std::memory_order_relaxed);
-    if (currentReadIndex == _writeIndex.load(std::memory_order_acquire))
+    if (!hasElementAt(currentReadIndex))
     {
       return false;  // empty queue
     }
-    item = _data[currentReadIndex];
+    item = std::move(_data[currentReadIndex]);
     _readIndex.store(increment(currentReadIndex), std::memory_order_release);
     return true;
   }
@@ -75,15 +122,35 @@ class Queue final
   Element pop()
   {
     const auto currentReadIndex = _readIndex.load(std::memory_order_relaxed);
-    if (currentReadIndex == _writeIndex.load(std::memory_order_acquire))
+    if (!hasElementAt(currentReadIndex))
     {
       return Element();  // empty queue, return null object
     }
-    Element r = _data[currentReadIndex];
+    Element r = std::move(_data[currentReadIndex]);
     _readIndex.store(increment(currentReadIndex), std::memory_order_release);
     return r;
   }
 
+  // pop up to n elements, freeing their space for the writer all at once.
+  // Returns the number popped.
+  size_t popN(Element* pItems, size_t n)
+  {
+    const auto currentReadIndex = _readIndex.load(std::memory_order_relaxed);
+    size_t available = (_cachedWriteIndex - currentReadIndex) & _sizeMask;
+    if (available < n)
+    {
+      _cachedWriteIndex = _writeIndex.load(std::memory_order_acquire);
+      available = (_cachedWriteIndex - currentReadIndex) & _sizeMask;
+    }
+    n = (n < available) ? n : available;
+    for (size_t i = 0; i < n; ++i)
+    {
+      pItems[i] = std::move(_data[(currentReadIndex + i) & _sizeMask]);
+    }
+    _readIndex.store((currentReadIndex + n) & _sizeMask, std::memory_order_release);
+    return n;
+  }
+
   void clear()
   {
     Element dummy;
@@ -116,9 +183,260 @@ class Queue final
  private:
   size_t increment(size_t idx) const { return (idx + 1) & _sizeMask; }
 
+  // the writer and reader each keep a copy of the other's index, and only
+  // read the shared one when the copy says the queue is full or empty.
+  bool hasRoomFor(size_t nextWriteIndex)
+  {
+    if (nextWriteIndex != _cachedReadIndex) return true;
+    _cachedReadIndex = _readIndex.load(std::memory_order_acquire);
+    return nextWriteIndex != _cachedReadIndex;
+  }
+
+  bool hasElementAt(size_t readIndex)
+  {
+    if (readIndex != _cachedWriteIndex) return true;
+    _cachedWriteIndex = _writeIndex.load(std::memory_order_acquire);
+    return readIndex != _cachedWriteIndex;
+  }
+
   std::vector<Element> _data;
   size_t _sizeMask;
-  std::atomic<size_t> _writeIndex{0};
-  std::atomic<size_t> _readIndex{0};
+
+  // the writer's and reader's indices are on separate cache lines, so they
+  // don't slow each other down.
+  alignas(64) std::atomic<size_t> _writeIndex{0};
+  size_t _cachedReadIndex{0};
+  alignas(64) std::atomic<size_t> _readIndex{0};
+  size_t _cachedWriteIndex{0};
+};
+
+// A bounded MPMC Queue, with the same interface as Queue, for when elements
+// may be pushed or popped from more than one thread at a time. Each slot has
+// a sequence number that says whether it is ready to be written or read, so
+// producers and consumers only contend on their own positions.
+// based on
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename Element>
+class MPMCQueue final
+{
+ public:
+  MPMCQueue(size_t size) { resize(size); }
+
+  ~MPMCQueue() {}
+
+  // not thread-safe: call before using the queue.
+  void resize(size_t capacity)
+  {
+    size_t powerOfTwoSize = 2;
+    while (powerOfTwoSize < capacity) powerOfTwoSize <<= 1;
+    _slots = std::make_unique<Slot[]>(powerOfTwoSize);
+    _sizeMask = powerOfTwoSize - 1;
+    for (size_t i = 0; i < powerOfTwoSize; ++i)
+    {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _writeIndex.store(0, std::memory_order_relaxed);
+    _readIndex.store(0, std::memory_order_relaxed);
+  }
+
+  size_t size() { return _sizeMask + 1; }
+
+  bool push(const Element& item)
+  {
+    size_t index;
+    Slot* pSlot = claimWriteSlot(index);
+    if (!pSlot) return false;
+    pSlot->data = item;
+    pSlot->sequence.store(index + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(Element&& item)
+  {
+    size_t index;
+    Slot* pSlot = claimWriteSlot(index);
+    if (!pSlot) return false;
+    pSlot->data = std::move(item);
+    pSlot->sequence.store(index + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(Element& item)
+  {
+    size_t index = _readIndex.load(std::memory_order_relaxed);
+    Slot* pSlot;
+    while (true)
+    {
+      pSlot = &_slots[index & _sizeMask];
+      const size_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index + 1);
+      if (diff == 0)
+      {
+        if (_readIndex.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0)
+      {
+        return false;  // empty queue
+      }
+      else
+      {
+        index = _readIndex.load(std::memory_order_relaxed);
+      }
+    }
+    item = std::move(pSlot->data);
+    pSlot->sequence.store(index + _sizeMask + 1, std::memory_order_release);
+    return true;
+  }
+
+  Element pop()
+  {
+    Element r;
+    if (!pop(r)) return Element();  // empty queue, return null object
+    return r;
+  }
+
+  void clear()
+  {
+    Element dummy;
+    while (pop(dummy))
+      ;
+  }
+
+  // with other threads pushing and popping, this is only an estimate.
+  size_t elementsAvailable() const
+  {
+    const size_t w = _writeIndex.load(std::memory_order_acquire);
+    const size_t r = _readIndex.load(std::memory_order_acquire);
+    return (w > r) ? w - r : 0;
+  }
+
+  bool wasEmpty() const { return elementsAvailable() == 0; }
+
+  bool wasFull() const { return elementsAvailable() > _sizeMask; }
+
+ private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence{0};
+    Element data{};
+  };
+
+  Slot* claimWriteSlot(size_t& index)
+  {
+    index = _writeIndex.load(std::memory_order_relaxed);
+    while (true)
+    {
+      Slot* pSlot = &_slots[index & _sizeMask];
+      const size_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(index);
+      if (diff == 0)
+      {
+        if (_writeIndex.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+          return pSlot;
+      }
+      else if (diff < 0)
+      {
+        return nullptr;  // full queue
+      }
+      else
+      {
+        index = _writeIndex.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::unique_ptr<Slot[]> _slots;
+  size_t _sizeMask{0};
+  alignas(64) std::atomic<size_t> _writeIndex{0};
+  alignas(64) std::atomic<size_t> _readIndex{0};
+};
+
+// A fixed-size Chase-Lev work-stealing deque.
+// One thread owns the deque and pushes and pops at the bottom. Any number of
+// other threads can steal from the top. Nothing allocates after resize(), so
+// it can be used from the audio thread. Elements must be trivially copyable.
+// based on
+// https://fzn.fr/readings/ppopp13.pdf
+template <typename Element>
+class WorkStealingDeque final
+{
+ public:
+  WorkStealingDeque(size_t capacity) { resize(capacity); }
+
+  ~WorkStealingDeque() {}
+
+  // not thread-safe: call before using the deque.
+  void resize(size_t capacity)
+  {
+    size_t powerOfTwoSize = 1;
+    while (powerOfTwoSize < capacity) powerOfTwoSize <<= 1;
+    _data = std::vector<std::atomic<Element> >(powerOfTwoSize);
+    _sizeMask = powerOfTwoSize - 1;
+    _top.store(0);
+    _bottom.store(0);
+  }
+
+  size_t size() const { return _data.size(); }
+
+  // owner only.
+  bool push(const Element& item)
+  {
+    const int64_t b = _bottom.load(std::memory_order_relaxed);
+    const int64_t t = _top.load(std::memory_order_acquire);
+    if (b - t > static_cast<int64_t>(_sizeMask)) return false;
+    _data[b & _sizeMask].store(item, std::memory_order_relaxed);
+    _bottom.store(b + 1, std::memory_order_release);
+    return true;
+  }
+
+  // owner only. Takes the most recently pushed element.
+  bool pop(Element& item)
+  {
+    const int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = _top.load(std::memory_order_relaxed);
+    bool found = (t <= b);
+    if (found)
+    {
+      item = _data[b & _sizeMask].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+        // the last element: race any thieves for it.
+        found = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return found;
+  }
+
+  // any thread. Takes the oldest element. Can fail when racing another
+  // thread even if the deque is not empty.
+  bool steal(Element& item)
+  {
+    int64_t t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = _bottom.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    item = _data[t & _sizeMask].load(std::memory_order_relaxed);
+    return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+  bool wasEmpty() const
+  {
+    return _bottom.load(std::memory_order_relaxed) <= _top.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::vector<std::atomic<Element> > _data;
+  size_t _sizeMask{0};
+  std::atomic<int64_t> _top{0};
+  std::atomic<int64_t> _bottom{0};
 };
 };  // namespace ml
@@ -3,8 +3,20 @@
 // Distributed under the MIT license: http://madrona-labs.mit-license.org/
 
 // RtAudioProcessor: adaptor from RtAudio's main loop to madronalib vector processing
+//
+// With a null device mode set, no audio device is opened. Instead a thread of our own calls the
+// RtAudio callback, either once per buffer period like a device or as fast as possible. This
+// runs the whole VectorProcessBuffer -> processVector path on machines without audio hardware,
+// and the time taken by each callback is collected in a LatencyHistogram either way.
 
 #pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "MLLatencyHistogram.h"
 #include "MLSignalProcessor.h"
 #include "RtAudio.h"
 #include "mldsp.h"
@@ -20,6 +32,7 @@ struct RtAudioProcessData
   size_t nOutputs;
   int sampleRate;
   unsigned int bufferFrames{512};
+  LatencyHistogram* pCallbackTimes{nullptr};
 };
 
 // adapt the RtAudio process routine to a madronalib function operating on DSPBuffers.
@@ -36,6 +49,7 @@ inline int RtAudioCallbackFn(void* outputBuffer, void* inputBuffer, unsigned int
   float* pOutputBuffer = reinterpret_cast<float*>(outputBuffer);
 
   if (status) std::cout << "Stream over/underflow detected." << std::endl;
+  const auto callbackStart = std::chrono::steady_clock::now();
 
   // make pointers to uninterlaced input and output frames for each channel.
   const float* inputs[kMaxIOChannels];
@@ -56,6 +70,12 @@ inline int RtAudioCallbackFn(void* outputBuffer, void* inputBuffer, unsigned int
   // do the buffered processing.
   pData->pProcessBuffer->process(inputs, outputs, nBufferFrames, pData->processFn,
                                  pData->processState);
+
+  if (pData->pCallbackTimes)
+  {
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - callbackStart;
+    pData->pCallbackTimes->add(elapsed.count());
+  }
   return 0;
 }
 
@@ -76,6 +96,34 @@ struct RtAudioProcessor : public SignalProcessor, public Actor
   // the RtAudio controller
   RtAudio _adac;
 
+  enum NullDeviceMode
+  {
+    kNullDeviceOff = 0,
+
+    // call back once per buffer period, as a device would.
+    kNullDeviceRealtime,
+
+    // call back as fast as possible.
+    kNullDeviceFlatOut
+  };
+
+  static constexpr std::chrono::microseconds kNullDeviceSpinTime{500};
+
+  NullDeviceMode _nullDeviceMode{kNullDeviceOff};
+  std::thread _nullDeviceThread;
+  std::atomic<bool> _nullDeviceRunning{false};
+
+  // the null device's buffers, one channel after another. After runNullDevice() returns, the
+  // output buffer holds the output of the last callback.
+  std::vector<float> _nullDeviceInput;
+  std::vector<float> _nullDeviceOutput;
+
+  // timing statistics. The wakeup lateness and xruns are only measured by the realtime null
+  // device, where an xrun is a callback that ends after the next buffer is due.
+  LatencyHistogram _callbackTimes;
+  LatencyHistogram _wakeupLateness;
+  std::atomic<size_t> _xruns{0};
+
   // the RtAudioProcessor constructor just fills in the data struct with everything needed to run
   // the DSP graph. processFn points to a function that will be called by the VectorProcessBuffer.
   // processState points to any persistent state that needs to be sent to the function. This can be
@@ -100,15 +148,119 @@ struct RtAudioProcessor : public SignalProcessor, public Actor
     _processData.nInputs = nInputs;
     _processData.nOutputs = nOutputs;
     _processData.sampleRate = sampleRate;
+    _processData.pCallbackTimes = &_callbackTimes;
+  }
+
+  ~RtAudioProcessor()
+  {
+    stopNullDevice();
+    Actor::stop();
+  }
+
+  // use a null device instead of audio hardware. Call before startAudio().
+  inline void setNullDeviceMode(NullDeviceMode mode) { _nullDeviceMode = mode; }
+
+  // call the callback from the calling thread as the null device does, until the given number of
+  // callbacks have been made or stopAudio() is called. If callbacks is 0, run until stopped.
+  // Returns the number of callbacks made. In kNullDeviceFlatOut mode with a fixed number of
+  // callbacks, this is a deterministic benchmark of the processing. With the null device mode
+  // off, makes no callbacks and returns 0.
+  inline size_t runNullDevice(size_t callbacks)
+  {
+    if (_nullDeviceMode == kNullDeviceOff) return 0;
+    _nullDeviceRunning = true;
+    return nullDeviceLoop(callbacks);
+  }
+
+  inline size_t nullDeviceLoop(size_t callbacks)
+  {
+    using namespace std::chrono;
+    const unsigned int frames = _processData.bufferFrames;
+    _nullDeviceInput.assign(_processData.nInputs * frames, 0.f);
+    _nullDeviceOutput.assign(_processData.nOutputs * frames, 0.f);
+    const auto period = duration_cast<steady_clock::duration>(
+        duration<double>(static_cast<double>(frames) / _processData.sampleRate));
+    const bool realtime = (_nullDeviceMode == kNullDeviceRealtime);
+
+    double streamTime{0.};
+    RtAudioStreamStatus status{0};
+    auto deadline = steady_clock::now();
+    size_t n{0};
+    while (_nullDeviceRunning && (!callbacks || (n < callbacks)))
+    {
+      if (realtime)
+      {
+        // sleeping can wake late by a fraction of a millisecond, so sleep until just before the
+        // deadline and then yield until it passes.
+        std::this_thread::sleep_until(deadline - kNullDeviceSpinTime);
+        while (steady_clock::now() < deadline)
+        {
+          std::this_thread::yield();
+        }
+        const duration<double> lateness = steady_clock::now() - deadline;
+        _wakeupLateness.add(lateness.count());
+      }
+
+      RtAudioCallbackFn(_nullDeviceOutput.data(), _nullDeviceInput.data(), frames, streamTime,
+                        status, &_processData);
+      streamTime += static_cast<double>(frames) / _processData.sampleRate;
+      status = 0;
+      n++;
+
+      if (realtime)
+      {
+        // skip any buffers that were due while the callback was running.
+        deadline += period;
+        const auto now = steady_clock::now();
+        if (now > deadline)
+        {
+          _xruns++;
+          status = RTAUDIO_OUTPUT_UNDERFLOW;
+          deadline = now;
+        }
+      }
+    }
+    return n;
+  }
+
+  inline void stopNullDevice()
+  {
+    _nullDeviceRunning = false;
+    if (_nullDeviceThread.joinable())
+    {
+      _nullDeviceThread.join();
+    }
   }
 
-  ~RtAudioProcessor() = default;
+  inline void printTimingReport()
+  {
+    auto printHistogram = [](const char* name, const LatencyHistogram& h) {
+      std::cout << name << ": " << h.getCount() << " samples, mean " << h.getMean() * 1e6
+                << " us, median " << h.getPercentile(0.5) * 1e6 << " us, 99% "
+                << h.getPercentile(0.99) * 1e6 << " us, max " << h.getMax() * 1e6 << " us\n";
+    };
+    printHistogram("callback time", _callbackTimes);
+    if (_nullDeviceMode == kNullDeviceRealtime)
+    {
+      printHistogram("wakeup lateness", _wakeupLateness);
+      std::cout << "xruns: " << _xruns << "\n";
+    }
+  }
 
   inline int startAudio()
   {
+    if (_nullDeviceMode != kNullDeviceOff)
+    {
+      std::cout << "[RtAudioProcessor] running null device.\n";
+      stopNullDevice();
+      _nullDeviceRunning = true;
+      _nullDeviceThread = std::thread{[this]() { nullDeviceLoop(0); }};
+      return 1;
+    }
+
     if (_adac.getDeviceCount() < 1)
     {
-      std::cout << "\nNo audio devices found!\n";
+      std::cout << "\nNo audio devices found! setNullDeviceMode() runs without one.\n";
       return 0;
     }
     
@@ -164,7 +316,10 @@ struct RtAudioProcessor : public SignalProcessor, public Actor
     char input;
 
     // Test RtAudio functionality for reporting latency.
-    std::cout << "\nStream latency = " << _adac.getStreamLatency() << " frames" << std::endl;
+    if (_nullDeviceMode == kNullDeviceOff)
+    {
+      std::cout << "\nStream latency = " << _adac.getStreamLatency() << " frames" << std::endl;
+    }
     std::cout << "sample rate: " << _processData.sampleRate << "\n";
 
     // wait for enter key.
@@ -175,6 +330,13 @@ struct RtAudioProcessor : public SignalProcessor, public Actor
 
   inline void stopAudio()
   {
+    if (_nullDeviceMode != kNullDeviceOff)
+    {
+      stopNullDevice();
+      printTimingReport();
+      return;
+    }
+
     if (RTAUDIO_NO_ERROR !=
         _adac.stopStream())
     {
@@ -6,34 +6,195 @@
 
 using namespace ml;
 
+// PublishedSignal readers copy frames that the writer may be overwriting at
+// the same time, as in any seqlock, and drop the torn frames afterwards. This
+// race is intentional, so ThreadSanitizer is told to ignore the readers' copies.
+#if defined(__SANITIZE_THREAD__)
+#define ML_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define ML_TSAN 1
+#endif
+#endif
+
+#if ML_TSAN
+extern "C" void AnnotateIgnoreReadsBegin(const char* file, int line);
+extern "C" void AnnotateIgnoreReadsEnd(const char* file, int line);
+#define ML_SEQLOCK_COPY_BEGIN() AnnotateIgnoreReadsBegin(__FILE__, __LINE__)
+#define ML_SEQLOCK_COPY_END() AnnotateIgnoreReadsEnd(__FILE__, __LINE__)
+#else
+#define ML_SEQLOCK_COPY_BEGIN()
+#define ML_SEQLOCK_COPY_END()
+#endif
+
 // SignalProcessor::PublishedSignal
 
-SignalProcessor::PublishedSignal::PublishedSignal(int maxFrames, int maxVoices, int channels, int octavesDown)
-  : _channels(channels), maxFrames_(maxFrames), octavesDown_(octavesDown)
+SignalProcessor::PublishedSignal::PublishedSignal(int maxFrames, int maxVoices, int channels,
+                                                  int octavesDown)
+    : _channels(max(channels, 1)), _maxVoices(max(maxVoices, 1)), _octavesDown(max(octavesDown, 0))
+{
+  // the ring holds at least one vector of every voice.
+  const size_t minFrames = max(size_t(max(maxFrames, 0)), kFloatsPerDSPVector) * _maxVoices;
+  _capacity = size_t(1) << bitsToContain(static_cast<int>(minFrames));
+  _ring.resize(_capacity * _channels);
+
+  if (_octavesDown)
+  {
+    for (size_t i = 0; i < _maxVoices * _channels; ++i)
+    {
+      _downsamplers.emplace_back(_octavesDown);
+    }
+    _pending.resize(_maxVoices * _channels);
+    _pendingFrames.resize(_maxVoices);
+    _downsampled.resize(_channels);
+  }
+  _inputRows.resize(_channels);
+  _outputRows.resize(_channels);
+  _wrapRows.resize(_channels);
+}
+
+void SignalProcessor::PublishedSignal::write(const float* const* pRows, size_t frames,
+                                             size_t voice)
+{
+  if (!_octavesDown)
+  {
+    writeToRing(pRows, frames);
+    return;
+  }
+
+  // gather frames for this voice until there is a vector to filter.
+  voice = min(voice, _maxVoices - 1);
+  const size_t firstRow = voice * _channels;
+  size_t& pending = _pendingFrames[voice];
+  size_t done{0};
+  while (done < frames)
+  {
+    const size_t n = min(frames - done, kFloatsPerDSPVector - pending);
+    for (size_t c = 0; c < _channels; ++c)
+    {
+      std::copy(pRows[c] + done, pRows[c] + done + n,
+                _pending[firstRow + c].getBuffer() + pending);
+    }
+    pending += n;
+    done += n;
+
+    if (pending == kFloatsPerDSPVector)
+    {
+      pending = 0;
+      bool ready{false};
+      for (size_t c = 0; c < _channels; ++c)
+      {
+        Downsampler& d = _downsamplers[firstRow + c];
+        ready = d.write(_pending[firstRow + c]);
+        if (ready)
+        {
+          _downsampled[c] = d.read();
+        }
+      }
+      if (ready)
+      {
+        for (size_t c = 0; c < _channels; ++c)
+        {
+          _outputRows[c] = _downsampled[c].getConstBuffer();
+        }
+        writeToRing(_outputRows.data(), kFloatsPerDSPVector);
+      }
+    }
+  }
+}
+
+void SignalProcessor::PublishedSignal::writeToRing(const float* const* pRows, size_t frames)
 {
-  voiceRotateBuffer.resize(maxFrames * channels);
-  _buffer.resize(maxFrames * channels * maxVoices);
+  frames = min(frames, _capacity);
+  const uint64_t start = _writeEnd.load(std::memory_order_relaxed);
+  _writeStart.store(start + frames, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // transpose the channels into frames, in two parts if the ring wraps.
+  const size_t startIdx = static_cast<size_t>(start & (_capacity - 1));
+  const size_t frames1 = min(frames, _capacity - startIdx);
+  interleave(pRows, _channels, _ring.data() + startIdx * _channels, frames1);
+  if (frames1 < frames)
+  {
+    for (size_t c = 0; c < _channels; ++c)
+    {
+      _wrapRows[c] = pRows[c] + frames1;
+    }
+    interleave(_wrapRows.data(), _channels, _ring.data(), frames - frames1);
+  }
+
+  _writeEnd.store(start + frames, std::memory_order_release);
 }
 
-size_t SignalProcessor::PublishedSignal::readLatest(float* pDest, size_t framesRequested)
+SignalProcessor::PublishedSignal::ReadCursor SignalProcessor::PublishedSignal::getReadCursor()
+    const
 {
-  size_t floatsAvailable = getReadAvailable();
-  if (floatsAvailable > framesRequested*_channels)
+  ReadCursor cursor;
+  cursor.frame = _writeEnd.load(std::memory_order_acquire);
+  return cursor;
+}
+
+size_t SignalProcessor::PublishedSignal::copyFromRing(ReadCursor& cursor, float* pDest,
+                                                       size_t framesRequested) const
+{
+  const uint64_t end = _writeEnd.load(std::memory_order_acquire);
+  if (end - cursor.frame > _capacity)
+  {
+    cursor.droppedFrames += static_cast<size_t>(end - _capacity - cursor.frame);
+    cursor.frame = end - _capacity;
+  }
+  size_t frames = static_cast<size_t>(min(uint64_t(framesRequested), end - cursor.frame));
+  if (!frames) return 0;
+
+  const size_t startIdx = static_cast<size_t>(cursor.frame & (_capacity - 1));
+  const size_t frames1 = min(frames, _capacity - startIdx);
+  const float* pSrc = _ring.data() + startIdx * _channels;
+  ML_SEQLOCK_COPY_BEGIN();
+  std::copy(pSrc, pSrc + frames1 * _channels, pDest);
+  std::copy(_ring.data(), _ring.data() + (frames - frames1) * _channels,
+            pDest + frames1 * _channels);
+  ML_SEQLOCK_COPY_END();
+
+  // any frames the writer started to overwrite during the copy are dropped.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t writeStart = _writeStart.load(std::memory_order_relaxed);
+  if (writeStart > cursor.frame + _capacity)
   {
-    _buffer.discard(floatsAvailable - framesRequested*_channels);
+    const size_t overwritten =
+        static_cast<size_t>(min(writeStart - _capacity - cursor.frame, uint64_t(frames)));
+    std::copy(pDest + overwritten * _channels, pDest + frames * _channels, pDest);
+    cursor.droppedFrames += overwritten;
+    cursor.frame += overwritten;
+    frames -= overwritten;
   }
-  
-  return _buffer.read(pDest, framesRequested*_channels);
+  cursor.frame += frames;
+  return frames;
 }
 
-void SignalProcessor::PublishedSignal::peekLatest(float* pDest, size_t framesRequested)
+size_t SignalProcessor::PublishedSignal::read(ReadCursor& cursor, float* pDest,
+                                              size_t framesRequested)
 {
-  _buffer.peekMostRecent(pDest, framesRequested * _channels);
+  return copyFromRing(cursor, pDest, framesRequested);
+}
+
+size_t SignalProcessor::PublishedSignal::readLatest(ReadCursor& cursor, float* pDest,
+                                                    size_t framesRequested)
+{
+  const uint64_t end = _writeEnd.load(std::memory_order_acquire);
+  if (end - cursor.frame > framesRequested)
+  {
+    cursor.frame = end - framesRequested;
+  }
+  return copyFromRing(cursor, pDest, framesRequested);
 }
 
-size_t SignalProcessor::PublishedSignal::read(float* pDest, size_t framesRequested)
+bool SignalProcessor::PublishedSignal::peekLatest(float* pDest, size_t framesRequested) const
 {
-  return _buffer.read(pDest, framesRequested * _channels);
+  const uint64_t end = _writeEnd.load(std::memory_order_acquire);
+  if ((end < framesRequested) || (framesRequested > _capacity)) return false;
+  ReadCursor cursor;
+  cursor.frame = end - framesRequested;
+  return copyFromRing(cursor, pDest, framesRequested) == framesRequested;
 }
 
 // SignalProcessor::ProcessTime
@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "MLActor.h"
 #include "MLDSPUtils.h"
+#include "MLParallelVoiceRenderer.h"
 #include "MLParameters.h"
 #include "MLPlatform.h"
 #include "madronalib.h"
@@ -23,84 +26,141 @@ class SignalProcessor
  public:
   // SignalProcessor::PublishedSignal sends a signal from within a DSP
   // calculation to outside code like displays.
-  struct PublishedSignal
+  //
+  // The audio thread is the only writer. Frames are stored one by one, with a
+  // sample for each channel (frame major order), in a ring that the writer
+  // never waits on. Any number of readers, such as scopes, a network streamer
+  // or a recorder, can each follow the signal with their own ReadCursor. A
+  // reader that falls more than a buffer behind skips ahead to the oldest
+  // frames still stored, and counts the frames it missed.
+  //
+  // If octavesDown is nonzero, each channel is decimated by 2^octavesDown
+  // through a Downsampler, a cascade of half band filters, so the published
+  // signal does not alias. The filters produce a vector of output for every
+  // 2^octavesDown vectors of input.
+  class PublishedSignal
   {
-    std::vector<float> voiceRotateBuffer;
-    DSPBuffer _buffer;
-    size_t maxFrames_{0};
-    size_t _channels{0};
-    int octavesDown_{0};
-    int downsampleCtr_{0};
+   public:
+    // a reader's position in the signal. Each reader needs its own.
+    struct ReadCursor
+    {
+      uint64_t frame{0};
+
+      // frames written that this reader did not get in time.
+      size_t droppedFrames{0};
+    };
 
     PublishedSignal(int frames, int maxVoices, int channels, int octavesDown);
     ~PublishedSignal() = default;
 
-    inline size_t getNumChannels() const { return (size_t)_channels; }
-    inline int getAvailableFrames() const { return (int)(_channels ? (_buffer.getReadAvailable() / _channels) : 0); }
-    inline int getReadAvailable() const { return (int)_buffer.getReadAvailable(); }
+    PublishedSignal(PublishedSignal const&) = delete;
+    PublishedSignal& operator=(PublishedSignal const&) = delete;
+
+    inline size_t getNumChannels() const { return _channels; }
+    inline int getOctavesDown() const { return _octavesDown; }
+
+    // the number of frames the ring holds.
+    inline size_t getCapacity() const { return _capacity; }
 
-    
     // write frames from a DSPVectorArray< CHANNELS > of data into a published signal.
-    // this data is for one voice of the signal.
-    // don't use block size downsampler and get output samples as soon as they are available.
-    //
-    // frames are stored in buffer one by one, with a sample for each channel (frame major order), not in signal vectors!
-    // When multiple voices are being sent, each voice is sent as one frame and the voices rotate:
-    // frame0: [ voice0 [ chan0, chan1, chan2 ... chanN ] voice1 [ chan0, chan1, chan2 ... chanN ] ... ]
-    // frame1: [ voice0 [ chan0, chan1, chan2 ... chanN ] voice1 [ chan0, chan1, chan2 ... chanN ] ... ]
+    // this data is for one voice of the signal. Each voice has its own filters,
+    // so voices can be written in turn, one vector per voice, and their output
+    // frames will follow in the same order.
     //
     // nothing here enforces the voice order- processors are responsible for calling
     // storePublishedSignal() for each voice in rotation.
-    //
-    // the voice param is not used currently but we can transmit the voice number in the future if needed.
-    //
     template <size_t CHANNELS>
-    inline void writeQuick(DSPVectorArray<CHANNELS> inputVector, size_t frames, size_t voice)
+    inline void writeQuick(const DSPVectorArray<CHANNELS>& inputVector, size_t frames,
+                           size_t voice)
     {
-      // on every (1<<octavesDown_)th frame, rotate and write to DSPBuffer
-      int framesWritten = 0;
-      for(int f=0; f<frames; ++f)
+      for (size_t c = 0; c < _channels; ++c)
       {
-        downsampleCtr_++;
-        if(downsampleCtr_ >= (1 << octavesDown_))
-        {
-          // write accumulated frame.
-          for(int j=0; j<CHANNELS; ++j)
-          {
-            voiceRotateBuffer[framesWritten*CHANNELS + j] = inputVector.row(j)[f];
-          }
-          framesWritten++;
-          downsampleCtr_ = 0;
-        }
-      }
-      
-      if(framesWritten)
-      {
-        _buffer.write(voiceRotateBuffer.data(), framesWritten*CHANNELS);
+        _inputRows[c] =
+            (c < CHANNELS) ? inputVector.getRowDataConst(c) : _zeros.getConstBuffer();
       }
+      write(_inputRows.data(), min(frames, size_t(kFloatsPerDSPVector)), voice);
     }
-    
+
     // write a single frame of signal with multiple contiguous channels
     inline void writeQuickVert(const float* inputVector, size_t channels, size_t voice)
     {
-      // on every (1<<octavesDown_)th frame, rotate and write to DSPBuffer
-      
-      downsampleCtr_++;
-      if(downsampleCtr_ >= (1 << octavesDown_))
+      for (size_t c = 0; c < _channels; ++c)
       {
-        _buffer.write(inputVector, channels);
-        downsampleCtr_ = 0;
+        _inputRows[c] = (c < channels) ? inputVector + c : _zeros.getConstBuffer();
       }
+      write(_inputRows.data(), 1, voice);
     }
-    
-    // read the latest n frames of data, where each frame is a DSPVectorArray< CHANNELS >.
-    size_t readLatest(float* pDest, size_t framesRequested);
 
-    // read the next n frames of data.
-    size_t read(float* pDest, size_t framesRequested);
-    
-    void peekLatest(float* pDest, size_t framesRequested);
+    // write frames from planar data, with a pointer to each channel.
+    void write(const float* const* pRows, size_t frames, size_t voice);
+
+    // readers
+
+    // get a cursor that will read from the next frame written.
+    ReadCursor getReadCursor() const;
+
+    inline size_t getAvailableFrames(const ReadCursor& cursor) const
+    {
+      const uint64_t end = _writeEnd.load(std::memory_order_acquire);
+      return static_cast<size_t>(min(end - cursor.frame, uint64_t(_capacity)));
+    }
+
+    // read the next n frames of data, or as many as are available, and return
+    // the number of frames read.
+    size_t read(ReadCursor& cursor, float* pDest, size_t framesRequested);
+
+    // read the latest n frames of data, skipping any older frames.
+    size_t readLatest(ReadCursor& cursor, float* pDest, size_t framesRequested);
+
+    // copy the most recent n frames without moving any cursor. Returns false
+    // and copies nothing if fewer frames have been written.
+    bool peekLatest(float* pDest, size_t framesRequested) const;
+
+    // reading with a default cursor, for code with a single reader. Like the
+    // DSPBuffer these calls used to read from, read(), readLatest() and
+    // getReadAvailable() count floats, which is frames times channels.
+    inline int getAvailableFrames() const { return (int)getAvailableFrames(_defaultCursor); }
+    inline int getReadAvailable() const { return getAvailableFrames() * (int)_channels; }
+    size_t read(float* pDest, size_t framesRequested)
+    {
+      return read(_defaultCursor, pDest, framesRequested) * _channels;
+    }
+    size_t readLatest(float* pDest, size_t framesRequested)
+    {
+      return readLatest(_defaultCursor, pDest, framesRequested) * _channels;
+    }
 
+   private:
+    void writeToRing(const float* const* pRows, size_t frames);
+    size_t copyFromRing(ReadCursor& cursor, float* pDest, size_t frames) const;
+
+    size_t _channels{0};
+    size_t _maxVoices{0};
+    int _octavesDown{0};
+
+    // the ring of interleaved frames. _writeStart is moved ahead before
+    // frames are written and _writeEnd after, so a reader can tell if
+    // the frames it copied were being overwritten at the time. Copying
+    // frames while they are overwritten is a deliberate race, as in any
+    // seqlock: the torn frames are found and dropped afterwards.
+    std::vector<float> _ring;
+    size_t _capacity{0};
+    std::atomic<uint64_t> _writeStart{0};
+    std::atomic<uint64_t> _writeEnd{0};
+
+    // a Downsampler for each channel of each voice, and the input frames
+    // gathered for each voice until there is a whole vector.
+    std::vector<Downsampler> _downsamplers;
+    DSPVectorDynamic _pending;
+    std::vector<size_t> _pendingFrames;
+    DSPVectorDynamic _downsampled;
+
+    std::vector<const float*> _inputRows;
+    std::vector<const float*> _outputRows;
+    std::vector<const float*> _wrapRows;
+    DSPVector _zeros;
+
+    ReadCursor _defaultCursor;
   };
 
   // SignalProcessor::ProcessTime maintains the current time in a DSP process and can track
@@ -171,6 +231,31 @@ class SignalProcessor
     _params.setFromNormalizedValue(pname, val);
   }
 
+  // set the sample rate and the host time at the start of a process block.
+  void setTimeAndRate(double secs, double ppqPos, double bpm, bool isPlaying, double sampleRate)
+  {
+    _sampleRate = static_cast<float>(sampleRate);
+    _currentTime.setTimeAndRate(secs, ppqPos, bpm, isPlaying, sampleRate);
+  }
+
+  // set up rendering of voices on worker threads for renderVoices(). With 0
+  // workers, voices are rendered in order on the calling thread. maxVoices
+  // must be at least the number of voices renderVoices() will be given. Idle
+  // workers spin for spinMicroseconds before sleeping. This starts and stops
+  // threads, so call it outside of processing.
+  void setVoiceThreads(size_t workers, size_t maxVoices = EventsToSignals::kMaxVoices,
+                       size_t voicesPerGroup = 1, int spinMicroseconds = 200)
+  {
+    _voiceRenderer.reset();
+    if (workers)
+    {
+      _voiceRenderer = std::make_unique<ParallelVoiceRenderer>(workers, maxVoices,
+                                                               voicesPerGroup, spinMicroseconds);
+    }
+  }
+
+  size_t getVoiceThreads() const { return _voiceRenderer ? _voiceRenderer->getWorkers() : 0; }
+
   inline void buildParams(const ParameterDescriptionList& paramList)
   {
     buildParameterTree(paramList, _params);
@@ -216,6 +301,36 @@ class SignalProcessor
     return _params.getNormalizedFloatValue(pname);
   }
   
+  // call fn(v) for each voice v in [0, voices), in parallel if
+  // setVoiceThreads() has made workers. Returns when all voices are done, so
+  // the results can be mixed after. Each call of fn must only touch the state
+  // of its own voice.
+  template <typename Fn>
+  inline void renderVoices(size_t voices, Fn&& fn)
+  {
+    if (_voiceRenderer)
+    {
+      _voiceRenderer->render(voices, fn);
+    }
+    else
+    {
+      for (size_t v = 0; v < voices; ++v)
+      {
+        fn(v);
+      }
+    }
+  }
+
+  // call fn(v, voice) for each voice of an EventsToSignals, up to its polyphony.
+  template <typename Fn>
+  inline void renderVoices(EventsToSignals& events, Fn&& fn)
+  {
+    auto voiceFn = [&](size_t v) { fn(v, events.voices[v]); };
+    renderVoices(events.getPolyphony(), voiceFn);
+  }
+
+  std::unique_ptr<ParallelVoiceRenderer> _voiceRenderer;
+
   Tree<std::unique_ptr<PublishedSignal> > _publishedSignals;
 
   inline void publishSignal(Path signalName, int maxFrames, int maxVoices, int channels, int octavesDown)
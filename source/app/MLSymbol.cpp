@@ -8,80 +8,132 @@ namespace ml
 {
 #pragma mark SymbolTable
 
-SymbolTable::SymbolTable() { clear(); }
+SymbolTable::SymbolTable()
+{
+  for (auto& segment : mSegments)
+  {
+    segment.store(nullptr, std::memory_order_relaxed);
+  }
+  clear();
+}
 
 SymbolTable::~SymbolTable()
 {
   // TODO better protection on delete
   // can this be avoided with more explicit setup / shutdown
   // (RAII in main() )
-  // std::unique_lock<std::mutex> lock(mMutex);
+  for (auto& segment : mSegments)
+  {
+    delete[] segment.exchange(nullptr);
+  }
 }
 
 // clear all symbols from the table.
 void SymbolTable::clear()
 {
+  std::unique_lock<std::mutex> lock(mAddMutex);
   mSize = 0;
-  // std::unique_lock<std::mutex> lock(mMutex);
-
-  mSymbolTextsByID.clear();
-  mSymbolTextsByID.reserve(kDefaultSymbolTableSize);
 
-  for (int i = 0; i < kHashTableSize; ++i)
+  // keep the first segment to avoid allocating it again.
+  for (size_t i = 1; i < kMaxSegments; ++i)
   {
-    clearEntry(mHashTable[i]);
+    delete[] mSegments[i].exchange(nullptr);
   }
+  mHashTables.clear();
+  mHashTables.emplace_back(std::make_unique<HashTable>(kDefaultSymbolTableSize));
+  mHashTable.store(mHashTables.back().get(), std::memory_order_release);
 
   // add null entry - why?
   addEntry(HashedCharArray());
 }
 
-// add an entry to the table. The entry must not already exist in the table.
-// this must be the only way of modifying the symbol table.
+// add an entry to the table. The entry must not already exist in the table,
+// and mAddMutex must be held. this must be the only way of modifying the
+// symbol table.
 SymbolID SymbolTable::addEntry(const HashedCharArray& hsl)
 {
-  mSymbolTextsByID.emplace_back(TextFragment(hsl.pChars, static_cast<int>(hsl.len)));
+  const SymbolID newID = mSize.load(std::memory_order_relaxed);
+  const size_t segment = getSegment(newID);
+  if (!mSegments[segment].load(std::memory_order_relaxed))
+  {
+    mSegments[segment].store(new SymbolEntry[kFirstSegmentSize << segment],
+                             std::memory_order_release);
+  }
 
-  size_t newID = mSize++;
-  mHashTable[hsl.hash].mIDVector.emplace_back(newID);
+  HashTable* pTable = mHashTable.load(std::memory_order_relaxed);
+  if (newID > pTable->mask)
+  {
+    pTable = growHashTable();
+  }
+
+  SymbolEntry& entry = getEntry(newID);
+  entry.text = TextFragment(hsl.pChars, static_cast<int>(hsl.len));
+  entry.hash = hsl.hash;
+  entry.id = newID;
+
+  // publish the finished entry.
+  std::atomic<SymbolEntry*>& head = pTable->heads[hsl.hash & pTable->mask];
+  pTable->pNextEntries[newID] = head.load(std::memory_order_relaxed);
+  mSize.store(newID + 1, std::memory_order_release);
+  head.store(&entry, std::memory_order_release);
   return newID;
 }
 
-SymbolID SymbolTable::getSymbolID(const HashedCharArray& hsl)
+SymbolTable::HashTable* SymbolTable::growHashTable()
 {
-  SymbolID r = 0;
-
-  // get the vector of symbol IDs matching this hash. It probably has one entry
-  // but may have more.
-  const std::vector<SymbolID>& bin = mHashTable[hsl.hash].mIDVector;
+  const HashTable* pOldTable = mHashTable.load(std::memory_order_relaxed);
+  auto pNewTable = std::make_unique<HashTable>(2 * (pOldTable->mask + 1));
+  const size_t size = mSize.load(std::memory_order_relaxed);
+  for (SymbolID id = 0; id < size; ++id)
   {
-    bool found = false;
+    SymbolEntry* pEntry = &getEntry(id);
+    auto& head = pNewTable->heads[pEntry->hash & pNewTable->mask];
+    pNewTable->pNextEntries[id] = head.load(std::memory_order_relaxed);
+    head.store(pEntry, std::memory_order_relaxed);
+  }
 
-    std::unique_lock<std::mutex> lock(mHashTable[hsl.hash].mMutex);
+  // readers still using the old table will not find the newest symbols in
+  // it, and will look again with the lock.
+  mHashTables.emplace_back(std::move(pNewTable));
+  mHashTable.store(mHashTables.back().get(), std::memory_order_release);
+  return mHashTables.back().get();
+}
 
-    for (auto ID : bin)
+SymbolTable::SymbolEntry* SymbolTable::findEntry(const HashedCharArray& hsl)
+{
+  // there should be few collisions, so probably the first entry in the chain
+  // will be the symbol we are looking for. Comparing the full hashes first
+  // skips nearly all others, but to test for equality we still have to compare
+  // the entire string.
+  const HashTable* pTable = mHashTable.load(std::memory_order_acquire);
+  for (auto pEntry = pTable->heads[hsl.hash & pTable->mask].load(std::memory_order_acquire);
+       pEntry; pEntry = pTable->pNextEntries[pEntry->id])
+  {
+    if ((pEntry->hash == hsl.hash) &&
+        compareSizedCharArrays(pEntry->text.getText(), pEntry->text.lengthInBytes(), hsl.pChars,
+                               hsl.len))
     {
-      // there should be few collisions, so probably the first ID in the hash
-      // bin will be the symbol we are looking for. Unfortunately to test for
-      // equality we may have to compare the entire string.
-      TextFragment* binFragment = &mSymbolTextsByID[ID];
-      if (compareSizedCharArrays(binFragment->getText(), binFragment->lengthInBytes(), hsl.pChars,
-                                 hsl.len))
-      {
-        r = ID;
-        found = true;
-        break;
-      }
+      return pEntry;
     }
+  }
+  return nullptr;
+}
 
-    if (!found)
-    {
-      mSymbolTextsByID.emplace_back(TextFragment(hsl.pChars, static_cast<int>(hsl.len)));
-      r = mSize++;
-      mHashTable[hsl.hash].mIDVector.emplace_back(r);
-    }
+SymbolID SymbolTable::getSymbolID(const HashedCharArray& hsl)
+{
+  if (SymbolEntry* pEntry = findEntry(hsl))
+  {
+    return pEntry->id;
+  }
+
+  // not found: lock, and look again in case another thread added the symbol
+  // meanwhile.
+  std::unique_lock<std::mutex> lock(mAddMutex);
+  if (SymbolEntry* pEntry = findEntry(hsl))
+  {
+    return pEntry->id;
   }
-  return r;
+  return addEntry(hsl);
 }
 
 SymbolID SymbolTable::getSymbolID(const char* sym) { return getSymbolID(HashedCharArray(sym)); }
@@ -91,39 +143,34 @@ SymbolID SymbolTable::getSymbolID(const char* sym, size_t lengthBytes)
   return getSymbolID(HashedCharArray(sym, lengthBytes));
 }
 
-const TextFragment& SymbolTable::getSymbolTextByID(SymbolID symID)
-{
-  return mSymbolTextsByID[symID];
-}
+const TextFragment& SymbolTable::getSymbolTextByID(SymbolID symID) { return getEntry(symID).text; }
 
 void SymbolTable::dump()
 {
   std::cout << "---------------------------------------------------------\n";
-  std::cout << mSymbolTextsByID.size() << " symbols:\n";
+  const size_t size = getSize();
+  std::cout << size << " symbols:\n";
 
   // print symbols in order of creation.
-  for (int i = 0; i < mSymbolTextsByID.size(); ++i)
+  for (size_t i = 0; i < size; ++i)
   {
-    const TextFragment& sym = mSymbolTextsByID[i];
+    const TextFragment& sym = getSymbolTextByID(i);
     std::cout << "    ID " << i << " = " << sym << "\n";
   }
   // print nonzero entries in hash table
-  int hash = 0;
-  for (auto& tableEntry : mHashTable)
+  const HashTable* pTable = mHashTable.load(std::memory_order_acquire);
+  for (size_t i = 0; i <= pTable->mask; ++i)
   {
-    auto idVec = tableEntry.mIDVector;
-    size_t idVecLen = idVec.size();
-    if (idVecLen > 0)
+    if (auto pEntry = pTable->heads[i].load(std::memory_order_acquire))
     {
-      std::cout << "#" << hash << " ";
-      for (auto id : idVec)
+      std::cout << "#" << i << " ";
+      for (; pEntry; pEntry = pTable->pNextEntries[pEntry->id])
       {
-        std::cout << id << " " << getSymbolTextByID(id) << " ";
+        std::cout << pEntry->id << " " << pEntry->text << " ";
       }
 
       std::cout << "\n";
     }
-    hash++;
   }
 }
 
@@ -132,7 +179,7 @@ int SymbolTable::audit()
   int i = 0;
   SymbolID i2{0};
   bool OK = true;
-  size_t size = mSymbolTextsByID.size();
+  size_t size = getSize();
 
   for (i = 0; i < size; ++i)
   {
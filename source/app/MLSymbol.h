@@ -24,13 +24,20 @@
 // Symbols must not ever require any heap as long as they are smaller than a
 // certain size. Currently this relies on the "small string optimization"
 // implementation of TextFragment. Currently the size is 16 bytes.
+//
+// Looking up an existing symbol must not lock, so that Symbols can be made
+// from any thread without waiting on another. Only adding a new symbol takes
+// a lock.
 
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 
@@ -38,13 +45,15 @@
 
 namespace ml
 {
+// the size of the K&R hash below.
 constexpr int kHashTableBits = 12;
 constexpr int kHashTableSize = (1 << kHashTableBits);
 constexpr int kHashTableMask = kHashTableSize - 1;
 
 // initial capacity of symbol table. if this number of symbols is exceeded, the
 // capacity of the table will have to be increased, which may result in a glitch
-// if called from the audio thread.
+// if called from the audio thread. Symbols already in the table don't move, and
+// their IDs don't change.
 // TODO these constants that tune different parts of madronalib for space use
 // etc. should all be in one header.
 constexpr int kDefaultSymbolTableSize = 4096;
@@ -86,10 +95,29 @@ inline uint32_t krHash0(const char* str, const size_t len)
 
 inline uint32_t krHash0(const char* str) { return krHash0(str, strlen(str)); }
 
+// 64-bit hash used by the symbol table: FNV-1a, followed by the finalizer
+// from MurmurHash3 so that the low bits alone make a good table index.
+// Constexpr, so strings known at compile time can be hashed then.
+constexpr uint64_t symbolHash(const char* str, size_t len)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < len; ++i)
+  {
+    h ^= static_cast<uint8_t>(str[i]);
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
 template <size_t N>
-constexpr uint32_t hash(const char (&sym)[N])
+constexpr uint64_t hash(const char (&sym)[N])
 {
-  return krHash1<N>(sym);
+  return symbolHash(sym, N - 1);
 }
 
 class HashedCharArray
@@ -98,38 +126,63 @@ class HashedCharArray
   // template ctor from string literals allows hashing for code like
   // Proc::setParam("foo") to be done at compile time.
   template <size_t N>
-  constexpr HashedCharArray(const char (&sym)[N]) : len(N), hash(krHash1<N>(sym)), pChars(sym)
+  constexpr HashedCharArray(const char (&sym)[N])
+      : len(arrayTextLength(sym, N)), hash(symbolHash(sym, arrayTextLength(sym, N))), pChars(sym)
   {
   }
 
-  // this non-constexpr ctor counts the string length at runtime.
-  HashedCharArray(const char* pC) : len(strlen(pC)), hash(krHash0(pC, len)), pChars(pC) {}
+  // this non-constexpr ctor counts the string length at runtime. It is a
+  // template so that literals will use the constexpr ctor above instead.
+  template <typename T,
+            typename = typename std::enable_if<std::is_same<T, const char*>::value ||
+                                               std::is_same<T, char*>::value>::type>
+  HashedCharArray(T pC) : len(strlen(pC)), hash(symbolHash(pC, len)), pChars(pC)
+  {
+  }
 
   // this non-constexpr ctor takes a string length parameter at runtime.
   HashedCharArray(const char* pC, size_t lengthBytes)
-      : len(lengthBytes), hash(krHash0(pC, len)), pChars(pC)
+      : len(lengthBytes), hash(symbolHash(pC, len)), pChars(pC)
   {
   }
 
   // default, null ctor
-  HashedCharArray() : len(0), hash(0), pChars(nullptr) {}
+  HashedCharArray() : len(0), hash(symbolHash(nullptr, 0)), pChars(nullptr) {}
 
   const size_t len;
-  const uint32_t hash;
+  const uint64_t hash;
   const char* pChars;
+
+ private:
+  // the length of the text in a char array, which may end before the array.
+  static constexpr size_t arrayTextLength(const char* str, size_t arraySize)
+  {
+    size_t i = 0;
+    while ((i < arraySize) && str[i])
+    {
+      i++;
+    }
+    return i;
+  }
 };
 
 using SymbolID = size_t;
 
+class Symbol;
+
 class SymbolTable
 {
   friend class Symbol;
+  friend uint64_t hash(Symbol s);
 
  public:
   SymbolTable();
   ~SymbolTable();
+
+  // clear all symbols from the table. Not thread-safe: no Symbols may be
+  // made or read meanwhile.
   void clear();
-  size_t getSize() { return mSymbolTextsByID.size(); }
+  size_t getSize() { return mSize.load(std::memory_order_acquire); }
   void dump(void);
   int audit(void);
 
@@ -145,27 +198,79 @@ class SymbolTable
   SymbolID addEntry(const HashedCharArray& hsl);
 
  private:
-  // vector of text fragments in ID/creation order
-  std::vector<TextFragment> mSymbolTextsByID;
+  // a symbol's text and hash. Entries never move or change once they are
+  // made.
+  struct SymbolEntry
+  {
+    TextFragment text;
+    uint64_t hash{0};
+    SymbolID id{0};
+  };
 
-  // hash table containing indexes to strings for a given hash value.
-  struct TableEntry
+  // a hash table with a chain of entries for each index. Each table holds as
+  // many entries as it has indices. When it is full, it is replaced by one
+  // twice the size. Readers may still be using the old table, so it is kept
+  // until the SymbolTable is cleared.
+  struct HashTable
   {
-    std::mutex mMutex;
-    std::vector<SymbolID> mIDVector;
+    explicit HashTable(size_t size)
+        : mask(size - 1),
+          heads(new std::atomic<SymbolEntry*>[size]),
+          pNextEntries(new SymbolEntry*[size])
+    {
+      for (size_t i = 0; i < size; ++i)
+      {
+        heads[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    size_t mask;
+
+    // the first entry of each chain. A new entry is filled in, then
+    // published by storing it here.
+    std::unique_ptr<std::atomic<SymbolEntry*>[]> heads;
+
+    // the next entry in the chain after the entry with each ID.
+    std::unique_ptr<SymbolEntry*[]> pNextEntries;
   };
 
-  void clearEntry(TableEntry& entry)
+  // entries are stored by ID in segments, each twice the size of the one
+  // before, so the storage can grow without moving the entries.
+  static constexpr size_t kFirstSegmentSize{kDefaultSymbolTableSize};
+  static constexpr size_t kMaxSegments{32};
+
+  static size_t getSegment(SymbolID id)
+  {
+    size_t segment = 0;
+    for (size_t v = id / kFirstSegmentSize + 1; v > 1; v >>= 1)
+    {
+      segment++;
+    }
+    return segment;
+  }
+
+  SymbolEntry& getEntry(SymbolID id)
   {
-    std::unique_lock<std::mutex> lock(entry.mMutex);
-    entry.mIDVector.clear();
+    const size_t segment = getSegment(id);
+    const size_t segmentStart = kFirstSegmentSize * ((size_t(1) << segment) - 1);
+    return mSegments[segment].load(std::memory_order_acquire)[id - segmentStart];
   }
 
-  // since the maximum hash value is known, there will be no need to resize this
-  // array.
-  std::array<TableEntry, kHashTableSize> mHashTable;
+  // find an existing entry without locking.
+  SymbolEntry* findEntry(const HashedCharArray& hsl);
+
+  // make a table twice the size of the current one and add the entries.
+  HashTable* growHashTable();
+
+  std::array<std::atomic<SymbolEntry*>, kMaxSegments> mSegments;
 
-  size_t mSize{0};
+  std::atomic<HashTable*> mHashTable{nullptr};
+  std::vector<std::unique_ptr<HashTable> > mHashTables;
+
+  // held while adding entries.
+  std::mutex mAddMutex;
+
+  std::atomic<size_t> mSize{0};
 };
 
 inline SymbolTable& theSymbolTable()
@@ -202,29 +307,23 @@ class Symbol
 
   explicit operator bool() const { return id != 0; }
 
-  friend uint32_t hash(Symbol s);
+  friend uint64_t hash(Symbol s);
 
-  // search hash table for our id to find our hash.
+  // search hash table for our id to find our index in the table.
   // for testing only!
   inline int getHashFromTable() const
   {
-    int hash = 0;
-
-    for (auto& entry : theSymbolTable().mHashTable)
+    const auto pTable = theSymbolTable().mHashTable.load(std::memory_order_acquire);
+    for (size_t i = 0; i <= pTable->mask; ++i)
     {
-      auto idVec = entry.mIDVector;
-      size_t idVecLen = idVec.size();
-      if (idVecLen > 0)
+      for (auto pEntry = pTable->heads[i].load(std::memory_order_acquire); pEntry;
+           pEntry = pTable->pNextEntries[pEntry->id])
       {
-        for (auto vid : idVec)
+        if (pEntry->id == id)
         {
-          if (vid == id)
-          {
-            return hash;
-          }
+          return static_cast<int>(i);
         }
       }
-      hash++;
     }
     return 0;
   }
@@ -253,7 +352,8 @@ class Symbol
   inline std::string toString() const { return std::string(getUTF8Ptr()); }
 };
 
-inline uint32_t hash(Symbol f) { return krHash0(f.getUTF8Ptr()); }
+// return the same hash as the symbol's text, without hashing it again.
+inline uint64_t hash(Symbol f) { return theSymbolTable().getEntry(f.id).hash; }
 
 inline Symbol operator+(Symbol f1, Symbol f2)
 {
@@ -262,6 +362,17 @@ inline Symbol operator+(Symbol f1, Symbol f2)
 
 }  // namespace ml
 
+// ML_SYMBOL("text") looks up a string literal in the symbol table once, the
+// first time it is evaluated, and after that is just a copy of the Symbol's
+// ID. Use it for Symbols made from literals in code that runs often, like
+// message dispatch, where Symbol("text") would look up the text every time.
+// Like any stored Symbol, the result is not valid after the table is cleared.
+#define ML_SYMBOL(text)                                       \
+  ([]() -> ml::Symbol {                                       \
+    static const ml::Symbol sym{ml::HashedCharArray("" text)}; \
+    return sym;                                               \
+  }())
+
 // hashing function for ml::Symbol use in unordered STL containers. simply
 // return the ID, which gives each Symbol a unique hash.
 namespace std
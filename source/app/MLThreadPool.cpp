@@ -0,0 +1,182 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+#include "MLThreadPool.h"
+
+#include <algorithm>
+
+#include "MLPlatform.h"
+
+#if ML_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace ml;
+
+namespace
+{
+ThreadPool::Options hardwareOptions()
+{
+  ThreadPool::Options options;
+  options.threads = ThreadPool::getHardwareThreads();
+  return options;
+}
+}  // namespace
+
+ThreadPool::ThreadPool() : ThreadPool(hardwareOptions()) {}
+
+ThreadPool::ThreadPool(const Options& options)
+    : _options(options), _jobs(options.maxJobs), _parking(options.spinMicroseconds, 1)
+{
+  for (size_t i = 0; i < options.threads; ++i)
+  {
+    _threads.emplace_back([this, i]() { workerLoop(i); });
+  }
+
+  // wait for the workers to set their scheduling, so it can be checked.
+  while (_workersStarted.load(std::memory_order_acquire) < options.threads)
+  {
+    std::this_thread::yield();
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  _parking.stop();
+  for (auto& t : _threads)
+  {
+    t.join();
+  }
+}
+
+bool ThreadPool::submit(JobFn fn, void* context)
+{
+  Job job;
+  job.fn = fn;
+  job.context = context;
+  return submitJob(job);
+}
+
+bool ThreadPool::submit(std::function<void()> fn)
+{
+  Job job;
+  job.function = std::move(fn);
+  return submitJob(job);
+}
+
+bool ThreadPool::submitJob(Job& job)
+{
+  job.submitTime = std::chrono::steady_clock::now();
+  if (!_jobs.push(std::move(job))) return false;
+
+  // count the job only once it is queued, so wait() never waits for a job
+  // that was not.
+  _submitted.fetch_add(1, std::memory_order_acq_rel);
+
+  _parking.wake();
+  return true;
+}
+
+void ThreadPool::runJob(Job& job)
+{
+  using namespace std::chrono;
+  const auto startTime = steady_clock::now();
+  _queueLatency.add(duration<double>(startTime - job.submitTime).count());
+  if (job.fn)
+  {
+    job.fn(job.context);
+  }
+  else if (job.function)
+  {
+    job.function();
+    job.function = nullptr;
+  }
+  _runTime.add(duration<double>(steady_clock::now() - startTime).count());
+  _finished.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool ThreadPool::runPendingJob()
+{
+  Job job;
+  if (!_jobs.pop(job)) return false;
+  runJob(job);
+  return true;
+}
+
+void ThreadPool::wait()
+{
+  const uint64_t submitted = _submitted.load(std::memory_order_acquire);
+  while (_finished.load(std::memory_order_acquire) < submitted)
+  {
+    if (!runPendingJob())
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ThreadPool::workerLoop(size_t worker)
+{
+  if (!setScheduling(worker))
+  {
+    _schedulingFailures++;
+  }
+  _workersStarted.fetch_add(1, std::memory_order_release);
+
+  Job job;
+  auto lastWorkTime = WorkerParking::Clock::now();
+  while (_parking.running())
+  {
+    if (_jobs.pop(job))
+    {
+      runJob(job);
+      lastWorkTime = WorkerParking::Clock::now();
+      continue;
+    }
+    _parking.park(lastWorkTime, [&]() { return !_jobs.wasEmpty(); });
+  }
+}
+
+bool ThreadPool::setScheduling(size_t worker)
+{
+  bool ok{true};
+  const int cpu = _options.cpus.empty() ? -1 : _options.cpus[worker % _options.cpus.size()];
+
+#if ML_WINDOWS
+  if (_options.policy != kNormalPolicy)
+  {
+    ok = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+  }
+  if (cpu >= 0)
+  {
+    ok &= SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+  }
+#else
+  if (_options.policy != kNormalPolicy)
+  {
+    const int policy = (_options.policy == kFIFOPolicy) ? SCHED_FIFO : SCHED_RR;
+    sched_param param{};
+    param.sched_priority = std::min(std::max(_options.priority, sched_get_priority_min(policy)),
+                                    sched_get_priority_max(policy));
+    ok = pthread_setschedparam(pthread_self(), policy, &param) == 0;
+  }
+#if ML_LINUX
+  if (cpu >= 0)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    ok &= pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+  }
+#else
+  ok &= (cpu < 0);
+#endif
+#endif
+
+  return ok;
+}
@@ -0,0 +1,141 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// ThreadPool: a fixed set of worker threads for audio-adjacent work like
+// parallel rendering, analysis and disk streaming, so these don't each make
+// their own threads.
+//
+// The workers are started by the constructor and can be given a realtime
+// scheduling policy and priority, and pinned to CPUs. Setting these may need
+// privileges the process doesn't have, in which case the workers run with
+// normal scheduling and getSchedulingSet() returns false. Affinity is not
+// available on macOS.
+//
+// Jobs are submitted to a bounded queue without locking. submit() with a
+// function pointer and context also does not allocate, so it can be called
+// from the audio thread. Idle workers spin for a while before sleeping, so
+// jobs submitted regularly start quickly.
+//
+// The time each job waits in the queue and the time it takes to run are
+// kept in LatencyHistograms.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "MLLatencyHistogram.h"
+#include "MLQueue.h"
+#include "MLWorkerParking.h"
+
+namespace ml
+{
+class ThreadPool
+{
+ public:
+  enum Policy
+  {
+    kNormalPolicy = 0,
+    kFIFOPolicy,
+    kRoundRobinPolicy
+  };
+
+  struct Options
+  {
+    size_t threads{1};
+
+    // with kFIFOPolicy or kRoundRobinPolicy, the priority is clamped to the
+    // range the system allows for the policy, for example 1-99 on Linux.
+    Policy policy{kNormalPolicy};
+    int priority{0};
+
+    // if not empty, worker i runs only on CPU cpus[i % cpus.size()].
+    std::vector<int> cpus;
+
+    int spinMicroseconds{200};
+    size_t maxJobs{1024};
+  };
+
+  using JobFn = void (*)(void*);
+
+  // the number of hardware threads, at least 1.
+  static size_t getHardwareThreads()
+  {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+  }
+
+  // make a pool with one worker per hardware thread.
+  ThreadPool();
+  explicit ThreadPool(const Options& options);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  // submit a job, returning false if the queue is full. The function pointer
+  // version doesn't allocate.
+  bool submit(JobFn fn, void* context);
+  bool submit(std::function<void()> fn);
+
+  // run one queued job on the calling thread, if there is one.
+  bool runPendingJob();
+
+  // run jobs on the calling thread until all jobs submitted so far are done.
+  void wait();
+
+  size_t getThreads() const { return _threads.size(); }
+
+  // jobs submitted and not yet finished. A job is counted as submitted after
+  // it is queued, so it may finish first and briefly put _finished ahead.
+  size_t getPendingJobs() const
+  {
+    const uint64_t finished = _finished.load(std::memory_order_acquire);
+    const uint64_t submitted = _submitted.load(std::memory_order_acquire);
+    return (submitted > finished) ? static_cast<size_t>(submitted - finished) : 0;
+  }
+
+  // true if every worker got the requested scheduling and affinity.
+  bool getSchedulingSet() const { return _schedulingFailures.load() == 0; }
+
+  // time from submit() until a job starts, and the time jobs take to run.
+  const LatencyHistogram& getQueueLatency() const { return _queueLatency; }
+  const LatencyHistogram& getRunTime() const { return _runTime; }
+
+ private:
+  struct Job
+  {
+    JobFn fn{nullptr};
+    void* context{nullptr};
+    std::function<void()> function;
+    std::chrono::steady_clock::time_point submitTime;
+  };
+
+  bool submitJob(Job& job);
+  void runJob(Job& job);
+  void workerLoop(size_t worker);
+  bool setScheduling(size_t worker);
+
+  Options _options;
+  MPMCQueue<Job> _jobs;
+
+  alignas(64) std::atomic<uint64_t> _submitted{0};
+  std::atomic<uint64_t> _finished{0};
+
+  std::vector<std::thread> _threads;
+  std::atomic<size_t> _workersStarted{0};
+  std::atomic<size_t> _schedulingFailures{0};
+
+  // submit() may be called from the audio thread, so it wakes workers
+  // without locking, and they recheck for jobs every millisecond.
+  WorkerParking _parking;
+
+  LatencyHistogram _queueLatency;
+  LatencyHistogram _runTime;
+};
+
+}  // namespace ml
@@ -4,6 +4,7 @@
 
 #include "MLTimer.h"
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 
@@ -67,17 +68,7 @@ void ml::Timers::stop()
   else
   {
     // signal thread to exit
-    _running = false;
-    runThread.join();
-  }
-}
-
-void ml::Timers::run(void)
-{
-  while (_running)
-  {
-    std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
-    tick();
+    stopThread();
   }
 }
 
@@ -130,24 +121,12 @@ void ml::Timers::stop()
     }
     else
     {
-      // signal thread to exit
-      _running = false;
-
-      // wait for exit
-      runThread.join();
+      // signal thread to exit and wait
+      stopThread();
     }
   }
 }
 
-void ml::Timers::run(void)
-{
-  while (_running)
-  {
-    std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
-    tick();
-  }
-}
-
 #elif ML_LINUX
 
 void ml::Timers::start(bool runInMainThread)
@@ -159,74 +138,244 @@ void ml::Timers::start(bool runInMainThread)
   }
 }
 
-void ml::Timers::run(void)
+void ml::Timers::stop(void)
 {
-  while (_running)
+  if (_running)
   {
-    std::this_thread::sleep_for(milliseconds(Timers::kMillisecondsResolution));
-    tick();
+    stopThread();
   }
 }
 
-void ml::Timers::stop(void)
+#endif
+
+void ml::Timers::stopThread()
 {
-  if (_running)
   {
+    std::unique_lock<std::mutex> lock(_mutex);
     _running = false;
-    runThread.join();
+    _wakeCondition.notify_one();
   }
+  runThread.join();
 }
 
-#endif
+void ml::Timers::run(void)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_running)
+  {
+    if (_heap.empty())
+    {
+      _wakeCondition.wait(lock);
+    }
+    else if (steady_clock::now() < _heap.front()->_deadline)
+    {
+      _wakeCondition.wait_until(lock, _heap.front()->_deadline);
+    }
+    else
+    {
+      runDueTimers(lock);
+    }
+  }
+}
 
 void ml::Timers::tick(void)
 {
-  static time_point<system_clock> previousStatsTime = system_clock::now();
-  time_point<system_clock> now = system_clock::now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  runDueTimers(lock);
+}
 
-  std::unique_lock<std::mutex> lock(mSetMutex);
-  for (auto t : _timerPtrs)
+void ml::Timers::runDueTimers(std::unique_lock<std::mutex>& lock)
+{
+  const auto now = steady_clock::now();
+  while (!_heap.empty() && (_heap.front()->_deadline <= now))
   {
-    std::unique_lock<std::mutex> lock(t->_counterMutex);
+    Timer* t = _heap.front();
+
+    // schedule the next call or finish before calling, so the callback can
+    // change its own timer.
+    if (t->_counter > 0)
+    {
+      t->_counter--;
+    }
     if (t->_counter != 0)
     {
-      if (t->_additionalTime > milliseconds(0))
+      // keep to the period without making up for missed calls.
+      auto next = t->_deadline + t->_period;
+      if (next <= now)
       {
-        t->_previousCall = now + t->_additionalTime - t->_period;
-        t->_additionalTime = milliseconds(0);
+        next = now + std::max(t->_period, steady_clock::duration(1));
       }
-      else if (now - t->_previousCall >= t->_period)
+      schedule(t, next);
+    }
+    else
+    {
+      unschedule(t);
+    }
+
+    // call the function without the lock. While it runs it belongs to this
+    // thread, so the timer can be given a new one meanwhile.
+    std::function<void(void)> f = std::move(t->_func);
+    t->_func = nullptr;
+    _pCallbackTimer = t;
+    _callbackThread = std::this_thread::get_id();
+    lock.unlock();
+    if (f)
+    {
+      f();
+    }
+    lock.lock();
+
+    // if the timer was not deleted or given a new function, give it back.
+    if (_pCallbackTimer == t)
+    {
+      if (!t->_func && (t->_counter != 0))
       {
-        t->_func();
-        if (t->_counter > 0)
-        {
-          t->_counter--;
-        }
-        t->_previousCall = now;
+        t->_func = std::move(f);
       }
+      _pCallbackTimer = nullptr;
     }
+    _callbackDone.notify_all();
   }
 }
 
-// Timer
+void ml::Timers::waitForCallback(Timer* t, std::unique_lock<std::mutex>& lock)
+{
+  // a callback can stop or delete its own timer.
+  if (_callbackThread == std::this_thread::get_id()) return;
+  _callbackDone.wait(lock, [&]() { return _pCallbackTimer != t; });
+}
+
+void ml::Timers::schedule(Timer* t, time_point<steady_clock> deadline)
+{
+  t->_deadline = deadline;
+  if (t->_heapIndex == kNotInHeap)
+  {
+    _heap.push_back(t);
+    placeInHeap(t, _heap.size() - 1);
+    siftUp(t->_heapIndex);
+  }
+  else
+  {
+    siftUp(t->_heapIndex);
+    siftDown(t->_heapIndex);
+  }
 
-ml::Timer::Timer() noexcept
+  // if the timer is now the first due, wake the thread to wait for it.
+  if ((_heap.front() == t) && !_inMainThread)
+  {
+    _wakeCondition.notify_one();
+  }
+}
+
+void ml::Timers::unschedule(Timer* t)
 {
-  std::unique_lock<std::mutex> lock(_timers->mSetMutex);
-  _previousCall = _creationTime = system_clock::now();
-  _timers->insert(this);
+  const size_t i = t->_heapIndex;
+  if (i == kNotInHeap) return;
+  t->_heapIndex = kNotInHeap;
+  Timer* last = _heap.back();
+  _heap.pop_back();
+  if (last != t)
+  {
+    placeInHeap(last, i);
+    siftUp(i);
+    siftDown(last->_heapIndex);
+  }
+}
+
+void ml::Timers::placeInHeap(Timer* t, size_t i)
+{
+  _heap[i] = t;
+  t->_heapIndex = i;
+}
+
+void ml::Timers::siftUp(size_t i)
+{
+  Timer* t = _heap[i];
+  while (i > 0)
+  {
+    const size_t parent = (i - 1) / 2;
+    if (!(t->_deadline < _heap[parent]->_deadline)) break;
+    placeInHeap(_heap[parent], i);
+    i = parent;
+  }
+  placeInHeap(t, i);
+}
+
+void ml::Timers::siftDown(size_t i)
+{
+  Timer* t = _heap[i];
+  const size_t n = _heap.size();
+  while (true)
+  {
+    size_t child = 2 * i + 1;
+    if (child >= n) break;
+    if ((child + 1 < n) && (_heap[child + 1]->_deadline < _heap[child]->_deadline))
+    {
+      child++;
+    }
+    if (!(_heap[child]->_deadline < t->_deadline)) break;
+    placeInHeap(_heap[child], i);
+    i = child;
+  }
+  placeInHeap(t, i);
 }
 
+// Timer
+
+ml::Timer::Timer() noexcept { _timers->_timerCount++; }
+
 ml::Timer::~Timer()
 {
-  std::unique_lock<std::mutex> lock(_timers->mSetMutex);
-  _timers->erase(this);
+  std::unique_lock<std::mutex> lock(_timers->_mutex);
+  _timers->unschedule(this);
+  if (_timers->_pCallbackTimer == this)
+  {
+    _timers->waitForCallback(this, lock);
+
+    // deleted from its own callback: tell the Timers not to touch it again.
+    if (_timers->_pCallbackTimer == this)
+    {
+      _timers->_pCallbackTimer = nullptr;
+    }
+  }
+  _timers->_timerCount--;
+}
+
+void ml::Timer::setCalls(std::function<void(void)> f, steady_clock::duration period, int counter)
+{
+  std::unique_lock<std::mutex> lock(_timers->_mutex);
+  _func = std::move(f);
+  _period = period;
+  _counter = counter;
+  if (_counter != 0)
+  {
+    _timers->schedule(this, steady_clock::now() + period);
+  }
+  else
+  {
+    _timers->unschedule(this);
+  }
+}
+
+void ml::Timer::postpone(const steady_clock::duration timeToAdd)
+{
+  std::unique_lock<std::mutex> lock(_timers->_mutex);
+  if (_counter != 0)
+  {
+    _timers->schedule(this, steady_clock::now() + timeToAdd);
+  }
+}
+
+bool ml::Timer::isActive()
+{
+  std::unique_lock<std::mutex> lock(_timers->_mutex);
+  return _counter != 0;
 }
 
 void ml::Timer::stop()
 {
-  // More lightweight ways of handling a race on _counter are possible, but as
-  // stopping a timer is an infrequent operation we use the mutex for brevity.
-  std::unique_lock<std::mutex> lock(_counterMutex);
+  std::unique_lock<std::mutex> lock(_timers->_mutex);
   _counter = 0;
+  _timers->unschedule(this);
+  _timers->waitForCallback(this, lock);
 }
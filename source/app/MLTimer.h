@@ -4,12 +4,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <mutex>
-#include <set>
 #include <thread>
+#include <vector>
 
 #include "MLPlatform.h"
 #include "MLSharedResource.h"
@@ -18,11 +20,16 @@ using namespace std::chrono;
 
 namespace ml
 {
-// A simple, low-resolution timer for doing applicaton and UI tasks.
+// A simple timer for doing applicaton and UI tasks.
 // Any callbacks are called synchronously from a single thread, so
 // callbacks should not take too much time. To trigger an action
 // that might take longer, send a message from the callback and
 // then receive it and do the action in a private thread.
+//
+// Active timers are kept in a heap ordered by their next deadline, and the
+// Timers thread sleeps until the earliest one, so idle timers cost nothing
+// and periods can be shorter than a millisecond. When the timers run in the
+// main thread, they are checked every kMillisecondsResolution instead.
 
 class Timer;
 
@@ -33,7 +40,7 @@ class Timers
  public:
   static const int kMillisecondsResolution;
 
-  Timers() {}
+  Timers() { _heap.reserve(kInitialHeapSize); }
   ~Timers()
   {
     if (_running) stop();
@@ -46,22 +53,42 @@ class Timers
   void start(bool runInMainThread = false);
   void stop();
 
-  void insert(Timer* t) { _timerPtrs.insert(t); }
-  void erase(Timer* t) { _timerPtrs.erase(t); }
-
+  // call the callbacks of any timers that are due.
   void tick(void);
   void run(void);
 
   // MLTEST
-  size_t getSize() { return _timerPtrs.size(); }
+  size_t getSize() { return _timerCount.load(); }
 
  private:
-  std::mutex mSetMutex;
+  static constexpr size_t kInitialHeapSize{256};
+  static constexpr size_t kNotInHeap{~size_t(0)};
+
+  void schedule(Timer* t, time_point<steady_clock> deadline);
+  void unschedule(Timer* t);
+  void siftUp(size_t i);
+  void siftDown(size_t i);
+  void placeInHeap(Timer* t, size_t i);
+  void runDueTimers(std::unique_lock<std::mutex>& lock);
+  void stopThread();
+  void waitForCallback(Timer* t, std::unique_lock<std::mutex>& lock);
+
+  // guards the heap and the timers' state. Callbacks are called without it.
+  std::mutex _mutex;
+  std::condition_variable _wakeCondition;
+  std::condition_variable _callbackDone;
+
+  // the active timers, earliest deadline first.
+  std::vector<Timer*> _heap;
+  std::atomic<size_t> _timerCount{0};
+
+  // the timer whose callback is running, if any, and the thread running it.
+  Timer* _pCallbackTimer{nullptr};
+  std::thread::id _callbackThread;
 
   void* pTimersRef{nullptr};
-  bool _running{false};
+  std::atomic<bool> _running{false};
   bool _inMainThread{false};
-  std::set<Timer*> _timerPtrs;
   std::thread runThread;
 
 #if ML_WINDOWS
@@ -84,50 +111,43 @@ class Timer
   Timer& operator=(Timer&&) = delete;       // Move assign
 
   // call the function once after the specified interval.
-  void callOnce(std::function<void(void)> f, const milliseconds period)
+  void callOnce(std::function<void(void)> f, const steady_clock::duration period)
   {
-    _counter = 1;
-    _func = f;
-    _period = period;
-    _previousCall = system_clock::now();
+    setCalls(std::move(f), period, 1);
   }
 
-  // extend the timeout of the current period for the given number of
-  // milliseconds after the next tick.
-  void postpone(const milliseconds timeToAdd) { _additionalTime = timeToAdd; }
+  // postpone the next call until the given time from now.
+  void postpone(const steady_clock::duration timeToAdd);
 
   // call the function n times, waiting the specified interval before each.
-  void callNTimes(std::function<void(void)> f, const milliseconds period, int n)
+  void callNTimes(std::function<void(void)> f, const steady_clock::duration period, int n)
   {
-    _counter = n;
-    _func = f;
-    _period = period;
-    _previousCall = system_clock::now();
+    setCalls(std::move(f), period, n);
   }
 
   // start calling the function periodically. the wait period happens before the
   // first call.
-  void start(std::function<void(void)> f, const milliseconds period)
+  void start(std::function<void(void)> f, const steady_clock::duration period)
   {
-    _counter = -1;
-    _func = f;
-    _period = period;
-    _previousCall = system_clock::now();
+    setCalls(std::move(f), period, -1);
   }
 
-  bool isActive() { return _counter != 0; }
+  bool isActive();
 
+  // stop the timer. If the callback is running in another thread, this waits
+  // for it to finish.
   void stop();
 
  private:
-  std::mutex _counterMutex;
+  void setCalls(std::function<void(void)> f, steady_clock::duration period, int counter);
 
   SharedResourcePointer<Timers> _timers;
+
+  // all guarded by the Timers mutex.
   int _counter{0};
   std::function<void(void)> _func;
-  milliseconds _period{};
-  milliseconds _additionalTime{};
-  time_point<system_clock> _previousCall{};
-  time_point<system_clock> _creationTime{};
+  steady_clock::duration _period{};
+  time_point<steady_clock> _deadline{};
+  size_t _heapIndex{Timers::kNotInHeap};
 };
 }  // namespace ml
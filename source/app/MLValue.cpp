@@ -102,6 +102,63 @@ Value& Value::operator=(const Value& other)
   return *this;
 }
 
+Value::Value(Value&& other) noexcept : mType(other.getType()), mFloatVal(0)
+{
+  moveDataFrom(other);
+}
+
+Value& Value::operator=(Value&& other) noexcept
+{
+  if (this != &other)
+  {
+    mType = other.getType();
+    moveDataFrom(other);
+  }
+  return *this;
+}
+
+void Value::moveDataFrom(Value& other)
+{
+  switch (mType)
+  {
+    case kUndefinedValue:
+      break;
+    case kFloatValue:
+      mFloatVal = other.mFloatVal;
+      break;
+    case kTextValue:
+      mTextVal = std::move(other.mTextVal);
+      break;
+    case kBlobValue:
+      if (other.pBlobData != other._localBlobData)
+      {
+        // take the other Value's external data
+        if (pBlobData != _localBlobData)
+        {
+          free(pBlobData);
+        }
+        pBlobData = other.pBlobData;
+        _blobSizeInBytes = other._blobSizeInBytes;
+        other.pBlobData = other._localBlobData;
+        other._blobSizeInBytes = 0;
+      }
+      else
+      {
+        copyBlob(other.pBlobData, other._blobSizeInBytes);
+      }
+      break;
+    case kMatrixValue:
+      mMatrixVal = other.mMatrixVal;
+      break;
+    case kUnsignedLongValue:
+      mUnsignedLongVal = other.mUnsignedLongVal;
+      break;
+    case kIntervalValue:
+      mIntervalVal = other.mIntervalVal;
+      break;
+  }
+}
+
 Value::Value(float v) : mType(kFloatValue) { mFloatVal = v; }
 
 Value::Value(int v) : mType(kFloatValue) { mFloatVal = v; }
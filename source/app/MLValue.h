@@ -48,6 +48,11 @@ class Value
   Value();
   Value(const Value& other);
   Value& operator=(const Value& other);
+
+  // moving takes a heap blob or the text from the other Value rather than
+  // copying them.
+  Value(Value&& other) noexcept;
+  Value& operator=(Value&& other) noexcept;
   Value(float v);
   Value(int v);
   Value(bool v);
@@ -219,6 +224,7 @@ class Value
 
  private:
   void copyBlob(const void* inputData, size_t size);
+  void moveDataFrom(Value& other);
 
   uint8_t _localBlobData[kLocalDataBytes];
   size_t _blobSizeInBytes;
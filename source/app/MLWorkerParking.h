@@ -0,0 +1,120 @@
+// madronalib: a C++ framework for DSP applications.
+// Copyright (c) 2020-2022 Madrona Labs LLC. http://www.madronalabs.com
+// Distributed under the MIT license: http://madrona-labs.mit-license.org/
+
+// WorkerParking: the idle handling shared by ThreadPool, ActorRuntime and
+// ParallelVoiceRenderer. A worker that finds no work spins for a while, so
+// work arriving regularly starts quickly, then sleeps until it is woken.
+//
+// Each time a worker finds no work it calls park() with a predicate that
+// checks for work. Producers call wake() or wakeOne() after making work
+// available. wake() doesn't lock, so it can be called from the audio thread,
+// but a worker can miss it between checking and sleeping. Workers of
+// parkings made with a recheck time wake on their own that often to cover
+// this. wakeOne() notifies with the lock held, so it can't be missed, and
+// workers of parkings with no recheck time sleep until woken.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ml
+{
+class WorkerParking
+{
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  WorkerParking(int spinMicroseconds, int recheckMilliseconds)
+      : _spin(spinMicroseconds), _recheck(recheckMilliseconds)
+  {
+  }
+
+  WorkerParking(WorkerParking const&) = delete;
+  WorkerParking& operator=(WorkerParking const&) = delete;
+
+  // true until stop() is called.
+  bool running() const { return _running.load(std::memory_order_acquire); }
+
+  // stop and wake all workers.
+  void stop()
+  {
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    _running.store(false, std::memory_order_release);
+    _wakeCondition.notify_all();
+  }
+
+  // call when a worker has found no work. lastWorkTime is when it last did
+  // some. Within the spin time this yields and returns. After it, this sleeps
+  // until hasWork() returns true or the parking is stopped, and then restarts
+  // the spin time. hasWork() is called with the lock held, and must load
+  // anything that producers change before waking with seq_cst order.
+  template <typename Pred>
+  void park(Clock::time_point& lastWorkTime, Pred hasWork)
+  {
+    if (Clock::now() - lastWorkTime < _spin)
+    {
+      std::this_thread::yield();
+      return;
+    }
+
+    // the count of sleeping workers and whatever hasWork() checks are each
+    // changed before the other is read, all in one order, so either this
+    // worker sees the work or the producer sees this worker.
+    _sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+    bool woken;
+    {
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      auto ready = [&]() { return !running() || hasWork(); };
+      if (_recheck.count())
+      {
+        woken = _wakeCondition.wait_for(lock, _recheck, ready);
+      }
+      else
+      {
+        _wakeCondition.wait(lock, ready);
+        woken = true;
+      }
+    }
+    _sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+    if (woken)
+    {
+      lastWorkTime = Clock::now();
+    }
+  }
+
+  // wake all sleeping workers without locking.
+  void wake()
+  {
+    if (_sleepingWorkers.load(std::memory_order_seq_cst))
+    {
+      _wakeCondition.notify_all();
+    }
+  }
+
+  // wake one sleeping worker, notifying with the lock held so that it can't
+  // miss the wakeup between checking for work and waiting.
+  void wakeOne()
+  {
+    if (_sleepingWorkers.load(std::memory_order_seq_cst))
+    {
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      _wakeCondition.notify_one();
+    }
+  }
+
+ private:
+  const std::chrono::microseconds _spin;
+  const std::chrono::milliseconds _recheck;
+  std::atomic<bool> _running{true};
+
+  std::mutex _sleepMutex;
+  std::condition_variable _wakeCondition;
+  std::atomic<size_t> _sleepingWorkers{0};
+};
+
+}  // namespace ml